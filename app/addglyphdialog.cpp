@@ -2,6 +2,7 @@
 #include "./ui_addglyphdialog.h"
 #include "facewidget.h"
 #include "qfontfacereader.h"
+#include "glyphrastercache.h"
 
 AddGlyphDialog::AddGlyphDialog(const FontFaceViewModel& faceViewModel, QWidget *parent) :
     QDialog(parent),
@@ -27,10 +28,13 @@ AddGlyphDialog::AddGlyphDialog(const FontFaceViewModel& faceViewModel, QWidget *
         if (ui_->emptyRadio->isChecked()) {
             newGlyph_ = f2b::font::glyph { faceViewModel.face().glyphs_size() };
         } else if (ui_->characterRadio->isChecked()) {
+            QFontFaceReader::options opts;
+            opts.cache = &GlyphRasterCache::shared();
             QFontFaceReader adapter {
                 faceViewModel.font().value(),
                 ui_->characterLineEdit->text().toStdString(),
-                faceViewModel.face().glyphs_size()
+                faceViewModel.face().glyphs_size(),
+                opts
             };
             newGlyph_ = f2b::font::face(adapter).glyph_at(0);
         }
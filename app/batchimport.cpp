@@ -0,0 +1,197 @@
+#include "batchimport.h"
+#include "fontfaceviewmodel.h"
+#include "glyphrastercache.h"
+#include "qfontfacereader.h"
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+class BatchImportRunnable : public QRunnable
+{
+public:
+    explicit BatchImportRunnable(std::function<void()> f) : f_ { std::move(f) } {}
+    void run() override { f_(); }
+
+private:
+    std::function<void()> f_;
+};
+
+static double elapsedMilliseconds(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+std::optional<FontStyle> fontStyleFromString(const QString& style)
+{
+    auto s = style.trimmed().toLower();
+    if (s == "regular") {
+        return FontStyle::Regular;
+    } else if (s == "bold") {
+        return FontStyle::Bold;
+    } else if (s == "italic") {
+        return FontStyle::Italic;
+    } else if (s == "bold-italic") {
+        return FontStyle::BoldItalic;
+    }
+    return {};
+}
+
+QString FontVariant::name() const
+{
+    QStringList components { font.family(), QString("%1pt").arg(font.pointSize()) };
+    if (font.bold()) {
+        components << "Bold";
+    }
+    if (font.italic()) {
+        components << "Italic";
+    }
+    return components.join('_').replace(QRegularExpression("[^A-Za-z0-9_-]"), "_");
+}
+
+std::size_t BatchImportReport::numImported() const
+{
+    return static_cast<std::size_t>(std::count_if(results.begin(), results.end(), [](const auto& result) {
+        return !result.error.has_value();
+    }));
+}
+
+std::size_t BatchImportReport::numGlyphs() const
+{
+    std::size_t numGlyphs = 0;
+    for (const auto& result : results) {
+        numGlyphs += result.numGlyphs;
+    }
+    return numGlyphs;
+}
+
+double BatchImportReport::variantsPerSecond() const
+{
+    return wallTime > 0 ? numImported() * 1000.0 / wallTime : 0;
+}
+
+double BatchImportReport::glyphsPerSecond() const
+{
+    return wallTime > 0 ? numGlyphs() * 1000.0 / wallTime : 0;
+}
+
+QString BatchImportReport::summary() const
+{
+    return QString("Imported %1 of %2 variants (%3 glyphs) in %4 ms: %5 variants/s, %6 glyphs/s")
+            .arg(numImported())
+            .arg(results.size())
+            .arg(numGlyphs())
+            .arg(QString::number(wallTime, 'f', 0),
+                 QString::number(variantsPerSecond(), 'f', 1),
+                 QString::number(glyphsPerSecond(), 'f', 0));
+}
+
+BatchImport::BatchImport(BatchImportOptions options) :
+    options_ { std::move(options) },
+    converter_ { options_.sourceCodeOptions, options_.fontArrayName,
+                 options_.sourceCodeTargets, options_.outputDirectory }
+{
+}
+
+std::vector<FontVariant> BatchImport::variants(const QStringList& families,
+                                               const std::vector<int>& pointSizes,
+                                               const std::vector<FontStyle>& styles,
+                                               const QString& characters)
+{
+    std::vector<FontVariant> variants;
+    variants.reserve(static_cast<std::size_t>(families.size()) * pointSizes.size() * styles.size());
+
+    for (const auto& family : families) {
+        for (auto pointSize : pointSizes) {
+            for (auto style : styles) {
+                QFont font(family, pointSize);
+                font.setStyleHint(QFont::TypeWriter);
+                font.setBold(style == FontStyle::Bold || style == FontStyle::BoldItalic);
+                font.setItalic(style == FontStyle::Italic || style == FontStyle::BoldItalic);
+                variants.push_back({ font, characters });
+            }
+        }
+    }
+
+    return variants;
+}
+
+BatchImportReport BatchImport::run(const std::vector<FontVariant>& variants, const ProgressHandler& progress) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    BatchImportReport report;
+    report.results.resize(variants.size());
+    std::atomic_size_t numFinished { 0 };
+
+    // Every variant is rasterized on a single thread, with variants imported concurrently.
+    QThreadPool pool;
+    pool.setMaxThreadCount(options_.threadCount > 0 ? options_.threadCount : QThread::idealThreadCount());
+    for (std::size_t i = 0; i < variants.size(); ++i) {
+        auto r = new BatchImportRunnable([&, i] {
+            report.results[i] = importVariant(variants[i]);
+            auto finished = ++numFinished;
+            if (progress) {
+                progress(finished, variants.size());
+            }
+        });
+        r->setAutoDelete(true);
+        pool.start(r);
+    }
+    pool.waitForDone();
+
+    if (options_.cache != nullptr) {
+        options_.cache->save();
+    }
+
+    report.wallTime = elapsedMilliseconds(timer);
+    return report;
+}
+
+BatchImportResult BatchImport::importVariant(const FontVariant& variant) const
+{
+    BatchImportResult result;
+    result.name = variant.name();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QFontFaceReader::options opts;
+    opts.thread_count = 1;
+    opts.rendering_engine = options_.renderingEngine;
+    opts.cache = options_.cache;
+    QFontFaceReader reader(variant.font, variant.characters.toStdString(), {}, opts);
+    f2b::font::face face(reader);
+
+    result.numGlyphs = face.num_glyphs();
+    result.rasterizeTime = elapsedMilliseconds(timer);
+    timer.restart();
+
+    if (options_.writeDocuments) {
+        auto path = options_.outputDirectory.absoluteFilePath(result.name + ".fontedit");
+        QDir().mkpath(options_.outputDirectory.absolutePath());
+        try {
+            FontFaceViewModel(face, variant.font).saveToFile(path);
+        } catch (const std::exception& e) {
+            result.error = QString::fromStdString(e.what());
+            return result;
+        }
+        result.files << path;
+    }
+
+    auto conversion = converter_.convert(face, result.name);
+    for (const auto& output : conversion.outputs) {
+        result.files << output.filePath;
+    }
+    result.error = conversion.error;
+    result.writeTime = elapsedMilliseconds(timer);
+
+    return result;
+}
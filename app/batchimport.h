@@ -0,0 +1,107 @@
+#ifndef BATCHIMPORT_H
+#define BATCHIMPORT_H
+
+#include "documentconverter.h"
+#include "qfontfacereader.h"
+
+#include <QDir>
+#include <QFont>
+#include <QString>
+#include <QStringList>
+#include <f2b.h>
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+class GlyphRasterCache;
+
+enum class FontStyle { Regular, Bold, Italic, BoldItalic };
+
+/// Parses a style name: regular, bold, italic or bold-italic.
+std::optional<FontStyle> fontStyleFromString(const QString& style);
+
+/**
+ * @brief A font face to import: a font with a given size and style,
+ *        and characters to include (printable ASCII if empty).
+ */
+struct FontVariant
+{
+    QFont font;
+    QString characters;
+
+    /// A name identifying the variant, usable as a file name, e.g. "Monaco_8pt_Bold".
+    QString name() const;
+};
+
+struct BatchImportOptions
+{
+    QDir outputDirectory;
+    /// Whether to save a font document (.fontedit) for every variant.
+    bool writeDocuments { true };
+    /// Source code files to generate for every variant, see \c ConversionTarget.
+    std::vector<ConversionTarget> sourceCodeTargets;
+    f2b::source_code_options sourceCodeOptions;
+    QString fontArrayName { "font" };
+    /// Number of variants imported concurrently; 0 means QThread::idealThreadCount().
+    int threadCount { 0 };
+    /// Cache used when rasterizing glyphs, saved once all variants are imported.
+    GlyphRasterCache *cache { nullptr };
+    QFontFaceReader::engine renderingEngine { QFontFaceReader::engine::text_document };
+};
+
+struct BatchImportResult
+{
+    QString name;
+    std::size_t numGlyphs { 0 };
+    double rasterizeTime { 0 }; // ms
+    double writeTime { 0 }; // ms
+    QStringList files;
+    std::optional<QString> error;
+};
+
+struct BatchImportReport
+{
+    std::vector<BatchImportResult> results;
+    double wallTime { 0 }; // ms
+
+    std::size_t numImported() const;
+    std::size_t numGlyphs() const;
+    double variantsPerSecond() const;
+    double glyphsPerSecond() const;
+
+    /// A one-line summary of the import, with throughput.
+    QString summary() const;
+};
+
+/**
+ * @brief Imports many font variants at once, rasterizing them concurrently
+ *        with \c QFontFaceReader and writing documents and/or source code
+ *        for each of them.
+ *
+ * Requires a QGuiApplication instance (for font rasterization).
+ */
+class BatchImport
+{
+public:
+    /// Called from worker threads after every imported variant.
+    using ProgressHandler = std::function<void(std::size_t finished, std::size_t total)>;
+
+    explicit BatchImport(BatchImportOptions options);
+
+    /// Builds all combinations of \c families, \c pointSizes and \c styles.
+    static std::vector<FontVariant> variants(const QStringList& families,
+                                             const std::vector<int>& pointSizes,
+                                             const std::vector<FontStyle>& styles,
+                                             const QString& characters = {});
+
+    BatchImportReport run(const std::vector<FontVariant>& variants, const ProgressHandler& progress = {}) const;
+
+private:
+    BatchImportResult importVariant(const FontVariant& variant) const;
+
+    BatchImportOptions options_;
+    DocumentConverter converter_;
+};
+
+#endif // BATCHIMPORT_H
@@ -0,0 +1,178 @@
+#include "batchimportdialog.h"
+#include "./ui_batchimportdialog.h"
+#include "batchimport.h"
+#include "glyphrastercache.h"
+
+#include <QFileDialog>
+#include <QPushButton>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <functional>
+
+class BatchImportDialogRunnable : public QRunnable
+{
+public:
+    explicit BatchImportDialogRunnable(std::function<void()> f) : f_ { std::move(f) } {}
+    void run() override { f_(); }
+
+private:
+    std::function<void()> f_;
+};
+
+BatchImportDialog::BatchImportDialog(f2b::source_code_options options, const QString& format,
+                                     const QString& fontArrayName, const QString& directoryPath,
+                                     QWidget *parent) :
+    QDialog(parent),
+    ui_ { new Ui::BatchImportDialog },
+    options_ { options },
+    format_ { format },
+    fontArrayName_ { fontArrayName }
+{
+    ui_->setupUi(this);
+
+    ui_->fontComboBox->setFontFilters(QFontComboBox::MonospacedFonts);
+    ui_->outputDirectoryLineEdit->setText(directoryPath);
+    ui_->progressBar->setVisible(false);
+    ui_->reportLabel->setText({});
+
+    auto importButton = ui_->buttonBox->addButton(tr("Import"), QDialogButtonBox::ActionRole);
+    importButton->setDefault(true);
+
+    connect(ui_->addFamilyButton, &QPushButton::clicked, this, &BatchImportDialog::addFamily);
+    connect(ui_->removeFamilyButton, &QPushButton::clicked, this, &BatchImportDialog::removeSelectedFamilies);
+    connect(ui_->browseButton, &QPushButton::clicked, this, &BatchImportDialog::chooseOutputDirectory);
+    connect(importButton, &QPushButton::clicked, this, &BatchImportDialog::startImport);
+    connect(ui_->buttonBox, &QDialogButtonBox::rejected, this, &BatchImportDialog::reject);
+
+    connect(this, &BatchImportDialog::progressChanged, this, [&](int finished, int total) {
+        ui_->progressBar->setMaximum(total);
+        ui_->progressBar->setValue(finished);
+    });
+    connect(this, &BatchImportDialog::importFinished, this, &BatchImportDialog::finishImport);
+}
+
+BatchImportDialog::~BatchImportDialog()
+{
+    delete ui_;
+}
+
+void BatchImportDialog::reject()
+{
+    // Workers report back to the dialog, so keep it open until they're done.
+    if (!isRunning_) {
+        QDialog::reject();
+    }
+}
+
+void BatchImportDialog::addFamily()
+{
+    auto family = ui_->fontComboBox->currentFont().family();
+    if (ui_->familiesList->findItems(family, Qt::MatchExactly).isEmpty()) {
+        ui_->familiesList->addItem(family);
+    }
+}
+
+void BatchImportDialog::removeSelectedFamilies()
+{
+    qDeleteAll(ui_->familiesList->selectedItems());
+}
+
+void BatchImportDialog::chooseOutputDirectory()
+{
+    auto path = QFileDialog::getExistingDirectory(this, tr("Select Output Directory"),
+                                                  ui_->outputDirectoryLineEdit->text());
+    if (!path.isEmpty()) {
+        ui_->outputDirectoryLineEdit->setText(path);
+    }
+}
+
+void BatchImportDialog::startImport()
+{
+    QStringList families;
+    for (int i = 0; i < ui_->familiesList->count(); ++i) {
+        families << ui_->familiesList->item(i)->text();
+    }
+
+    std::vector<int> pointSizes;
+    for (const auto& part : ui_->sizesLineEdit->text().split(',')) {
+        auto value = part.trimmed();
+        if (value.isEmpty()) {
+            continue;
+        }
+        bool ok;
+        auto pointSize = value.toInt(&ok);
+        if (!ok || pointSize <= 0) {
+            ui_->reportLabel->setText(tr("Invalid point size: %1").arg(value));
+            return;
+        }
+        pointSizes.push_back(pointSize);
+    }
+
+    std::vector<FontStyle> styles;
+    if (ui_->regularCheckBox->isChecked()) {
+        styles.push_back(FontStyle::Regular);
+    }
+    if (ui_->boldCheckBox->isChecked()) {
+        styles.push_back(FontStyle::Bold);
+    }
+    if (ui_->italicCheckBox->isChecked()) {
+        styles.push_back(FontStyle::Italic);
+    }
+    if (ui_->boldItalicCheckBox->isChecked()) {
+        styles.push_back(FontStyle::BoldItalic);
+    }
+
+    auto variants = BatchImport::variants(families, pointSizes, styles, ui_->charactersLineEdit->text());
+    if (variants.empty()) {
+        ui_->reportLabel->setText(tr("Select at least one font family, size and style."));
+        return;
+    }
+    if (!ui_->saveDocumentsCheckBox->isChecked() && !ui_->exportSourceCodeCheckBox->isChecked()) {
+        ui_->reportLabel->setText(tr("Select documents and/or source code to be written."));
+        return;
+    }
+
+    BatchImportOptions options;
+    options.outputDirectory = QDir(ui_->outputDirectoryLineEdit->text());
+    options.writeDocuments = ui_->saveDocumentsCheckBox->isChecked();
+    if (ui_->exportSourceCodeCheckBox->isChecked()) {
+        options.sourceCodeTargets.push_back({ format_, DocumentConverter::defaultFilePattern(format_) });
+    }
+    options.sourceCodeOptions = options_;
+    options.fontArrayName = fontArrayName_;
+    options.cache = &GlyphRasterCache::shared();
+
+    setRunning(true);
+    emit progressChanged(0, static_cast<int>(variants.size()));
+
+    auto r = new BatchImportDialogRunnable([this, variants = std::move(variants), options = std::move(options)] {
+        auto report = BatchImport(options).run(variants, [this](std::size_t finished, std::size_t total) {
+            emit progressChanged(static_cast<int>(finished), static_cast<int>(total));
+        });
+
+        QStringList errors;
+        for (const auto& result : report.results) {
+            if (result.error.has_value()) {
+                errors << QString("%1: %2").arg(result.name, result.error.value());
+            }
+        }
+        emit importFinished(report.summary(), errors);
+    });
+    r->setAutoDelete(true);
+    QThreadPool::globalInstance()->start(r);
+}
+
+void BatchImportDialog::finishImport(const QString& summary, const QStringList& errors)
+{
+    setRunning(false);
+    ui_->reportLabel->setText(errors.isEmpty() ? summary : QStringList({ summary, errors.join('\n') }).join('\n'));
+}
+
+void BatchImportDialog::setRunning(bool isRunning)
+{
+    isRunning_ = isRunning;
+    ui_->progressBar->setVisible(true);
+    ui_->settingsWidget->setEnabled(!isRunning);
+    ui_->buttonBox->setEnabled(!isRunning);
+}
@@ -0,0 +1,50 @@
+#ifndef BATCHIMPORTDIALOG_H
+#define BATCHIMPORTDIALOG_H
+
+#include <QDialog>
+#include <f2b.h>
+
+namespace Ui {
+class BatchImportDialog;
+}
+
+/**
+ * @brief A dialog importing a matrix of font families, sizes and styles
+ *        with \c BatchImport, saving documents and/or source code for each variant.
+ */
+class BatchImportDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Source code is generated in \c format (identifier) with \c options,
+     * and documents and source code are written to \c directoryPath by default.
+     */
+    explicit BatchImportDialog(f2b::source_code_options options, const QString& format,
+                               const QString& fontArrayName, const QString& directoryPath,
+                               QWidget *parent = nullptr);
+    ~BatchImportDialog();
+
+    void reject() override;
+
+signals:
+    void progressChanged(int finished, int total);
+    void importFinished(const QString& summary, const QStringList& errors);
+
+private:
+    void addFamily();
+    void removeSelectedFamilies();
+    void chooseOutputDirectory();
+    void startImport();
+    void finishImport(const QString& summary, const QStringList& errors);
+    void setRunning(bool isRunning);
+
+    Ui::BatchImportDialog *ui_;
+    f2b::source_code_options options_;
+    QString format_;
+    QString fontArrayName_;
+    bool isRunning_ { false };
+};
+
+#endif // BATCHIMPORTDIALOG_H
@@ -4,17 +4,46 @@
 #include <QUndoCommand>
 #include "facewidget.h"
 #include "mainwindowmodel.h"
+#include "glyphdelta.h"
 
-class Command : public QUndoCommand
+#include <memory>
+#include <vector>
+
+/**
+ * @brief A command stored in \c UndoHistory, reporting memory it holds
+ *        so that the history can be kept within its memory budget.
+ */
+class UndoCommand : public QUndoCommand
+{
+public:
+    using QUndoCommand::QUndoCommand;
+
+    virtual std::size_t memoryUsage() const { return sizeof(UndoCommand); }
+
+    /**
+     * Absorbs an \c older command preceding this one, when old commands
+     * are coalesced to save memory. Returns false if the commands can't be combined.
+     */
+    virtual bool coalesceWith(const UndoCommand *older) {
+        Q_UNUSED(older);
+        return false;
+    }
+};
+
+
+class Command : public UndoCommand
 {
 public:
+    /// \c memoryUsage estimates memory held by the \c undo and \c redo closures.
     Command(const QString& name,
             std::function<void()> undo,
             std::function<void()> redo,
+            std::size_t memoryUsage = 0,
             QUndoCommand *parent = nullptr) :
-        QUndoCommand(name, parent),
+        UndoCommand(name, parent),
         undo_ { undo },
-        redo_ { redo }
+        redo_ { redo },
+        memoryUsage_ { memoryUsage }
     {}
 
     void undo() override { undo_(); }
@@ -22,13 +51,100 @@ public:
 
     int id() const override { return -1; }
 
+    std::size_t memoryUsage() const override { return sizeof(Command) + memoryUsage_; }
+
 protected:
     std::function<void()> undo_;
     std::function<void()> redo_;
+    std::size_t memoryUsage_;
+};
+
+
+/**
+ * @brief Edits pixels of a glyph. Undoing and redoing both flip the pixels
+ *        that differ between glyph states, so a single delta serves both.
+ */
+class GlyphEditCommand : public UndoCommand
+{
+public:
+    using ApplyDelta = std::function<void(std::size_t index, const GlyphDelta& delta)>;
+
+    GlyphEditCommand(const QString& name,
+                     std::size_t index,
+                     GlyphDelta delta,
+                     ApplyDelta apply,
+                     QUndoCommand *parent = nullptr) :
+        UndoCommand(name, parent),
+        index_ { index },
+        delta_ { std::move(delta) },
+        apply_ { std::move(apply) }
+    {}
+
+    void undo() override { apply_(index_, delta_); }
+    void redo() override { apply_(index_, delta_); }
+
+    int id() const override { return -1; }
+
+    std::size_t memoryUsage() const override {
+        return sizeof(GlyphEditCommand) - sizeof(GlyphDelta) + delta_.memoryUsage();
+    }
+
+    bool coalesceWith(const UndoCommand *older) override {
+        auto command = dynamic_cast<const GlyphEditCommand *>(older);
+        if (command == nullptr || command->index_ != index_) {
+            return false;
+        }
+        delta_ ^= command->delta_;
+        return true;
+    }
+
+private:
+    std::size_t index_;
+    GlyphDelta delta_;
+    ApplyDelta apply_;
+};
+
+
+/// Commands undone and redone together.
+class MacroCommand : public UndoCommand
+{
+public:
+    explicit MacroCommand(const QString& name, QUndoCommand *parent = nullptr) :
+        UndoCommand(name, parent)
+    {}
+
+    void append(std::unique_ptr<UndoCommand> command) {
+        commands_.push_back(std::move(command));
+    }
+
+    void undo() override {
+        for (auto i = commands_.rbegin(); i != commands_.rend(); ++i) {
+            (*i)->undo();
+        }
+    }
+
+    void redo() override {
+        for (auto& command : commands_) {
+            command->redo();
+        }
+    }
+
+    int id() const override { return -1; }
+
+    std::size_t memoryUsage() const override {
+        auto usage = sizeof(MacroCommand);
+        for (const auto& command : commands_) {
+            usage += command->memoryUsage();
+        }
+        return usage;
+    }
+
+private:
+    std::vector<std::unique_ptr<UndoCommand>> commands_;
 };
 
 
-class SwitchActiveGlyphCommand : public QUndoCommand
+class SwitchActiveGlyphCommand : public UndoCommand
 {
 public:
     SwitchActiveGlyphCommand(FaceWidget* faceWidget,
@@ -36,7 +152,7 @@ public:
                              std::size_t fromIndex,
                              std::size_t toIndex,
                              QUndoCommand *parent = nullptr) :
-        QUndoCommand(QObject::tr("Switch Active Glyph"), parent),
+        UndoCommand(QObject::tr("Switch Active Glyph"), parent),
         faceWidget_ { faceWidget },
         viewModel_ { viewModel },
         fromIndex_ { fromIndex },
@@ -59,6 +175,8 @@ public:
 
     int id() const override { return 0xa5b939e9; }
 
+    std::size_t memoryUsage() const override { return sizeof(SwitchActiveGlyphCommand); }
+
     bool mergeWith(const QUndoCommand *other) override {
         if (other->id() != id())
             return false;
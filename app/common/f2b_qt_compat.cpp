@@ -1,10 +1,14 @@
 #include "f2b_qt_compat.h"
 
+#include <QtEndian>
+
+#include <limits>
+
 static constexpr quint32 font_glyph_magic_number = 0x92588c12;
 static constexpr quint32 font_face_magic_number = 0x03f59a82;
 
 static constexpr quint32 font_glyph_version = 1;
-static constexpr quint32 font_face_version = 2;
+static constexpr quint32 font_face_version = 3;
 
 using namespace f2b;
 
@@ -47,9 +51,22 @@ QDataStream& operator<<(QDataStream& s, const font::face& face)
     s.setVersion(QDataStream::Qt_5_7);
     s << (quint32) face.glyphs_size().width;
     s << (quint32) face.glyphs_size().height;
-    s << face.glyphs();
+    // Glyphs are stored like std::vector<font::glyph>
+    s << std_vector_magic_number;
+    s << std_vector_version;
+    s << (quint32) face.num_glyphs();
+    for (const auto& glyph : face.glyphs()) {
+        s << glyph;
+    }
     s << face.exported_glyph_ids();
 
+    s << (quint32) face.code_points().ranges().size();
+    for (const auto& range : face.code_points().ranges()) {
+        s << (quint32) range.first_code_point;
+        s << (quint32) range.first_glyph;
+        s << (quint32) range.length;
+    }
+
     return s;
 
 }
@@ -75,12 +92,253 @@ QDataStream& operator>>(QDataStream& s, font::face& face)
         } else {
             s >> exported_glyph_ids;
         }
-        face = font::face({width, height}, glyphs, exported_glyph_ids);
+
+        // Faces prior to version 3 contain consecutive characters starting from ASCII space.
+        std::optional<font::code_point_map> code_points;
+        if (version >= 3) {
+            quint32 num_ranges;
+            s >> num_ranges;
+
+            std::vector<font::code_point_map::range> ranges;
+            for (quint32 i = 0; i < num_ranges && s.status() == QDataStream::Ok; ++i) {
+                quint32 first_code_point, first_glyph, length;
+                s >> first_code_point >> first_glyph >> length;
+                ranges.push_back({ first_code_point, first_glyph, length });
+            }
+
+            try {
+                code_points = font::code_point_map::from_ranges(std::move(ranges));
+            } catch (const std::invalid_argument&) {
+                s.setStatus(QDataStream::ReadCorruptData);
+                return s;
+            }
+        }
+
+        face = font::face({width, height}, std::move(glyphs), std::move(exported_glyph_ids), std::move(code_points));
     }
 
     return s;
 }
 
+namespace {
+
+class packed_writer
+{
+public:
+    explicit packed_writer(QByteArray& data) : data_ { data } {}
+
+    void write(std::size_t value)
+    {
+        uchar bytes[sizeof(quint32)];
+        qToLittleEndian(static_cast<quint32>(value), bytes);
+        data_.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+private:
+    QByteArray& data_;
+};
+
+class packed_reader
+{
+public:
+    packed_reader(const uchar* data, std::size_t size) :
+        begin_ { data },
+        pos_ { data },
+        end_ { data + size }
+    {}
+
+    bool is_ok() const noexcept { return is_ok_; }
+    std::size_t offset() const noexcept { return static_cast<std::size_t>(pos_ - begin_); }
+    std::size_t bytes_left() const noexcept { return static_cast<std::size_t>(end_ - pos_); }
+
+    std::size_t read()
+    {
+        if (!is_ok_ || bytes_left() < sizeof(quint32)) {
+            is_ok_ = false;
+            return 0;
+        }
+        auto value = qFromLittleEndian<quint32>(pos_);
+        pos_ += sizeof(quint32);
+        return value;
+    }
+
+private:
+    const uchar* begin_;
+    const uchar* pos_;
+    const uchar* end_;
+    bool is_ok_ { true };
+};
+
+} // namespace
+
+QByteArray pack_face(const font::face& face)
+{
+    auto size = face.glyphs_size();
+    auto row_size = (size.width + 7) / 8;
+
+    // Exported glyph IDs as runs of consecutive IDs
+    std::vector<std::pair<std::size_t, std::size_t>> exported_ranges;
+    for (auto id : face.exported_glyph_ids()) {
+        if (!exported_ranges.empty() && exported_ranges.back().first + exported_ranges.back().second == id) {
+            ++exported_ranges.back().second;
+        } else {
+            exported_ranges.emplace_back(id, 1);
+        }
+    }
+    const auto& code_point_ranges = face.code_points().ranges();
+
+    QByteArray data;
+    data.reserve(static_cast<int>(sizeof(quint32) * (5 + 2 * exported_ranges.size() + 3 * code_point_ranges.size())
+                                  + face.num_glyphs() * size.height * row_size));
+
+    packed_writer w { data };
+    w.write(size.width);
+    w.write(size.height);
+    w.write(face.num_glyphs());
+
+    w.write(exported_ranges.size());
+    for (const auto& [first, length] : exported_ranges) {
+        w.write(first);
+        w.write(length);
+    }
+
+    w.write(code_point_ranges.size());
+    for (const auto& range : code_point_ranges) {
+        w.write(range.first_code_point);
+        w.write(range.first_glyph);
+        w.write(range.length);
+    }
+
+    for (const auto& glyph : face.glyphs()) {
+        pack_glyph(glyph, data);
+    }
+
+    return data;
+}
+
+void pack_glyph_row(const font::glyph& glyph, std::size_t y, uchar* bytes)
+{
+    auto row_size = (glyph.size().width + 7) / 8;
+    auto words = glyph.row_data(y);
+    for (std::size_t i = 0; i < row_size; ++i) {
+        auto shift = 8 * (i % sizeof(font::glyph::word_type));
+        bytes[i] = static_cast<uchar>((words[i / sizeof(font::glyph::word_type)] >> shift) & 0xff);
+    }
+}
+
+void pack_glyph(const font::glyph& glyph, QByteArray& data)
+{
+    auto row_size = (glyph.size().width + 7) / 8;
+    std::vector<uchar> row(row_size);
+    for (std::size_t y = 0; y < glyph.size().height; ++y) {
+        pack_glyph_row(glyph, y, row.data());
+        data.append(reinterpret_cast<const char*>(row.data()), static_cast<int>(row_size));
+    }
+}
+
+std::optional<font::glyph> unpack_glyph(font::glyph_size size, const QByteArray& data)
+{
+    packed_face_layout layout;
+    layout.glyph_size = size;
+    layout.num_glyphs = 1;
+    if (static_cast<std::size_t>(data.size()) < layout.glyph_offset(1)) {
+        return {};
+    }
+    return packed_face_reader { std::move(layout), reinterpret_cast<const uchar*>(data.constData()) }.read_glyph(0);
+}
+
+std::optional<font::face> unpack_face(const QByteArray& data)
+{
+    auto layout = packed_face_layout::parse(reinterpret_cast<const uchar*>(data.constData()),
+                                            static_cast<std::size_t>(data.size()));
+    if (!layout.has_value()) {
+        return {};
+    }
+
+    auto exported_glyph_ids = layout->exported_glyph_ids;
+    font::face face { packed_face_reader { std::move(layout.value()), reinterpret_cast<const uchar*>(data.constData()) } };
+    face.exported_glyph_ids() = std::move(exported_glyph_ids);
+    return face;
+}
+
+// Empty glyphs take no pixel data that would bound their number, so limit it
+// to the number of Unicode code points instead.
+static constexpr std::size_t max_num_empty_glyphs = 0x110000;
+
+std::optional<packed_face_layout> packed_face_layout::parse(const uchar* data, std::size_t size)
+{
+    packed_reader r { data, size };
+    packed_face_layout layout;
+    layout.glyph_size.width = r.read();
+    layout.glyph_size.height = r.read();
+    layout.num_glyphs = r.read();
+    auto glyph_bytes = layout.row_size() * layout.glyph_size.height;
+
+    // Check the pixel data size up front, so that a corrupt header doesn't allocate a huge face.
+    if (!r.is_ok() || (glyph_bytes > 0 && r.bytes_left() / glyph_bytes < layout.num_glyphs)
+            || (glyph_bytes == 0 && layout.num_glyphs > max_num_empty_glyphs))
+    {
+        return {};
+    }
+
+    auto num_exported_ranges = r.read();
+    for (std::size_t i = 0; i < num_exported_ranges && r.is_ok(); ++i) {
+        auto first = r.read();
+        auto length = r.read();
+        if (first + length > layout.num_glyphs) {
+            return {};
+        }
+        for (auto id = first; id < first + length; ++id) {
+            layout.exported_glyph_ids.insert(layout.exported_glyph_ids.end(), id);
+        }
+    }
+
+    std::vector<font::code_point_map::range> ranges;
+    auto num_code_point_ranges = r.read();
+    for (std::size_t i = 0; i < num_code_point_ranges && r.is_ok(); ++i) {
+        auto first_code_point = r.read();
+        auto first_glyph = r.read();
+        auto length = r.read();
+        if (first_glyph + length > layout.num_glyphs
+                || first_code_point + length > std::size_t { std::numeric_limits<char32_t>::max() } + 1)
+        {
+            return {};
+        }
+        ranges.push_back({ static_cast<char32_t>(first_code_point), first_glyph, length });
+    }
+
+    if (!r.is_ok() || (glyph_bytes > 0 && r.bytes_left() / glyph_bytes < layout.num_glyphs)) {
+        return {};
+    }
+
+    try {
+        layout.code_points = font::code_point_map::from_ranges(std::move(ranges));
+    } catch (const std::invalid_argument&) {
+        return {};
+    }
+    layout.pixels_offset = r.offset();
+
+    return layout;
+}
+
+bool packed_face_reader::is_pixel_set(std::size_t glyph_id, font::point p) const
+{
+    auto byte = data_[layout_.glyph_offset(glyph_id) + p.y * layout_.row_size() + p.x / 8];
+    return (byte >> (p.x % 8)) & 1u;
+}
+
+void packed_face_reader::read_row(std::size_t glyph_id, std::size_t y, font::glyph::word_type* row) const
+{
+    auto row_size = layout_.row_size();
+    auto bytes = data_ + layout_.glyph_offset(glyph_id) + y * row_size;
+
+    std::fill(row, row + font::glyph::words_per_row(layout_.glyph_size.width), 0);
+    for (std::size_t i = 0; i < row_size; ++i) {
+        auto shift = 8 * (i % sizeof(font::glyph::word_type));
+        row[i / sizeof(font::glyph::word_type)] |= font::glyph::word_type { bytes[i] } << shift;
+    }
+}
+
 QVariant to_qvariant(const source_code::indentation& i) {
     if (std::holds_alternative<source_code::tab>(i)) {
         return QVariant(-1);
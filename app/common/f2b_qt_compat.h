@@ -10,6 +10,7 @@
 #include "common.h"
 
 #include <QDataStream>
+#include <QIODevice>
 #include <optional>
 #include <vector>
 #include <unordered_map>
@@ -41,29 +42,16 @@ inline QSize qsize_with_size(const font::glyph_size &s)
     return QSize { static_cast<int>(s.width), static_cast<int>(s.height) };
 }
 
-inline QImage glyph_preview_image(const font::glyph &g, font::margins m)
-{
-    auto useful_glyph_size = g.size();
-    useful_glyph_size.height -= m.top + m.bottom;
-
-    auto useful_image_size = qsize_with_size(useful_glyph_size);
-
-    QImage image(useful_image_size, QImage::Format_Mono);
-    image.fill(1);
-
-    for (std::vector<bool>::size_type y = 0; y < useful_glyph_size.height; ++y) {
-        for (std::vector<bool>::size_type x = 0; x < useful_glyph_size.width; ++x) {
-            if (g.is_pixel_set({x, y + m.top})) {
-                image.setPixel(x, y, 0);
-            }
-        }
-    }
+} // namespace Font
 
-    return image;
+/// A source code output sink writing to \c device.
+inline output_sink qiodevice_sink(QIODevice &device)
+{
+    return [&device](const char* data, std::size_t size) {
+        device.write(data, static_cast<qint64>(size));
+    };
 }
 
-} // namespace Font
-
 } // namespace f2b
 
 
@@ -318,6 +306,81 @@ QDataStream& operator>>(QDataStream& s, f2b::font::glyph& glyph);
 QDataStream& operator<<(QDataStream& s, const f2b::font::face& face);
 QDataStream& operator>>(QDataStream& s, f2b::font::face& face);
 
+/**
+ * Encodes \c face in a compact form used by font documents: a single header
+ * with the glyph size and glyph count, exported glyph IDs and code points
+ * as ranges, followed by bit-packed pixel rows (<tt>(width + 7) / 8</tt> bytes
+ * per row, LSB first). All integers are little-endian 32-bit values.
+ */
+QByteArray pack_face(const f2b::font::face& face);
+
+/// Decodes a face encoded with \c pack_face. Returns nothing if \c data is corrupt.
+std::optional<f2b::font::face> unpack_face(const QByteArray& data);
+
+/// Appends pixel rows of \c glyph to \c data, packed like glyphs in \c pack_face.
+void pack_glyph(const f2b::font::glyph& glyph, QByteArray& data);
+
+/**
+ * Writes row \c y of \c glyph to \c bytes as packed in \c pack_face, which is also
+ * the layout of \c QImage::Format_MonoLSB scan lines.
+ */
+void pack_glyph_row(const f2b::font::glyph& glyph, std::size_t y, uchar* bytes);
+
+/// Decodes a glyph of a given size packed with \c pack_glyph. Returns nothing if \c data is too short.
+std::optional<f2b::font::glyph> unpack_glyph(f2b::font::glyph_size size, const QByteArray& data);
+
+/**
+ * @brief The header of a face encoded with \c pack_face.
+ *
+ * Glyphs take the same number of bytes, so the header doubles as an index
+ * of glyph offsets.
+ */
+struct packed_face_layout
+{
+    f2b::font::glyph_size glyph_size;
+    std::size_t num_glyphs { 0 };
+    std::set<std::size_t> exported_glyph_ids;
+    f2b::font::code_point_map code_points;
+    /// Offset of the first glyph from the beginning of the data.
+    std::size_t pixels_offset { 0 };
+
+    std::size_t row_size() const noexcept { return (glyph_size.width + 7) / 8; }
+    std::size_t glyph_offset(std::size_t index) const noexcept {
+        return pixels_offset + index * row_size() * glyph_size.height;
+    }
+
+    /**
+     * Reads the header of \c size bytes of packed face data. Returns nothing if the header
+     * is corrupt or the data is too short to hold all glyphs.
+     */
+    static std::optional<packed_face_layout> parse(const uchar* data, std::size_t size);
+};
+
+/**
+ * @brief A face reader decoding glyphs directly from packed face data.
+ *
+ * \c data must stay valid for the lifetime of the reader.
+ */
+class packed_face_reader : public f2b::font::face_reader
+{
+public:
+    packed_face_reader(packed_face_layout layout, const uchar* data) :
+        layout_ { std::move(layout) },
+        data_ { data }
+    {}
+
+    const packed_face_layout& layout() const noexcept { return layout_; }
+
+    f2b::font::glyph_size font_size() const override { return layout_.glyph_size; }
+    std::size_t num_glyphs() const override { return layout_.num_glyphs; }
+    bool is_pixel_set(std::size_t glyph_id, f2b::font::point p) const override;
+    void read_row(std::size_t glyph_id, std::size_t y, f2b::font::glyph::word_type* row) const override;
+    f2b::font::code_point_map code_points() const override { return layout_.code_points; }
+
+private:
+    packed_face_layout layout_;
+    const uchar* data_;
+};
 
 QVariant to_qvariant(const f2b::source_code::indentation& i);
 f2b::source_code::indentation from_qvariant(const QVariant& v);
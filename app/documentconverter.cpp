@@ -0,0 +1,131 @@
+#include "documentconverter.h"
+#include "fontfaceviewmodel.h"
+#include "sourcecoderunnable.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <memory>
+#include <stdexcept>
+
+static double elapsedMilliseconds(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+double ConversionResult::totalTime() const
+{
+    auto time = loadTime;
+    for (const auto& output : outputs) {
+        time += output.generateTime + output.writeTime;
+    }
+    return time;
+}
+
+DocumentConverter::DocumentConverter(f2b::source_code_options options, QString fontArrayName,
+                                     std::vector<ConversionTarget> targets, QDir outputDirectory) :
+    options_ { options },
+    fontArrayName_ { std::move(fontArrayName) },
+    targets_ { std::move(targets) },
+    outputDirectory_ { std::move(outputDirectory) }
+{
+}
+
+QStringList DocumentConverter::formats()
+{
+    return {
+        QString::fromStdString(std::string(f2b::format::c::identifier)),
+        QString::fromStdString(std::string(f2b::format::arduino::identifier)),
+        QString::fromStdString(std::string(f2b::format::python_list::identifier)),
+        QString::fromStdString(std::string(f2b::format::python_bytes::identifier))
+    };
+}
+
+QString DocumentConverter::defaultFilePattern(const QString& format)
+{
+    if (format == f2b::format::c::identifier.data()) {
+        return "{name}.c";
+    } else if (format == f2b::format::arduino::identifier.data()) {
+        return "{name}.h";
+    } else if (format == f2b::format::python_list::identifier.data()) {
+        return "{name}.py";
+    } else if (format == f2b::format::python_bytes::identifier.data()) {
+        return "{name}_bytes.py";
+    }
+    return QString("{name}.%1").arg(format);
+}
+
+QString DocumentConverter::filePath(const QString& pattern, const QString& documentName) const
+{
+    auto fileName = QString(pattern).replace("{name}", documentName);
+    return QDir::cleanPath(outputDirectory_.absoluteFilePath(fileName));
+}
+
+ConversionResult DocumentConverter::convert(const QString& documentPath) const
+{
+    ConversionResult result;
+    result.documentPath = documentPath;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::unique_ptr<FontFaceViewModel> document;
+    try {
+        document = std::make_unique<FontFaceViewModel>(documentPath);
+    } catch (const std::exception& e) {
+        result.error = QString::fromStdString(e.what());
+        return result;
+    }
+    result.loadTime = elapsedMilliseconds(timer);
+
+    if (document->face().num_glyphs() == 0) {
+        result.error = QString("%1 is not a font document or has no glyphs").arg(documentPath);
+        return result;
+    }
+
+    writeTargets(document->face(), QFileInfo(documentPath).completeBaseName(), result);
+    return result;
+}
+
+ConversionResult DocumentConverter::convert(const f2b::font::face& face, const QString& name) const
+{
+    ConversionResult result;
+    result.documentPath = name;
+    writeTargets(face, name, result);
+    return result;
+}
+
+void DocumentConverter::writeTargets(const f2b::font::face& face, const QString& documentName, ConversionResult& result) const
+{
+    auto fontArrayName = QString(fontArrayName_).replace("{name}", documentName).toStdString();
+    f2b::font_source_code_generator generator { options_ };
+    QElapsedTimer timer;
+
+    for (const auto& target : targets_) {
+        ConversionResult::Output output;
+        output.format = target.format;
+        output.filePath = filePath(target.filePattern, documentName);
+
+        timer.start();
+        std::string sourceCode;
+        SourceCodeRunnable::generate(face, generator, target.format.toStdString(),
+                                     fontArrayName, f2b::string_sink(sourceCode));
+        output.generateTime = elapsedMilliseconds(timer);
+        output.size = static_cast<qint64>(sourceCode.size());
+
+        timer.restart();
+        QDir().mkpath(QFileInfo(output.filePath).path());
+        QSaveFile f(output.filePath);
+        if (!f.open(QIODevice::WriteOnly) ||
+                f.write(sourceCode.data(), output.size) != output.size ||
+                !f.commit())
+        {
+            result.error = QString("Unable to write to file %1: %2").arg(output.filePath, f.errorString());
+            return;
+        }
+        output.writeTime = elapsedMilliseconds(timer);
+
+        result.outputs.push_back(std::move(output));
+    }
+}
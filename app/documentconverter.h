@@ -0,0 +1,81 @@
+#ifndef DOCUMENTCONVERTER_H
+#define DOCUMENTCONVERTER_H
+
+#include <QDir>
+#include <QString>
+#include <QStringList>
+#include <f2b.h>
+
+#include <optional>
+#include <vector>
+
+/**
+ * @brief A source code file to generate from a font document.
+ *
+ * \c filePattern may contain a \c {name} placeholder, replaced with the base name
+ * of the document. Relative paths are resolved against the output directory.
+ */
+struct ConversionTarget
+{
+    QString format; // identifier
+    QString filePattern;
+};
+
+struct ConversionResult
+{
+    struct Output
+    {
+        QString format;
+        QString filePath;
+        qint64 size { 0 };
+        double generateTime { 0 }; // ms
+        double writeTime { 0 }; // ms
+    };
+
+    QString documentPath;
+    double loadTime { 0 }; // ms
+    std::vector<Output> outputs;
+    std::optional<QString> error;
+
+    double totalTime() const;
+};
+
+/**
+ * @brief Converts font documents to source code files without any UI.
+ *
+ * Documents are loaded with \c FontFaceViewModel and converted with
+ * \c f2b::font_source_code_generator to every target, measuring time spent
+ * in each stage. \c convert is thread-safe, so multiple documents may be
+ * converted in parallel.
+ */
+class DocumentConverter
+{
+public:
+    DocumentConverter(f2b::source_code_options options, QString fontArrayName,
+                      std::vector<ConversionTarget> targets, QDir outputDirectory);
+
+    /// Loads a document and generates all targets for it.
+    ConversionResult convert(const QString& documentPath) const;
+
+    /**
+     * Generates all targets for \c face, using \c name in place of the document
+     * base name. Only generation and writing times are set in the result.
+     */
+    ConversionResult convert(const f2b::font::face& face, const QString& name) const;
+
+    /// Format identifiers supported by the generator.
+    static QStringList formats();
+    /// The file name pattern used for \c format when no file is given.
+    static QString defaultFilePattern(const QString& format);
+
+private:
+    QString filePath(const QString& pattern, const QString& documentName) const;
+    void writeTargets(const f2b::font::face& face, const QString& documentName, ConversionResult& result) const;
+
+    f2b::source_code_options options_;
+    QString fontArrayName_;
+    std::vector<ConversionTarget> targets_;
+    QDir outputDirectory_;
+};
+
+#endif // DOCUMENTCONVERTER_H
@@ -0,0 +1,469 @@
+#include "documentjournal.h"
+#include "f2b_qt_compat.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+static constexpr quint32 document_journal_magic_number = 0x5e1d7a0b;
+static constexpr quint32 document_journal_version = 2;
+// Version 1 stored pixel changes as a list of (x, y, value) entries
+static constexpr quint32 document_journal_version_pixel_list = 1;
+// Magic number, version and document fingerprint
+static constexpr qint64 document_journal_header_size = 2 * sizeof(quint32) + 2 * sizeof(qint64);
+
+enum class RecordType : quint8 {
+    Commit,
+    PixelChange,
+    SetGlyph,
+    AppendGlyph,
+    DeleteGlyph,
+    SetGlyphExported,
+    // Records before it are being merged into the document file
+    Compaction
+};
+
+static QDataStream& operator<<(QDataStream& s, RecordType type)
+{
+    return s << static_cast<quint8>(type);
+}
+
+static QByteArray serialize(const DocumentJournal::Record& record)
+{
+    QByteArray bytes;
+    QDataStream s(&bytes, QIODevice::WriteOnly);
+    s.setVersion(QDataStream::Qt_5_7);
+
+    std::visit([&](const auto& r) {
+        using T = std::decay_t<decltype(r)>;
+        if constexpr (std::is_same_v<T, DocumentJournal::PixelChange>) {
+            QByteArray touched, values;
+            pack_glyph(r.change.touched(), touched);
+            pack_glyph(r.change.values(), values);
+            auto size = r.change.size();
+            s << RecordType::PixelChange << (quint32) r.index << (quint32) size.width << (quint32) size.height
+              << touched << values;
+        } else if constexpr (std::is_same_v<T, DocumentJournal::SetGlyph>) {
+            QByteArray packed;
+            pack_glyph(r.glyph, packed);
+            s << RecordType::SetGlyph << (quint32) r.index << packed;
+        } else if constexpr (std::is_same_v<T, DocumentJournal::AppendGlyph>) {
+            QByteArray packed;
+            pack_glyph(r.glyph, packed);
+            s << RecordType::AppendGlyph << packed;
+        } else if constexpr (std::is_same_v<T, DocumentJournal::DeleteGlyph>) {
+            s << RecordType::DeleteGlyph << (quint32) r.index;
+        } else if constexpr (std::is_same_v<T, DocumentJournal::SetGlyphExported>) {
+            s << RecordType::SetGlyphExported << (quint32) r.index << r.isExported;
+        }
+    }, record);
+
+    return bytes;
+}
+
+static std::optional<f2b::font::glyph> readGlyph(QDataStream& s, f2b::font::glyph_size glyphSize)
+{
+    QByteArray packed;
+    s >> packed;
+    return unpack_glyph(glyphSize, packed);
+}
+
+static std::optional<BatchPixelChange> readPixelMasks(QDataStream& s, f2b::font::glyph_size glyphSize)
+{
+    quint32 width, height;
+    s >> width >> height;
+    if (s.status() != QDataStream::Ok || width != glyphSize.width || height != glyphSize.height) {
+        return {};
+    }
+    auto touched = readGlyph(s, glyphSize);
+    auto values = readGlyph(s, glyphSize);
+    if (!touched.has_value() || !values.has_value()) {
+        return {};
+    }
+    return BatchPixelChange::fromMasks(touched.value(), values.value());
+}
+
+static std::optional<BatchPixelChange> readPixelList(QDataStream& s, f2b::font::glyph_size glyphSize)
+{
+    quint32 count;
+    s >> count;
+    BatchPixelChange change { glyphSize };
+    for (quint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+        quint32 x, y;
+        bool value;
+        s >> x >> y >> value;
+        if (x >= glyphSize.width || y >= glyphSize.height) {
+            return {};
+        } else if (s.status() == QDataStream::Ok) {
+            change.add({ x, y }, value);
+        }
+    }
+    if (s.status() != QDataStream::Ok) {
+        return {};
+    }
+    return change;
+}
+
+QString DocumentJournal::journalPath(const QString &documentPath)
+{
+    return documentPath + ".journal";
+}
+
+std::optional<DocumentJournal::Contents> DocumentJournal::read(const QString &documentPath,
+                                                               f2b::font::glyph_size glyphSize)
+{
+    QFile f(journalPath(documentPath));
+    if (!f.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    auto data = f.readAll();
+    f.close();
+
+    QDataStream s(data);
+    s.setVersion(QDataStream::Qt_5_7);
+
+    quint32 magic_number, version;
+    Fingerprint fingerprint;
+    s >> magic_number >> version >> fingerprint.size >> fingerprint.lastModified;
+    if (s.status() != QDataStream::Ok || magic_number != document_journal_magic_number) {
+        return {};
+    }
+    if (version != document_journal_version && version != document_journal_version_pixel_list) {
+        throw std::runtime_error { "Journal " + journalPath(documentPath).toStdString()
+                                   + " was written by a newer version of the application" };
+    }
+    auto matchesDocument = fingerprint == documentFingerprint(documentPath);
+
+    Contents contents;
+    contents.savedSize = contents.size = document_journal_header_size;
+    contents.isOutdated = version != document_journal_version;
+    // Number of records merged into the document file by the last compaction, if any
+    std::optional<std::size_t> numCompactedRecords;
+    std::optional<std::size_t> numPendingCompactedRecords;
+
+    // A record cut short (e.g. by a crash while writing it) ends the journal.
+    while (!s.atEnd()) {
+        quint8 type;
+        s >> type;
+
+        std::optional<Record> record;
+        switch (static_cast<RecordType>(type)) {
+        case RecordType::Commit:
+            std::move(contents.unsaved.begin(), contents.unsaved.end(), std::back_inserter(contents.saved));
+            contents.unsaved.clear();
+            if (numPendingCompactedRecords.has_value()) {
+                numCompactedRecords = numPendingCompactedRecords;
+                numPendingCompactedRecords = {};
+            }
+            break;
+        case RecordType::Compaction:
+            numPendingCompactedRecords = contents.saved.size() + contents.unsaved.size();
+            break;
+        case RecordType::PixelChange: {
+            quint32 index;
+            s >> index;
+            std::optional<BatchPixelChange> change;
+            if (version == document_journal_version_pixel_list) {
+                change = readPixelList(s, glyphSize);
+            } else {
+                change = readPixelMasks(s, glyphSize);
+            }
+            if (change.has_value()) {
+                record = PixelChange { index, std::move(change.value()) };
+            } else {
+                s.setStatus(QDataStream::ReadCorruptData);
+            }
+            break;
+        }
+        case RecordType::SetGlyph: {
+            quint32 index;
+            s >> index;
+            if (auto glyph = readGlyph(s, glyphSize)) {
+                record = SetGlyph { index, std::move(glyph.value()) };
+            } else {
+                s.setStatus(QDataStream::ReadCorruptData);
+            }
+            break;
+        }
+        case RecordType::AppendGlyph:
+            if (auto glyph = readGlyph(s, glyphSize)) {
+                record = AppendGlyph { std::move(glyph.value()) };
+            } else {
+                s.setStatus(QDataStream::ReadCorruptData);
+            }
+            break;
+        case RecordType::DeleteGlyph: {
+            quint32 index;
+            s >> index;
+            record = DeleteGlyph { index };
+            break;
+        }
+        case RecordType::SetGlyphExported: {
+            quint32 index;
+            bool isExported;
+            s >> index >> isExported;
+            record = SetGlyphExported { index, isExported };
+            break;
+        }
+        default:
+            s.setStatus(QDataStream::ReadCorruptData);
+        }
+
+        if (s.status() != QDataStream::Ok) {
+            qWarning() << "journal of" << documentPath << "ends with an incomplete record";
+            break;
+        }
+
+        if (record.has_value()) {
+            contents.unsaved.push_back(std::move(record.value()));
+        }
+        contents.size = s.device()->pos();
+        if (static_cast<RecordType>(type) == RecordType::Commit) {
+            contents.savedSize = contents.size;
+        }
+    }
+
+    if (matchesDocument) {
+        return contents;
+    }
+
+    // The document file was written by a compaction that didn't get to drop
+    // merged records from the journal, so only the remaining ones apply to it.
+    if (numCompactedRecords.has_value() && numCompactedRecords.value() <= contents.saved.size()) {
+        contents.saved.erase(contents.saved.begin(),
+                             contents.saved.begin() + static_cast<std::ptrdiff_t>(numCompactedRecords.value()));
+        contents.isOutdated = true;
+        return contents;
+    }
+
+    // Otherwise the document file was replaced (e.g. copied over or restored from a backup),
+    // and saved edits in the journal don't belong to it.
+    if (!contents.saved.empty()) {
+        throw std::runtime_error { "Journal " + journalPath(documentPath).toStdString()
+                                   + " holds saved edits of another version of the document file."
+                                   " Restore the document file it belongs to, or remove the journal"
+                                   " to discard these edits" };
+    }
+    qWarning() << "ignoring journal of" << documentPath << "with unsaved edits of another version of the document";
+    return {};
+}
+
+void DocumentJournal::remove(const QString &documentPath)
+{
+    QFile::remove(journalPath(documentPath));
+}
+
+DocumentJournal::DocumentJournal(QString documentPath, const std::optional<Contents>& contents) :
+    documentPath_ { std::move(documentPath) },
+    fingerprint_ { documentFingerprint(documentPath_) },
+    file_ { journalPath(documentPath_) }
+{
+    if (!contents.has_value()) {
+        remove(documentPath_);
+        return;
+    }
+
+    if (contents->isOutdated) {
+        rewrite(contents.value());
+        return;
+    }
+
+    if (!file_.open(QIODevice::ReadWrite) || !file_.resize(contents->size) || !file_.seek(contents->size)) {
+        qWarning() << "unable to open journal" << file_.fileName();
+        file_.close();
+        // Don't replace saved records with a new journal.
+        hasFailed_ = true;
+        return;
+    }
+    savedSize_ = contents->savedSize;
+}
+
+DocumentJournal::~DocumentJournal()
+{
+    discardUnsaved();
+}
+
+DocumentJournal::Fingerprint DocumentJournal::documentFingerprint(const QString &documentPath)
+{
+    QFileInfo fileInfo { documentPath };
+    return { fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch() };
+}
+
+QByteArray DocumentJournal::header(const Fingerprint &fingerprint)
+{
+    QByteArray bytes;
+    QDataStream s(&bytes, QIODevice::WriteOnly);
+    s.setVersion(QDataStream::Qt_5_7);
+    s << document_journal_magic_number << document_journal_version << fingerprint.size << fingerprint.lastModified;
+    return bytes;
+}
+
+bool DocumentJournal::matchesDocument() const
+{
+    return documentFingerprint(documentPath_) == fingerprint_;
+}
+
+void DocumentJournal::append(const Record &record)
+{
+    write(serialize(record));
+}
+
+qint64 DocumentJournal::beginCompaction()
+{
+    if (hasFailed_ || !file_.isOpen()) {
+        return savedSize_;
+    }
+
+    // The marker is saved, so that it stays in the journal until the compaction is finished.
+    QByteArray bytes;
+    QDataStream s(&bytes, QIODevice::WriteOnly);
+    s << RecordType::Compaction << RecordType::Commit;
+    if (write(bytes)) {
+        savedSize_ = file_.pos();
+    }
+    return savedSize_;
+}
+
+bool DocumentJournal::hasSavedRecords() const noexcept
+{
+    return savedSize_ > document_journal_header_size;
+}
+
+bool DocumentJournal::commit()
+{
+    if (hasFailed_) {
+        return false;
+    }
+    // Nothing was recorded since the journal was opened.
+    if (!file_.isOpen()) {
+        return true;
+    }
+
+    QByteArray bytes;
+    QDataStream s(&bytes, QIODevice::WriteOnly);
+    s << RecordType::Commit;
+    if (!write(bytes)) {
+        return false;
+    }
+    savedSize_ = file_.pos();
+    return true;
+}
+
+void DocumentJournal::discardUnsaved()
+{
+    if (!file_.isOpen()) {
+        return;
+    }
+
+    if (savedSize_ <= document_journal_header_size) {
+        file_.close();
+        file_.remove();
+        savedSize_ = 0;
+    } else if (file_.pos() > savedSize_) {
+        file_.resize(savedSize_);
+        file_.seek(savedSize_);
+    }
+}
+
+void DocumentJournal::rebase(qint64 offset)
+{
+    if (!file_.isOpen()) {
+        return;
+    }
+
+    file_.seek(offset);
+    auto tail = file_.readAll();
+    file_.close();
+
+    fingerprint_ = documentFingerprint(documentPath_);
+    savedSize_ = qMax<qint64>(savedSize_ - offset, 0);
+
+    if (tail.isEmpty()) {
+        file_.remove();
+        return;
+    }
+
+    // Replace the journal atomically, so that a crash can't leave it truncated.
+    QSaveFile f(file_.fileName());
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "unable to rewrite journal" << file_.fileName();
+        hasFailed_ = true;
+        return;
+    }
+    f.write(header(fingerprint_));
+    f.write(tail);
+    if (!f.commit()) {
+        qWarning() << "unable to rewrite journal" << file_.fileName();
+        hasFailed_ = true;
+        return;
+    }
+
+    if (savedSize_ > 0) {
+        savedSize_ += document_journal_header_size;
+    }
+    if (!file_.open(QIODevice::ReadWrite) || !file_.seek(file_.size())) {
+        qWarning() << "unable to reopen journal" << file_.fileName();
+        file_.close();
+        hasFailed_ = true;
+    }
+}
+
+void DocumentJournal::rewrite(const Contents &contents)
+{
+    QByteArray bytes = header(fingerprint_);
+    for (const auto& record : contents.saved) {
+        bytes += serialize(record);
+    }
+    if (!contents.saved.empty()) {
+        QDataStream s(&bytes, QIODevice::Append);
+        s << RecordType::Commit;
+    }
+    auto savedSize = static_cast<qint64>(bytes.size());
+    for (const auto& record : contents.unsaved) {
+        bytes += serialize(record);
+    }
+
+    // Replace the journal atomically, so that a crash can't leave it truncated.
+    QSaveFile f(file_.fileName());
+    if (!f.open(QIODevice::WriteOnly) || f.write(bytes) != bytes.size() || !f.commit()
+            || !file_.open(QIODevice::ReadWrite) || !file_.seek(file_.size()))
+    {
+        qWarning() << "unable to rewrite journal" << file_.fileName();
+        file_.close();
+        hasFailed_ = true;
+        return;
+    }
+    savedSize_ = savedSize;
+}
+
+bool DocumentJournal::write(const QByteArray &bytes)
+{
+    if (hasFailed_) {
+        return false;
+    }
+
+    if (!file_.isOpen()) {
+        if (!file_.open(QIODevice::ReadWrite | QIODevice::Truncate)
+                || file_.write(header(fingerprint_)) != document_journal_header_size)
+        {
+            qWarning() << "unable to create journal" << file_.fileName();
+            hasFailed_ = true;
+            return false;
+        }
+        savedSize_ = document_journal_header_size;
+    }
+
+    if (file_.write(bytes) != bytes.size() || !file_.flush()) {
+        qWarning() << "unable to write to journal" << file_.fileName();
+        hasFailed_ = true;
+        return false;
+    }
+    return true;
+}
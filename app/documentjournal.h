@@ -0,0 +1,153 @@
+#ifndef DOCUMENTJOURNAL_H
+#define DOCUMENTJOURNAL_H
+
+#include "batchpixelchange.h"
+
+#include <QFile>
+#include <QString>
+#include <f2b.h>
+
+#include <optional>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief An append-only log of edits made to a document, stored next to it
+ *        (see \c journalPath).
+ *
+ * Edits are appended as they happen. Saving a document appends a commit
+ * marker, so a document consists of its file plus edits up to the last
+ * commit marker in the journal. Edits past the last commit marker are
+ * unsaved: they are dropped when the journal is closed cleanly and kept
+ * (to be recovered) if the application quits unexpectedly.
+ *
+ * A journal is tied to the size and modification time of the document file
+ * it was started for. Saved edits are merged into the document file by
+ * compaction (see \c beginCompaction and \c rebase), which marks the records
+ * it merges, so that a journal left behind by a compaction interrupted after
+ * writing the document file still applies to it.
+ */
+class DocumentJournal
+{
+public:
+    /// Pixels of a glyph set to given values.
+    struct PixelChange {
+        std::size_t index;
+        BatchPixelChange change;
+    };
+
+    /// A glyph replaced as a whole.
+    struct SetGlyph {
+        std::size_t index;
+        f2b::font::glyph glyph;
+    };
+
+    struct AppendGlyph {
+        f2b::font::glyph glyph;
+    };
+
+    /// See \c FontFaceViewModel::deleteGlyph.
+    struct DeleteGlyph {
+        std::size_t index;
+    };
+
+    struct SetGlyphExported {
+        std::size_t index;
+        bool isExported;
+    };
+
+    using Record = std::variant<PixelChange, SetGlyph, AppendGlyph, DeleteGlyph, SetGlyphExported>;
+
+    struct Contents {
+        /// Records up to the last commit marker
+        std::vector<Record> saved;
+        /// Records past the last commit marker
+        std::vector<Record> unsaved;
+        /// Journal size up to the last commit marker and up to the last complete record
+        qint64 savedSize { 0 };
+        qint64 size { 0 };
+        /// Whether the journal was written in an older format, and is rewritten once opened for appending
+        bool isOutdated { false };
+    };
+
+    static QString journalPath(const QString& documentPath);
+
+    /**
+     * Reads the journal of a document with glyphs of \c glyphSize. Returns nothing
+     * if there's no journal, or it holds only unsaved edits of another version
+     * of the document file. Throws \c std::runtime_error if it holds saved edits
+     * of another version of the document file, which would be lost otherwise.
+     */
+    static std::optional<Contents> read(const QString& documentPath, f2b::font::glyph_size glyphSize);
+
+    /// Deletes the journal of a document, e.g. after the document file was rewritten.
+    static void remove(const QString& documentPath);
+
+    /**
+     * Opens the journal of \c documentPath for appending, continuing after previously
+     * read \c contents (or replacing an existing journal if there are none).
+     * A new journal file is created on first append.
+     */
+    explicit DocumentJournal(QString documentPath, const std::optional<Contents>& contents = {});
+    ~DocumentJournal();
+
+    DocumentJournal(const DocumentJournal&) = delete;
+    DocumentJournal& operator=(const DocumentJournal&) = delete;
+
+    const QString& documentPath() const noexcept { return documentPath_; }
+
+    /// True if the journal still matches the document file.
+    bool matchesDocument() const;
+
+    void append(const Record& record);
+
+    /// Appends a commit marker, marking all records so far as saved. Returns false on failure.
+    bool commit();
+
+    /**
+     * Marks saved records as being merged into the document file, before the file is
+     * written. Returns the offset to pass to \c rebase once the file is written.
+     * Must be called without unsaved records in the journal.
+     */
+    qint64 beginCompaction();
+
+    /// True if the journal holds saved records not merged into the document file.
+    bool hasSavedRecords() const noexcept;
+
+    /// Drops records past the last commit marker.
+    void discardUnsaved();
+
+    /// Size of the journal up to the last commit marker, in bytes.
+    qint64 savedSize() const noexcept { return savedSize_; }
+
+    /**
+     * Drops records up to \c offset (a commit position previously returned by \c savedSize)
+     * after the document file was rewritten to include them, and ties the journal
+     * to the new document file.
+     */
+    void rebase(qint64 offset);
+
+private:
+    struct Fingerprint {
+        qint64 size;
+        qint64 lastModified;
+
+        bool operator==(const Fingerprint& other) const {
+            return size == other.size && lastModified == other.lastModified;
+        }
+    };
+
+    static Fingerprint documentFingerprint(const QString& documentPath);
+    static QByteArray header(const Fingerprint& fingerprint);
+    bool write(const QByteArray& bytes);
+    void rewrite(const Contents& contents);
+
+    QString documentPath_;
+    Fingerprint fingerprint_;
+    QFile file_;
+    qint64 savedSize_ { 0 };
+    // Set once writing to the journal fails; a failed journal can't be committed.
+    bool hasFailed_ { false };
+};
+
+#endif // DOCUMENTJOURNAL_H
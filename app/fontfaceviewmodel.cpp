@@ -2,19 +2,28 @@
 #include "f2b.h"
 #include "f2b_qt_compat.h"
 #include "qfontfacereader.h"
+#include "glyphrastercache.h"
 
 #include <utility>
 #include <stdexcept>
 #include <cassert>
+#include <memory>
+#include <type_traits>
+#include <variant>
 
 #include <QDebug>
+#include <QFile>
 #include <QPalette>
+#include <QtEndian>
 #include <QFileInfo>
+#include <QSaveFile>
 
 
 f2b::font::face import_face(const QFont &font)
 {
-    QFontFaceReader adapter(font);
+    QFontFaceReader::options opts;
+    opts.cache = &GlyphRasterCache::shared();
+    QFontFaceReader adapter(font, {}, {}, opts);
     return f2b::font::face(adapter);
 }
 
@@ -39,17 +48,37 @@ QString font_name(const QFont &font)
 }
 
 
-FontFaceViewModel::FontFaceViewModel(const QString& documentFilePath)
+FontFaceViewModel::FontFaceViewModel(const QString& documentFilePath) :
+    documentPath_ { documentFilePath }
 {
     QFile f(documentFilePath);
     if (!f.exists() || !f.permissions().testFlag(QFileDevice::ReadUser)) {
         throw std::runtime_error { "Unable to open file " + documentFilePath.toStdString() };
     }
 
-    f.open(QIODevice::ReadOnly);
-    QDataStream s(&f);
-    s >> *this;
-    f.close();
+    if (!loadMappedDocument(documentFilePath)) {
+        // Read the whole document at once and decode it from memory.
+        f.open(QIODevice::ReadOnly);
+        auto data = f.readAll();
+        f.close();
+
+        QDataStream s(data);
+        s >> *this;
+        if (s.status() != QDataStream::Ok) {
+            throw std::runtime_error { "Unable to read file " + documentFilePath.toStdString() };
+        }
+    }
+
+    // Edits saved to the journal are part of the document.
+    journalContents_ = DocumentJournal::read(documentFilePath, face_.glyphs_size());
+    if (journalContents_.has_value()) {
+        replayJournal(journalContents_->saved);
+        // Saved records are only needed to rewrite a journal in an older format.
+        if (!journalContents_->isOutdated) {
+            journalContents_->saved.clear();
+        }
+        originalGlyphs_.clear();
+    }
     isDirty_ = false;
 }
 
@@ -61,13 +90,30 @@ FontFaceViewModel::FontFaceViewModel(f2b::font::face face, std::optional<QString
 }
 
 FontFaceViewModel::FontFaceViewModel(const QFont &font) :
-    FontFaceViewModel(import_face(font), font_name(font))
+    FontFaceViewModel(import_face(font), font)
+{
+}
+
+FontFaceViewModel::FontFaceViewModel(f2b::font::face face, const QFont &font) :
+    FontFaceViewModel(std::move(face), std::optional<QString> { font_name(font) })
 {
     font_ = font;
     isDirty_ = true;
 }
 
 void FontFaceViewModel::saveToFile(const QString &documentPath)
+{
+    writeDocument(documentPath);
+
+    // The document file now contains all edits.
+    closeJournal();
+    DocumentJournal::remove(documentPath);
+    journalContents_ = {};
+    documentPath_ = documentPath;
+    isDirty_ = false;
+}
+
+void FontFaceViewModel::writeDocument(const QString &documentPath) const
 {
     QFile f(documentPath);
     QFile directory(QFileInfo(documentPath).path());
@@ -78,11 +124,137 @@ void FontFaceViewModel::saveToFile(const QString &documentPath)
         throw std::runtime_error { "Unable to write to file: " + documentPath.toStdString() };
     }
 
-    f.open(QIODevice::WriteOnly);
-    QDataStream s(&f);
+    // The document may be mapped into memory, so read all glyphs before overwriting it.
+    face_.load_all_glyphs();
+
+    QSaveFile file(documentPath);
+    file.open(QIODevice::WriteOnly);
+    QDataStream s(&file);
     s << *this;
-    f.close();
+    if (!file.commit()) {
+        throw std::runtime_error { "Unable to write to file: " + documentPath.toStdString() };
+    }
+}
+
+std::size_t FontFaceViewModel::openJournal()
+{
+    if (journal_ || !documentPath_.has_value()) {
+        return 0;
+    }
+
+    std::size_t numRecovered = 0;
+    if (journalContents_.has_value() && !journalContents_->unsaved.empty()) {
+        numRecovered = journalContents_->unsaved.size();
+        replayJournal(journalContents_->unsaved);
+        isDirty_ = true;
+    }
+
+    journal_ = std::make_shared<DocumentJournal>(documentPath_.value(), journalContents_);
+    journalContents_ = {};
+    return numRecovered;
+}
+
+void FontFaceViewModel::closeJournal()
+{
+    if (journal_) {
+        journal_->discardUnsaved();
+        journal_.reset();
+    }
+}
+
+bool FontFaceViewModel::saveIncrementally(const QString &documentPath)
+{
+    if (!journal_ || journal_->documentPath() != documentPath || !journal_->matchesDocument()) {
+        return false;
+    }
+    if (!journal_->commit()) {
+        return false;
+    }
     isDirty_ = false;
+    return true;
+}
+
+bool FontFaceViewModel::shouldCompactJournal() const
+{
+    return journal_ && journal_->hasSavedRecords();
+}
+
+std::optional<FontFaceViewModel::JournalCompaction> FontFaceViewModel::journalCompaction()
+{
+    if (!journal_ || isDirty_) {
+        return {};
+    }
+
+    auto snapshot = *this;
+    snapshot.journal_.reset();
+    auto write = [snapshot = std::move(snapshot), path = journal_->documentPath()] {
+        try {
+            snapshot.writeDocument(path);
+            return true;
+        } catch (const std::exception& e) {
+            qWarning() << "unable to compact journal:" << e.what();
+            return false;
+        }
+    };
+    return JournalCompaction { write, journal_, journal_->beginCompaction() };
+}
+
+void FontFaceViewModel::finishJournalCompaction(const JournalCompaction &compaction)
+{
+    if (journal_ && compaction.journal.lock() == journal_) {
+        journal_->rebase(compaction.journalOffset);
+    }
+}
+
+void FontFaceViewModel::mergeJournal(const QString &documentPath)
+{
+    if (!QFileInfo::exists(DocumentJournal::journalPath(documentPath))) {
+        return;
+    }
+    FontFaceViewModel document { documentPath };
+    document.saveToFile(documentPath);
+}
+
+void FontFaceViewModel::replayJournal(const std::vector<DocumentJournal::Record> &records)
+{
+    try {
+        for (const auto& r : records) {
+            applyJournalRecord(r);
+        }
+    } catch (const std::exception& e) {
+        auto journalPath = DocumentJournal::journalPath(documentPath_.value_or(QString()));
+        throw std::runtime_error { "Unable to apply edits from journal " + journalPath.toStdString() + ": " + e.what() };
+    }
+}
+
+void FontFaceViewModel::applyJournalRecord(const DocumentJournal::Record &record)
+{
+    auto checkIndex = [&](std::size_t index) {
+        if (index >= face_.num_glyphs()) {
+            throw std::out_of_range { "Glyph index out of range" };
+        }
+    };
+
+    std::visit([&](const auto& r) {
+        using T = std::decay_t<decltype(r)>;
+        if constexpr (std::is_same_v<T, DocumentJournal::PixelChange>) {
+            checkIndex(r.index);
+            if (r.change.size() != face_.glyphs_size()) {
+                throw std::out_of_range { "Pixel change size doesn't match glyph size" };
+            }
+            modifyGlyph(r.index, r.change);
+        } else if constexpr (std::is_same_v<T, DocumentJournal::SetGlyph>) {
+            checkIndex(r.index);
+            modifyGlyph(r.index, r.glyph);
+        } else if constexpr (std::is_same_v<T, DocumentJournal::AppendGlyph>) {
+            appendGlyph(r.glyph);
+        } else if constexpr (std::is_same_v<T, DocumentJournal::DeleteGlyph>) {
+            checkIndex(r.index);
+            deleteGlyph(r.index);
+        } else if constexpr (std::is_same_v<T, DocumentJournal::SetGlyphExported>) {
+            setGlyphExportedState(r.index, r.isExported);
+        }
+    }, record);
 }
 
 FaceInfo FontFaceViewModel::faceInfo() const
@@ -98,6 +270,7 @@ void FontFaceViewModel::modifyGlyph(std::size_t index, const f2b::font::glyph &n
     doModifyGlyph(index, [&](f2b::font::glyph &glyph) {
         glyph = new_glyph;
     });
+    record(DocumentJournal::SetGlyph { index, new_glyph });
 }
 
 void FontFaceViewModel::modifyGlyph(std::size_t index,
@@ -107,6 +280,12 @@ void FontFaceViewModel::modifyGlyph(std::size_t index,
     doModifyGlyph(index, [&](f2b::font::glyph& glyph) {
         change.apply(glyph, changeType);
     });
+
+    if (journal_) {
+        // Record values pixels were set to.
+        record(DocumentJournal::PixelChange {
+                   index, changeType == BatchPixelChange::ChangeType::Normal ? change : change.reversed() });
+    }
 }
 
 void FontFaceViewModel::doModifyGlyph(std::size_t idx, std::function<void (f2b::font::glyph&)> change)
@@ -133,6 +312,9 @@ void FontFaceViewModel::doModifyGlyph(std::size_t idx, std::function<void (f2b::
 
 void FontFaceViewModel::reset()
 {
+    for (const auto& [index, glyph] : originalGlyphs_) {
+        record(DocumentJournal::SetGlyph { index, glyph });
+    }
     face_ = originalFace();
     originalGlyphs_.clear();
 }
@@ -140,6 +322,7 @@ void FontFaceViewModel::reset()
 void FontFaceViewModel::resetGlyph(std::size_t index)
 {
     if (isGlyphModified(index)) {
+        record(DocumentJournal::SetGlyph { index, originalGlyphs_.at(index) });
         face_.set_glyph(originalGlyphs_.at(index), index);
         originalGlyphs_.erase(activeGlyphIndex_.value());
         isDirty_ = true;
@@ -148,6 +331,7 @@ void FontFaceViewModel::resetGlyph(std::size_t index)
 
 void FontFaceViewModel::appendGlyph(f2b::font::glyph newGlyph)
 {
+    record(DocumentJournal::AppendGlyph { newGlyph });
     face_.append_glyph(std::move(newGlyph));
     isDirty_ = true;
 }
@@ -162,6 +346,7 @@ void FontFaceViewModel::deleteGlyph(std::size_t index)
     } else {
         face_.clear_glyph(index);
     }
+    record(DocumentJournal::DeleteGlyph { index });
     isDirty_ = true;
 }
 
@@ -175,7 +360,8 @@ f2b::font::face FontFaceViewModel::originalFace() const noexcept
 }
 
 static constexpr auto fontfaceviewmodel_magic_number = 0x1c22f998;
-static constexpr auto fontfaceviewmodel_version = 2;
+// Version 3 stores the face packed with pack_face().
+static constexpr auto fontfaceviewmodel_version = 3;
 
 QDataStream& operator<<(QDataStream& s, const FontFaceViewModel &vm)
 {
@@ -183,7 +369,7 @@ QDataStream& operator<<(QDataStream& s, const FontFaceViewModel &vm)
     s << (qint32) fontfaceviewmodel_version;
     s.setVersion(QDataStream::Qt_5_7);
 
-    s << vm.face_;
+    s << pack_face(vm.face_);
     s << vm.name_;
     s << (quint32) vm.originalMargins_.top << (quint32) vm.originalMargins_.bottom;
 
@@ -199,19 +385,113 @@ QDataStream& operator>>(QDataStream& s, FontFaceViewModel& vm)
     if (magic_number == fontfaceviewmodel_magic_number && version <= fontfaceviewmodel_version) {
         s.setVersion(QDataStream::Qt_5_7);
 
-        s >> vm.face_;
-        s >> vm.name_;
-
-        quint32 top, bottom;
-        s >> top >> bottom;
-        vm.originalMargins_ = { top, bottom };
-        vm.originalGlyphs_ = {};
-        vm.activeGlyphIndex_ = {};
-
-        if (version <= 2) {
-            s >> vm.font_;
+        if (version >= 3) {
+            QByteArray packed_face;
+            s >> packed_face;
+            auto face = unpack_face(packed_face);
+            if (!face.has_value()) {
+                s.setStatus(QDataStream::ReadCorruptData);
+                return s;
+            }
+            vm.face_ = std::move(face.value());
+        } else {
+            s >> vm.face_;
         }
+        vm.readDocumentProperties(s);
     }
 
     return s;
 }
+
+void FontFaceViewModel::readDocumentProperties(QDataStream& s)
+{
+    s >> name_;
+
+    quint32 top, bottom;
+    s >> top >> bottom;
+    originalMargins_ = { top, bottom };
+    originalGlyphs_ = {};
+    activeGlyphIndex_ = {};
+
+    s >> font_;
+}
+
+/**
+ * Reads glyphs of a packed face directly from a document mapped into memory.
+ * The document stays open and mapped for the lifetime of the reader.
+ */
+class MappedFaceReader : public f2b::font::face_reader
+{
+public:
+    MappedFaceReader(std::unique_ptr<QFile> file, packed_face_layout layout, const uchar* data) :
+        file_ { std::move(file) },
+        reader_ { std::move(layout), data }
+    {}
+
+    f2b::font::glyph_size font_size() const override { return reader_.font_size(); }
+    std::size_t num_glyphs() const override { return reader_.num_glyphs(); }
+    bool is_pixel_set(std::size_t glyph_id, f2b::font::point p) const override {
+        return reader_.is_pixel_set(glyph_id, p);
+    }
+    void read_row(std::size_t glyph_id, std::size_t y, f2b::font::glyph::word_type* row) const override {
+        reader_.read_row(glyph_id, y, row);
+    }
+    f2b::font::code_point_map code_points() const override { return reader_.code_points(); }
+
+private:
+    std::unique_ptr<QFile> file_;
+    packed_face_reader reader_;
+};
+
+// Magic number, version and packed face size precede packed face data.
+static constexpr qint64 packedFaceOffset = 3 * sizeof(quint32);
+// Glyphs of a mapped document are read in chunks of about this many bytes.
+static constexpr std::size_t mappedPageSize = 4096;
+
+bool FontFaceViewModel::loadMappedDocument(const QString &documentPath)
+{
+    auto file = std::make_unique<QFile>(documentPath);
+    if (!file->open(QIODevice::ReadOnly) || file->size() < packedFaceOffset) {
+        return false;
+    }
+
+    auto size = file->size();
+    auto data = file->map(0, size);
+    if (data == nullptr) {
+        return false;
+    }
+
+    auto magicNumber = qFromBigEndian<quint32>(data);
+    auto version = qFromBigEndian<quint32>(data + sizeof(quint32));
+    auto packedFaceSize = qFromBigEndian<quint32>(data + 2 * sizeof(quint32));
+    if (magicNumber != static_cast<quint32>(fontfaceviewmodel_magic_number)
+            || version < 3 || version > static_cast<quint32>(fontfaceviewmodel_version)
+            || packedFaceSize == 0xffffffff
+            || packedFaceSize > size - packedFaceOffset)
+    {
+        return false;
+    }
+
+    auto layout = packed_face_layout::parse(data + packedFaceOffset, packedFaceSize);
+    if (!layout.has_value() || layout->num_glyphs < lazyLoadingThreshold) {
+        return false;
+    }
+
+    auto propertiesOffset = packedFaceOffset + packedFaceSize;
+    auto properties = QByteArray::fromRawData(reinterpret_cast<const char*>(data + propertiesOffset),
+                                              static_cast<int>(size - propertiesOffset));
+    QDataStream s(properties);
+    s.setVersion(QDataStream::Qt_5_7);
+    readDocumentProperties(s);
+    if (s.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    auto glyphSize = std::max<std::size_t>(layout->row_size() * layout->glyph_size.height, 1);
+    auto glyphsPerPage = std::max<std::size_t>(mappedPageSize / glyphSize, 1);
+    auto exportedGlyphIds = layout->exported_glyph_ids;
+    auto reader = std::make_shared<MappedFaceReader>(std::move(file), std::move(layout.value()),
+                                                     data + packedFaceOffset);
+    face_ = f2b::font::face(std::move(reader), std::move(exportedGlyphIds), glyphsPerPage);
+    return true;
+}
@@ -8,6 +8,9 @@
 #include <exception>
 #include <unordered_map>
 #include "batchpixelchange.h"
+#include "documentjournal.h"
+#include <functional>
+#include <memory>
 
 struct FaceInfo
 {
@@ -21,13 +24,72 @@ struct FaceInfo
 class FontFaceViewModel
 {
 public:
+    /**
+     * Documents with at least this many glyphs are mapped into memory when opened,
+     * and their glyphs are read on first access.
+     */
+    static constexpr std::size_t lazyLoadingThreshold = 4096;
+
     explicit FontFaceViewModel() = default;
+    /// Opens a document including edits saved to its journal (throws \c std::runtime_error on failure).
     explicit FontFaceViewModel(const QString& documentPath);
     explicit FontFaceViewModel(f2b::font::face face, std::optional<QString> name) noexcept;
     explicit FontFaceViewModel(const QFont& font);
+    /// Creates a document for \c face imported from \c font.
+    explicit FontFaceViewModel(f2b::font::face face, const QFont& font);
 
+    /// Writes the whole document to \c documentPath and stops recording edits in a journal.
     void saveToFile(const QString& documentPath);
 
+    /**
+     * Starts recording edits in the journal of the document (once it has a path),
+     * after replaying edits left unsaved in the journal by a session that didn't
+     * end cleanly. Returns the number of recovered edits.
+     *
+     * Throws \c std::runtime_error if the edits can't be replayed, leaving the journal
+     * untouched and not recording further edits.
+     */
+    std::size_t openJournal();
+
+    /// Drops unsaved edits from the journal and stops recording edits.
+    void closeJournal();
+
+    /**
+     * Saves edits made since the last save by appending a commit marker
+     * to the journal of the document. Returns false if the document can't be saved
+     * this way (it isn't journaled, or its file was modified), and has to be saved
+     * with \c saveToFile instead.
+     */
+    bool saveIncrementally(const QString& documentPath);
+
+    /// A background job merging saved edits from the journal into the document file.
+    struct JournalCompaction {
+        /// Writes the document file. Can run on any thread; returns false on failure.
+        std::function<bool()> write;
+        std::weak_ptr<DocumentJournal> journal;
+        qint64 journalOffset;
+    };
+
+    /// True if the journal holds saved edits not merged into the document file yet.
+    bool shouldCompactJournal() const;
+
+    /**
+     * Prepares compacting the journal, with a snapshot of the document, and marks
+     * the edits it merges in the journal. Returns nothing if the document
+     * has no journal or has unsaved edits.
+     */
+    std::optional<JournalCompaction> journalCompaction();
+
+    /// Drops records merged into the document file by a successful \c compaction from the journal.
+    void finishJournalCompaction(const JournalCompaction& compaction);
+
+    /**
+     * Merges edits saved to the journal of the document at \c documentPath
+     * into the document file and removes the journal. Does nothing if there's
+     * no journal. Throws \c std::runtime_error on failure, leaving the journal in place.
+     */
+    static void mergeJournal(const QString& documentPath);
+
     std::optional<QFont> font() const noexcept { return font_; }
 
     const f2b::font::face& face() const noexcept { return face_; }
@@ -47,6 +109,7 @@ public:
         } else {
             face_.exported_glyph_ids().erase(idx);
         }
+        record(DocumentJournal::SetGlyphExported { idx, isExported });
         isDirty_ = true;
     }
 
@@ -98,6 +161,16 @@ public:
     }
 
 private:
+    bool loadMappedDocument(const QString& documentPath);
+    void readDocumentProperties(QDataStream& s);
+    void writeDocument(const QString& documentPath) const;
+    void replayJournal(const std::vector<DocumentJournal::Record>& records);
+    void applyJournalRecord(const DocumentJournal::Record& record);
+    void record(const DocumentJournal::Record& record) {
+        if (journal_) {
+            journal_->append(record);
+        }
+    }
     void doModifyGlyph(std::size_t idx, std::function<void(f2b::font::glyph&)> change);
 
     f2b::font::face face_;
@@ -110,6 +183,10 @@ private:
     // not persisted
     std::optional<std::size_t> activeGlyphIndex_;
     bool isDirty_ { false };
+    std::optional<QString> documentPath_;
+    // Journal read when opening the document, until the journal is opened for recording
+    std::optional<DocumentJournal::Contents> journalContents_;
+    std::shared_ptr<DocumentJournal> journal_;
 
     friend QDataStream& operator<<(QDataStream&, const FontFaceViewModel&);
     friend QDataStream& operator>>(QDataStream& s, FontFaceViewModel& vm);
@@ -0,0 +1,164 @@
+#include "glyphdelta.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using word_type = GlyphDelta::word_type;
+static constexpr auto word_bits = f2b::font::glyph::word_bits;
+
+static std::size_t packedLength(f2b::font::glyph_size size)
+{
+    return (size.width * size.height + word_bits - 1) / word_bits;
+}
+
+// Sets up to word_bits bits at bitPos (bits past count must be zero).
+static void writeBits(std::vector<word_type>& words, std::size_t bitPos, word_type bits, std::size_t count)
+{
+    auto index = bitPos / word_bits;
+    auto offset = bitPos % word_bits;
+    words[index] |= bits << offset;
+    if (offset + count > word_bits) {
+        words[index + 1] |= bits >> (word_bits - offset);
+    }
+}
+
+static word_type readBits(const std::vector<word_type>& words, std::size_t bitPos, std::size_t count)
+{
+    auto index = bitPos / word_bits;
+    auto offset = bitPos % word_bits;
+    auto bits = words[index] >> offset;
+    if (offset + count > word_bits) {
+        bits |= words[index + 1] << (word_bits - offset);
+    }
+    if (count < word_bits) {
+        bits &= (word_type { 1 } << count) - 1;
+    }
+    return bits;
+}
+
+GlyphDelta::GlyphDelta(const f2b::font::glyph &from, const f2b::font::glyph &to) :
+    size_ { from.size() }
+{
+    if (from.size() != to.size()) {
+        throw std::invalid_argument { "Glyph sizes don't match" };
+    }
+
+    std::vector<word_type> mask(packedLength(size_), 0);
+    std::size_t bitPos = 0;
+    for (std::size_t y = 0; y < size_.height; ++y) {
+        auto fromRow = from.row_data(y);
+        auto toRow = to.row_data(y);
+        for (std::size_t i = 0, x = 0; x < size_.width; ++i, x += word_bits) {
+            auto count = std::min(word_bits, size_.width - x);
+            writeBits(mask, bitPos, fromRow[i] ^ toRow[i], count);
+            bitPos += count;
+        }
+    }
+    setPackedMask(mask);
+}
+
+GlyphDelta GlyphDelta::ofGlyph(const f2b::font::glyph &glyph)
+{
+    return GlyphDelta { f2b::font::glyph { glyph.size() }, glyph };
+}
+
+void GlyphDelta::apply(f2b::font::glyph &glyph) const
+{
+    if (isEmpty()) {
+        return;
+    }
+    if (glyph.size() != size_) {
+        throw std::invalid_argument { "Glyph size doesn't match delta size" };
+    }
+
+    auto mask = packedMask();
+    std::vector<word_type> row(glyph.stride());
+    std::size_t bitPos = 0;
+    for (std::size_t y = 0; y < size_.height; ++y) {
+        std::copy(glyph.row_data(y), glyph.row_data(y) + glyph.stride(), row.begin());
+        for (std::size_t i = 0, x = 0; x < size_.width; ++i, x += word_bits) {
+            auto count = std::min(word_bits, size_.width - x);
+            row[i] ^= readBits(mask, bitPos, count);
+            bitPos += count;
+        }
+        glyph.set_row(y, row.data());
+    }
+}
+
+BatchPixelChange GlyphDelta::pixelChange(const f2b::font::glyph &glyph) const
+{
+    BatchPixelChange change { glyph.size() };
+    if (isEmpty()) {
+        return change;
+    }
+    if (glyph.size() != size_) {
+        throw std::invalid_argument { "Glyph size doesn't match delta size" };
+    }
+
+    auto mask = packedMask();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        for (auto word = mask[i]; word != 0; word &= word - 1) {
+            std::size_t bit = 0;
+            while (((word >> bit) & 1u) == 0) {
+                ++bit;
+            }
+            auto offset = i * word_bits + bit;
+            f2b::font::point p { offset % size_.width, offset / size_.width };
+            change.add(p, !glyph.is_pixel_set(p));
+        }
+    }
+    return change;
+}
+
+GlyphDelta& GlyphDelta::operator^=(const GlyphDelta &other)
+{
+    if (other.isEmpty()) {
+        return *this;
+    }
+    if (isEmpty()) {
+        return *this = other;
+    }
+    if (other.size_ != size_) {
+        throw std::invalid_argument { "Delta sizes don't match" };
+    }
+
+    auto mask = packedMask();
+    auto otherMask = other.packedMask();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] ^= otherMask[i];
+    }
+    setPackedMask(mask);
+    return *this;
+}
+
+std::vector<word_type> GlyphDelta::packedMask() const
+{
+    std::vector<word_type> mask(packedLength(size_), 0);
+    auto out = mask.begin();
+    for (auto in = encoded_.begin(); in != encoded_.end();) {
+        auto zeros = *in++;
+        auto literals = *in++;
+        out += static_cast<std::ptrdiff_t>(zeros);
+        out = std::copy(in, in + static_cast<std::ptrdiff_t>(literals), out);
+        in += static_cast<std::ptrdiff_t>(literals);
+    }
+    return mask;
+}
+
+void GlyphDelta::setPackedMask(const std::vector<word_type> &mask)
+{
+    encoded_.clear();
+    auto i = mask.begin();
+    while (true) {
+        auto literalsBegin = std::find_if(i, mask.end(), [](word_type w) { return w != 0; });
+        if (literalsBegin == mask.end()) {
+            break;
+        }
+        auto literalsEnd = std::find(literalsBegin, mask.end(), 0);
+        encoded_.push_back(static_cast<word_type>(literalsBegin - i));
+        encoded_.push_back(static_cast<word_type>(literalsEnd - literalsBegin));
+        encoded_.insert(encoded_.end(), literalsBegin, literalsEnd);
+        i = literalsEnd;
+    }
+    encoded_.shrink_to_fit();
+}
@@ -0,0 +1,54 @@
+#ifndef GLYPHDELTA_H
+#define GLYPHDELTA_H
+
+#include "batchpixelchange.h"
+#include <f2b.h>
+#include <vector>
+
+/**
+ * @brief The difference between two glyphs of the same size, stored compactly.
+ *
+ * Pixels that differ are stored as an XOR mask with rows packed one after another
+ * (without padding rows to whole words), and the mask is run-length encoded
+ * by words, so that small edits of large glyphs take only a few words.
+ *
+ * Applying a delta to either of the two glyphs gives the other one.
+ */
+class GlyphDelta
+{
+public:
+    using word_type = f2b::font::glyph::word_type;
+
+    GlyphDelta() = default;
+    GlyphDelta(const f2b::font::glyph& from, const f2b::font::glyph& to);
+
+    /// The difference between an empty glyph and \c glyph.
+    static GlyphDelta ofGlyph(const f2b::font::glyph& glyph);
+
+    f2b::font::glyph_size size() const noexcept { return size_; }
+    bool isEmpty() const noexcept { return encoded_.empty(); }
+
+    /// Flips pixels of \c glyph that differ between the two glyphs.
+    void apply(f2b::font::glyph& glyph) const;
+
+    /// The change setting pixels of \c glyph to the values they have in the other glyph.
+    BatchPixelChange pixelChange(const f2b::font::glyph& glyph) const;
+
+    /// Combines this delta with a delta applied before or after it.
+    GlyphDelta& operator^=(const GlyphDelta& other);
+
+    /// Memory used by the delta, in bytes.
+    std::size_t memoryUsage() const noexcept {
+        return sizeof(GlyphDelta) + encoded_.capacity() * sizeof(word_type);
+    }
+
+private:
+    std::vector<word_type> packedMask() const;
+    void setPackedMask(const std::vector<word_type>& mask);
+
+    f2b::font::glyph_size size_ { 0, 0 };
+    // Runs of a zero word count, a literal word count and the literal words
+    std::vector<word_type> encoded_;
+};
+
+#endif // GLYPHDELTA_H
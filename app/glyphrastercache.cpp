@@ -0,0 +1,194 @@
+#include "glyphrastercache.h"
+#include "f2b_qt_compat.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRawFont>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+static constexpr quint32 glyph_raster_cache_magic_number = 0x6c9e21d4;
+static constexpr quint32 glyph_raster_cache_version = 3;
+
+GlyphRasterCache::GlyphRasterCache(QString filePath, std::size_t capacity) :
+    filePath_ { std::move(filePath) },
+    capacity_ { capacity }
+{
+}
+
+GlyphRasterCache& GlyphRasterCache::shared()
+{
+    static GlyphRasterCache cache {
+        QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("glyphs.cache")
+    };
+    return cache;
+}
+
+QString GlyphRasterCache::fontKey(const QFont &font, f2b::font::glyph_size glyphSize, QFontFaceReader::engine engine)
+{
+    // QFont::key() only describes the requested font. Identify the font that is
+    // actually used by its name and a hash of its header table (which holds
+    // a checksum and the modification time), so that glyphs of an updated
+    // or a different font with the same name aren't reused.
+    auto rawFont = QRawFont::fromFont(font);
+    auto headHash = QCryptographicHash::hash(rawFont.fontTable("head"), QCryptographicHash::Sha1).toHex();
+    auto fontIdentity = QString("%1 %2 %3").arg(rawFont.familyName(), rawFont.styleName(), QString::fromLatin1(headHash));
+
+    // Engines may place glyphs differently, so their results are kept apart.
+    auto engineName = engine == QFontFaceReader::engine::direct ? "direct" : "text";
+    return QString("%1/%2/%3x%4/%5/Qt %6").arg(font.key(), fontIdentity,
+                                                QString::number(glyphSize.width), QString::number(glyphSize.height),
+                                                engineName, qVersion());
+}
+
+QString GlyphRasterCache::entryKey(const QString &fontKey, uint codePoint)
+{
+    return QString("%1/U+%2").arg(fontKey, QString::number(codePoint, 16));
+}
+
+void GlyphRasterCache::load()
+{
+    std::scoped_lock lock { mutex_ };
+    loadIfNeeded();
+}
+
+std::optional<f2b::font::glyph> GlyphRasterCache::glyph(const QString &fontKey, uint codePoint)
+{
+    std::scoped_lock lock { mutex_ };
+    loadIfNeeded();
+
+    auto i = index_.find(entryKey(fontKey, codePoint));
+    if (i == index_.end()) {
+        return {};
+    }
+
+    entries_.splice(entries_.begin(), entries_, i.value());
+    return entries_.front().second;
+}
+
+void GlyphRasterCache::insert(const QString &fontKey, uint codePoint, const f2b::font::glyph &glyph)
+{
+    std::scoped_lock lock { mutex_ };
+    loadIfNeeded();
+
+    insertEntry(entryKey(fontKey, codePoint), glyph);
+    isDirty_ = true;
+}
+
+void GlyphRasterCache::insertEntry(QString key, f2b::font::glyph glyph)
+{
+    auto i = index_.find(key);
+    if (i != index_.end()) {
+        i.value()->second = std::move(glyph);
+        entries_.splice(entries_.begin(), entries_, i.value());
+        return;
+    }
+
+    entries_.emplace_front(key, std::move(glyph));
+    index_.insert(key, entries_.begin());
+
+    while (entries_.size() > capacity_) {
+        index_.remove(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+std::size_t GlyphRasterCache::size() const
+{
+    std::scoped_lock lock { mutex_ };
+    return entries_.size();
+}
+
+void GlyphRasterCache::clear()
+{
+    std::scoped_lock lock { mutex_ };
+    isLoaded_ = true;
+    isDirty_ = !entries_.empty();
+    entries_.clear();
+    index_.clear();
+}
+
+void GlyphRasterCache::loadIfNeeded()
+{
+    if (isLoaded_) {
+        return;
+    }
+    isLoaded_ = true;
+
+    if (filePath_.isEmpty()) {
+        return;
+    }
+
+    QFile f(filePath_);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream s(&f);
+    quint32 magic_number;
+    quint32 version;
+    QString qtVersion;
+    s >> magic_number >> version;
+    if (magic_number != glyph_raster_cache_magic_number || version != glyph_raster_cache_version) {
+        return;
+    }
+    s.setVersion(QDataStream::Qt_5_7);
+
+    // Rasterization results may change with Qt version, so don't reuse them.
+    s >> qtVersion;
+    if (qtVersion != qVersion()) {
+        return;
+    }
+
+    quint32 count;
+    s >> count;
+
+    // Entries are stored most recent first, so append them in order.
+    for (quint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+        QString key;
+        f2b::font::glyph glyph;
+        s >> key >> glyph;
+        if (index_.contains(key) || entries_.size() >= capacity_) {
+            continue;
+        }
+        entries_.emplace_back(key, std::move(glyph));
+        index_.insert(key, std::prev(entries_.end()));
+    }
+
+    qDebug() << "loaded" << entries_.size() << "cached glyphs from" << filePath_;
+}
+
+void GlyphRasterCache::save()
+{
+    std::scoped_lock lock { mutex_ };
+
+    if (!isDirty_ || filePath_.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(filePath_).path());
+
+    QSaveFile f(filePath_);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "unable to write glyph cache to" << filePath_;
+        return;
+    }
+
+    QDataStream s(&f);
+    s << glyph_raster_cache_magic_number;
+    s << glyph_raster_cache_version;
+    s.setVersion(QDataStream::Qt_5_7);
+    s << QString(qVersion());
+    s << (quint32) entries_.size();
+    for (const auto& [key, glyph] : entries_) {
+        s << key << glyph;
+    }
+
+    if (f.commit()) {
+        isDirty_ = false;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef GLYPHRASTERCACHE_H
+#define GLYPHRASTERCACHE_H
+
+#include <QFont>
+#include <QHash>
+#include <QString>
+#include <f2b.h>
+#include "qfontfacereader.h"
+
+#include <list>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief An LRU cache of rasterized glyph bitmaps, persisted to disk.
+ *
+ * Glyphs are keyed by a font key (see \c fontKey) and a Unicode code point.
+ * Once the number of glyphs exceeds capacity, least recently used glyphs
+ * are evicted.
+ */
+class GlyphRasterCache
+{
+public:
+    static constexpr std::size_t defaultCapacity = 50000;
+
+    /// Creates a cache backed by \c filePath (no persistence if empty).
+    explicit GlyphRasterCache(QString filePath = {}, std::size_t capacity = defaultCapacity);
+
+    /// The application-wide cache stored in the user cache directory.
+    static GlyphRasterCache& shared();
+
+    /**
+     * Builds a key identifying rasterization parameters: font family, size
+     * and style (as reported by QFont::key()), the font file actually used
+     * for them, the size of a glyph cell, the rendering engine and Qt version.
+     *
+     * Only the primary font is identified, not fallback fonts used for characters
+     * it doesn't have.
+     */
+    static QString fontKey(const QFont& font, f2b::font::glyph_size glyphSize, QFontFaceReader::engine engine);
+
+    std::optional<f2b::font::glyph> glyph(const QString& fontKey, uint codePoint);
+    void insert(const QString& fontKey, uint codePoint, const f2b::font::glyph& glyph);
+
+    std::size_t size() const;
+    std::size_t capacity() const noexcept { return capacity_; }
+
+    /**
+     * Reads the cache from disk unless it was read already. Lookups read the cache
+     * on first use, so this allows reading it ahead of time, e.g. on a background thread.
+     */
+    void load();
+
+    /// Writes the cache to disk if it was modified since it was loaded.
+    void save();
+    void clear();
+
+private:
+    using Entry = std::pair<QString, f2b::font::glyph>;
+
+    static QString entryKey(const QString& fontKey, uint codePoint);
+    void loadIfNeeded();
+    void insertEntry(QString key, f2b::font::glyph glyph);
+
+    const QString filePath_;
+    const std::size_t capacity_;
+
+    // Most recently used entries first
+    std::list<Entry> entries_;
+    QHash<QString, std::list<Entry>::iterator> index_;
+
+    bool isLoaded_ { false };
+    bool isDirty_ { false };
+    mutable std::mutex mutex_;
+};
+
+#endif // GLYPHRASTERCACHE_H
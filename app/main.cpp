@@ -1,9 +1,12 @@
 #include "mainwindow.h"
 #include "global.h"
+#include "glyphrastercache.h"
 
 #include <QApplication>
 #include <QtGui>
 
+#include <future>
+
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
@@ -19,7 +22,15 @@ int main(int argc, char *argv[])
 
     a.setAttribute(Qt::AA_UseHighDpiPixmaps);
 
+    // Read glyphs cached by previous sessions off the GUI thread,
+    // and write the cache once, when the application quits.
+    auto cacheLoading = std::async(std::launch::async, [] { GlyphRasterCache::shared().load(); });
+
     MainWindow w;
     w.show();
-    return QApplication::exec();
+    auto result = QApplication::exec();
+
+    cacheLoading.wait();
+    GlyphRasterCache::shared().save();
+    return result;
 }
@@ -6,6 +6,7 @@
 #include "command.h"
 #include "aboutdialog.h"
 #include "addglyphdialog.h"
+#include "batchimportdialog.h"
 #include "common.h"
 
 #include <QGraphicsGridLayout>
@@ -34,7 +35,8 @@ static constexpr auto fileFilter = "FontEdit documents (*.fontedit)";
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       ui_ { new Ui::MainWindow },
-      statusLabel_ { new QLabel() }
+      statusLabel_ { new QLabel() },
+      undoMemoryLabel_ { new QLabel() }
 {
     ui_->setupUi(this);
 
@@ -48,6 +50,7 @@ MainWindow::MainWindow(QWidget *parent)
     viewModel_->restoreSession();
 
     ui_->statusBar->addPermanentWidget(statusLabel_);
+    ui_->statusBar->addPermanentWidget(undoMemoryLabel_);
 
     updateHelper_->checkForUpdatesIfNeeded();
 }
@@ -73,6 +76,7 @@ void MainWindow::connectUIInputs()
 {
     connect(ui_->actionAbout, &QAction::triggered, this, &MainWindow::showAboutDialog);
     connect(ui_->actionImport_Font, &QAction::triggered, this, &MainWindow::showFontDialog);
+    connect(ui_->actionBatch_Import, &QAction::triggered, this, &MainWindow::showBatchImportDialog);
     connect(ui_->actionOpen, &QAction::triggered, this, &MainWindow::showOpenDocumentDialog);
     connect(ui_->actionAdd_Glyph, &QAction::triggered, this, &MainWindow::showAddGlyphDialog);
     connect(ui_->actionDelete_Glyph, &QAction::triggered, this, &MainWindow::showDeleteGlyphDialog);
@@ -128,7 +132,7 @@ void MainWindow::connectViewModelOutputs()
     });
     connect(viewModel_.get(), &MainWindowModel::uiStateChanged, this, &MainWindow::updateUI);
     connect(viewModel_.get(), &MainWindowModel::faceLoaded, [&](f2b::font::face& face) {
-        undoStack_->clear();
+        undoHistory_->clear();
         displayFace(face);
     });
     connect(viewModel_.get(), &MainWindowModel::documentError, this, &MainWindow::displayError);
@@ -195,7 +199,7 @@ void MainWindow::initUI()
 
     QFont f(consoleFontName, 12);
     f.setStyleHint(QFont::TypeWriter);
-    ui_->sourceCodeTextBrowser->setFont(f);
+    ui_->sourceCodeView->setFont(f);
 }
 
 void MainWindow::showUpdateDialog(std::optional<UpdateHelper::Update> update)
@@ -250,17 +254,21 @@ void MainWindow::closeCurrentDocument()
         glyphWidget_.release();
     }
 
-    undoStack_->clear();
+    undoHistory_->clear();
     updateResetActions();
 }
 
 void MainWindow::setupActions()
 {
-    auto undo = undoStack_->createUndoAction(this);
+    undoHistory_->setMemoryBudget(viewModel_->undoMemoryBudget());
+    connect(undoHistory_.get(), &UndoHistory::changed, this, &MainWindow::updateUndoMemoryLabel);
+    updateUndoMemoryLabel();
+
+    auto undo = undoHistory_->createUndoAction(this);
     undo->setIcon(QIcon {":/toolbar/assets/undo.svg"});
     undo->setShortcut(QKeySequence::Undo);
 
-    auto redo = undoStack_->createRedoAction(this);
+    auto redo = undoHistory_->createRedoAction(this);
     redo->setIcon(QIcon {":/toolbar/assets/redo.svg"});
     redo->setShortcut(QKeySequence::Redo);
 
@@ -352,6 +360,17 @@ void MainWindow::showFontDialog()
     }
 }
 
+void MainWindow::showBatchImportDialog()
+{
+    auto dialog = new BatchImportDialog(viewModel_->sourceCodeOptions(),
+                                        viewModel_->outputFormatIdentifier(),
+                                        viewModel_->fontArrayName(),
+                                        viewModel_->lastVisitedDirectory(),
+                                        this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
 void MainWindow::showOpenDocumentDialog()
 {
     switch (promptToSaveDirtyDocument()) {
@@ -394,15 +413,21 @@ void MainWindow::showAddGlyphDialog()
             auto numberOfGlyphs = viewModel_->faceModel()->face().num_glyphs();
             auto activeGlyphIndex = viewModel_->faceModel()->activeGlyphIndex();
 
+            auto delta = GlyphDelta::ofGlyph(glyph.value());
+            auto size = glyph->size();
+            auto memoryUsage = delta.memoryUsage();
+
             pushUndoCommand(new Command(tr("Add Glyph"), [&, numberOfGlyphs, activeGlyphIndex] {
                 viewModel_->deleteGlyph(numberOfGlyphs);
                 viewModel_->setActiveGlyphIndex(activeGlyphIndex);
                 displayFace(viewModel_->faceModel()->face());
-            }, [&, glyph] {
-                viewModel_->appendGlyph(glyph.value());
+            }, [&, delta, size] {
+                f2b::font::glyph glyph { size };
+                delta.apply(glyph);
+                viewModel_->appendGlyph(std::move(glyph));
                 viewModel_->setActiveGlyphIndex(viewModel_->faceModel()->face().num_glyphs()-1);
                 displayFace(viewModel_->faceModel()->face());
-            }));
+            }, memoryUsage));
         }
     });
 }
@@ -424,13 +449,20 @@ void MainWindow::showDeleteGlyphDialog()
 
         auto commandName = isLastGlyph ? tr("Delete Glyph") : tr("Clear Glyph");
 
-        pushUndoCommand(new Command(commandName, [&, currentIndex, isLastGlyph, glyph] {
+        // Keep the deleted glyph compressed.
+        auto delta = GlyphDelta::ofGlyph(glyph.value());
+        auto size = glyph->size();
+        auto memoryUsage = delta.memoryUsage();
+
+        pushUndoCommand(new Command(commandName, [&, currentIndex, isLastGlyph, delta, size] {
+            f2b::font::glyph glyph { size };
+            delta.apply(glyph);
             if (isLastGlyph) {
-                viewModel_->appendGlyph(glyph.value());
+                viewModel_->appendGlyph(glyph);
                 viewModel_->setActiveGlyphIndex(viewModel_->faceModel()->face().num_glyphs()-1);
                 displayFace(viewModel_->faceModel()->face());
             } else {
-                viewModel_->modifyGlyph(currentIndex.value(), glyph.value());
+                viewModel_->modifyGlyph(currentIndex.value(), glyph);
                 faceWidget_->updateGlyphInfo(currentIndex.value(), viewModel_->faceModel()->activeGlyph().value());
                 displayGlyph(viewModel_->faceModel()->activeGlyph().value());
             }
@@ -442,7 +474,7 @@ void MainWindow::showDeleteGlyphDialog()
                 faceWidget_->updateGlyphInfo(currentIndex.value(), viewModel_->faceModel()->activeGlyph().value());
                 displayGlyph(viewModel_->faceModel()->activeGlyph().value());
             }
-        }));
+        }, memoryUsage));
 
     }
 }
@@ -546,15 +578,11 @@ void MainWindow::setGlyphExported(std::size_t index, bool isExported)
         viewModel_->setGlyphExported(index, !isExported);
         auto faceModel = viewModel_->faceModel();
         updateFaceInfoLabel(faceModel->faceInfo());
+        faceWidget_->updateGlyphInfo(index, {}, !isExported);
         if (!faceWidget_->showsNonExportedItems()) {
-            auto margins = faceModel->originalFaceMargins();
-            faceWidget_->load(faceModel->face(), margins);
             faceWidget_->setCurrentGlyphIndex(index);
-            glyphWidget_->load(faceModel->face().glyph_at(index), margins);
-        } else {
-            faceWidget_->updateGlyphInfo(index, {}, !isExported);
+            glyphWidget_->load(faceModel->face().glyph_at(index), faceModel->originalFaceMargins());
         }
-
     }, [&, index, isExported] {
         auto faceModel = viewModel_->faceModel();
         auto shouldUpdateCurrentIndex = !isExported && !faceWidget_->showsNonExportedItems();
@@ -571,15 +599,12 @@ void MainWindow::setGlyphExported(std::size_t index, bool isExported)
         viewModel_->setGlyphExported(index, isExported);
         updateFaceInfoLabel(faceModel->faceInfo());
 
+        faceWidget_->updateGlyphInfo(index, {}, isExported);
         if (shouldUpdateCurrentIndex) {
-            auto margins = faceModel->originalFaceMargins();
-            faceWidget_->load(faceModel->face(), margins);
             faceWidget_->setCurrentGlyphIndex(nextIndex);
             if (nextIndex.has_value()) {
-                glyphWidget_->load(faceModel->face().glyph_at(nextIndex.value()), margins);
+                glyphWidget_->load(faceModel->face().glyph_at(nextIndex.value()), faceModel->originalFaceMargins());
             }
-        } else {
-            faceWidget_->updateGlyphInfo(index, {}, isExported);
         }
     }));
 }
@@ -624,19 +649,20 @@ void MainWindow::editGlyph(const BatchPixelChange& change)
     auto currentIndex = viewModel_->faceModel()->activeGlyphIndex();
     if (currentIndex.has_value()) {
 
-        auto applyChange = [&, currentIndex, change](BatchPixelChange::ChangeType type) -> std::function<void()> {
-            return [&, currentIndex, change, type] {
-                viewModel_->modifyGlyph(currentIndex.value(), change, type);
-                updateResetActions();
-                glyphWidget_->applyChange(change, type);
-                faceWidget_->updateGlyphInfo(currentIndex.value(), viewModel_->faceModel()->activeGlyph().value());
-                viewModel_->updateDocumentTitle();
-            };
-        };
-
-        pushUndoCommand(new Command(tr("Edit Glyph"),
-                                    applyChange(BatchPixelChange::ChangeType::Reverse),
-                                    applyChange(BatchPixelChange::ChangeType::Normal)));
+        // The model isn't modified yet, so the active glyph is the state before the change.
+        auto glyph = viewModel_->faceModel()->activeGlyph().value();
+        auto editedGlyph = glyph;
+        change.apply(editedGlyph);
+
+        pushUndoCommand(new GlyphEditCommand(tr("Edit Glyph"), currentIndex.value(), GlyphDelta { glyph, editedGlyph },
+                                             [&](std::size_t index, const GlyphDelta& delta) {
+            auto pixelChange = delta.pixelChange(viewModel_->faceModel()->face().glyph_at(index));
+            viewModel_->modifyGlyph(index, pixelChange, BatchPixelChange::ChangeType::Normal);
+            updateResetActions();
+            glyphWidget_->applyChange(pixelChange);
+            faceWidget_->updateGlyphInfo(index, viewModel_->faceModel()->activeGlyph().value());
+            viewModel_->updateDocumentTitle();
+        }));
     }
 }
 
@@ -664,11 +690,14 @@ void MainWindow::switchActiveGlyph(std::optional<std::size_t> newIndex)
 
 void MainWindow::resetCurrentGlyph()
 {
-    f2b::font::glyph currentGlyphState { viewModel_->faceModel()->activeGlyph().value() };
+    auto currentGlyphState = GlyphDelta::ofGlyph(viewModel_->faceModel()->activeGlyph().value());
     auto glyphIndex = viewModel_->faceModel()->activeGlyphIndex().value();
+    auto memoryUsage = currentGlyphState.memoryUsage();
 
     pushUndoCommand(new Command(tr("Reset Glyph"), [&, currentGlyphState, glyphIndex] {
-        viewModel_->modifyGlyph(glyphIndex, currentGlyphState);
+        f2b::font::glyph glyph { currentGlyphState.size() };
+        currentGlyphState.apply(glyph);
+        viewModel_->modifyGlyph(glyphIndex, glyph);
         viewModel_->updateDocumentTitle();
         displayGlyph(viewModel_->faceModel()->activeGlyph().value());
         faceWidget_->updateGlyphInfo(glyphIndex, viewModel_->faceModel()->activeGlyph().value());
@@ -677,7 +706,7 @@ void MainWindow::resetCurrentGlyph()
         viewModel_->updateDocumentTitle();
         displayGlyph(viewModel_->faceModel()->activeGlyph().value());
         faceWidget_->updateGlyphInfo(glyphIndex, viewModel_->faceModel()->activeGlyph().value());
-    }));
+    }, memoryUsage));
 }
 
 void MainWindow::resetFont()
@@ -687,7 +716,7 @@ void MainWindow::resetFont()
     if (result == QMessageBox::Reset) {
         viewModel_->faceModel()->reset();
         viewModel_->updateDocumentTitle();
-        undoStack_->clear();
+        undoHistory_->clear();
         updateResetActions();
         displayFace(viewModel_->faceModel()->face());
     }
@@ -732,7 +761,8 @@ void MainWindow::displaySourceCode()
     ui_->stackedWidget->setCurrentWidget(ui_->sourceCodeContainer);
     QElapsedTimer timer;
     timer.start();
-    ui_->sourceCodeTextBrowser->setPlainText(viewModel_->sourceCode());
+    // Only lines that changed since the last update are split into lines again
+    ui_->sourceCodeView->setPlainText(viewModel_->sourceCode());
     qDebug() << "Displaying finished in" << timer.elapsed() << "ms";
 }
 
@@ -755,10 +785,7 @@ void MainWindow::exportSourceCode()
         if (!files.isEmpty()) {
             auto filePath = files.first();
             if (!filePath.isNull()) {
-                QFile output(filePath);
-                if (output.open(QFile::WriteOnly | QFile::Truncate)) {
-                    output.write(ui_->sourceCodeTextBrowser->document()->toPlainText().toUtf8());
-                    output.close();
+                if (viewModel_->exportSourceCode(filePath)) {
                     viewModel_->setLastSourceCodeDirectory(filePath);
                     ui_->statusBar->showMessage(tr("Source code successfully exported."), 5000);
                 } else {
@@ -771,19 +798,24 @@ void MainWindow::exportSourceCode()
     dialog->open();
 }
 
-void MainWindow::pushUndoCommand(QUndoCommand *command)
+void MainWindow::pushUndoCommand(UndoCommand *command)
 {
-    bool shouldPushSwitchGlyphCommand = pendingSwitchGlyphCommand_ != nullptr;
-
-    if (shouldPushSwitchGlyphCommand) {
-        undoStack_->beginMacro(command->text());
-        undoStack_->push(pendingSwitchGlyphCommand_.get());
-        pendingSwitchGlyphCommand_.release();
+    if (pendingSwitchGlyphCommand_) {
+        auto macro = new MacroCommand(command->text());
+        macro->append(std::move(pendingSwitchGlyphCommand_));
+        macro->append(std::unique_ptr<UndoCommand> { command });
+        undoHistory_->push(macro);
+    } else {
+        undoHistory_->push(command);
     }
+}
 
-    undoStack_->push(command);
-
-    if (shouldPushSwitchGlyphCommand) {
-        undoStack_->endMacro();
-    }
+void MainWindow::updateUndoMemoryLabel()
+{
+    auto mebibytes = [](std::size_t bytes) {
+        return QString::number(static_cast<double>(bytes) / (1024 * 1024), 'f', 1);
+    };
+    undoMemoryLabel_->setText(tr("Undo history: %1 of %2 MiB").arg(mebibytes(undoHistory_->memoryUsage()),
+                                                                  mebibytes(undoHistory_->memoryBudget())));
+    undoMemoryLabel_->setVisible(undoHistory_->count() > 0);
 }
@@ -3,7 +3,6 @@
 
 #include <QMainWindow>
 #include <QGraphicsScene>
-#include <QUndoStack>
 #include <QTimer>
 
 #include "mainwindowmodel.h"
@@ -12,6 +11,7 @@
 #include "glyphwidget.h"
 #include "batchpixelchange.h"
 #include "command.h"
+#include "undohistory.h"
 
 #include <memory>
 
@@ -46,6 +46,7 @@ private:
 
     void showAboutDialog();
     void showFontDialog();
+    void showBatchImportDialog();
     void showOpenDocumentDialog();
     void showCloseDocumentDialogIfNeeded();
     void showAddGlyphDialog();
@@ -67,7 +68,8 @@ private:
     void exportSourceCode();
     void closeCurrentDocument();
     void displayError(const QString& error);
-    void pushUndoCommand(QUndoCommand *command);
+    void pushUndoCommand(UndoCommand *command);
+    void updateUndoMemoryLabel();
 
     void debounceFontNameChanged(const QString& fontName);
 
@@ -86,10 +88,11 @@ private:
     std::unique_ptr<GlyphWidget> glyphWidget_ {};
     FaceWidget *faceWidget_ { nullptr };
     QLabel *statusLabel_;
+    QLabel *undoMemoryLabel_;
     std::unique_ptr<UpdateHelper> updateHelper_ { std::make_unique<UpdateHelper>() };
     std::unique_ptr<MainWindowModel> viewModel_ { std::make_unique<MainWindowModel>() };
     std::unique_ptr<QGraphicsScene> faceScene_ { std::make_unique<QGraphicsScene>() };
-    std::unique_ptr<QUndoStack> undoStack_ { std::make_unique<QUndoStack>() };
+    std::unique_ptr<UndoHistory> undoHistory_ { std::make_unique<UndoHistory>() };
     std::unique_ptr<QTimer> fontNameDebounceTimer_ {};
 
     std::unique_ptr<SwitchActiveGlyphCommand> pendingSwitchGlyphCommand_ {};
@@ -1,13 +1,16 @@
 #include "mainwindowmodel.h"
 #include "sourcecoderunnable.h"
 #include "f2b_qt_compat.h"
+#include "undohistory.h"
 #include <f2b.h>
 
 #include <QDebug>
-#include <QThreadPool>
 #include <QFile>
+#include <QSaveFile>
+#include <QElapsedTimer>
 #include <QDataStream>
 #include <QDir>
+#include <QRunnable>
 
 #include <iostream>
 #include <thread>
@@ -15,8 +18,19 @@
 Q_DECLARE_METATYPE(f2b::source_code_options::bit_numbering_type);
 Q_DECLARE_METATYPE(f2b::source_code_options::export_method_type);
 
+class JournalCompactionRunnable : public QRunnable
+{
+public:
+    explicit JournalCompactionRunnable(std::function<void()> f) : f_ { std::move(f) } {}
+    void run() override { f_(); }
+
+private:
+    std::function<void()> f_;
+};
+
 namespace SettingsKey {
 static const QString showNonExportedGlyphs = "main_window/show_non_expoerted_glyphs";
+static const QString undoMemoryBudget = "main_window/undo_memory_budget";
 static const QString exportMethod = "source_code_options/export_method";
 static const QString bitNumbering = "source_code_options/bit_numbering";
 static const QString invertBits = "source_code_options/invert_bits";
@@ -57,6 +71,8 @@ MainWindowModel::MainWindowModel(QObject *parent) :
     sourceCodeOptions_.invert_bits = settings_.value(SettingsKey::invertBits, false).toBool();
     sourceCodeOptions_.include_line_spacing = settings_.value(SettingsKey::includeLineSpacing, false).toBool();
     sourceCodeOptions_.indentation = from_qvariant(settings_.value(SettingsKey::indentation, to_qvariant(f2b::source_code::tab {})));
+    // Format glyphs of large faces on all cores
+    sourceCodeOptions_.thread_count = 0;
 
     formats_.insert(QString::fromStdString(std::string(f2b::format::c::identifier)), "C/C++");
     formats_.insert(QString::fromStdString(std::string(f2b::format::arduino::identifier)), "Arduino");
@@ -74,9 +90,39 @@ MainWindowModel::MainWindowModel(QObject *parent) :
             this, &MainWindowModel::sourceCodeChanged,
             Qt::BlockingQueuedConnection);
 
+    compactionThreadPool_.setMaxThreadCount(1);
+    connect(this, &MainWindowModel::journalCompactionFinished,
+            this, &MainWindowModel::finishJournalCompaction,
+            Qt::QueuedConnection);
+
+    sourceCodeScheduler_.setResultHandler([&](const QString& output, quint64 epoch) {
+        qDebug() << "Source code size:" << output.size() << "bytes, epoch" << epoch;
+        {
+            std::scoped_lock lock { sourceCodeMutex_ };
+            sourceCode_ = output;
+        }
+        emit runnableFinished();
+    });
+
     qDebug() << "output format:" << currentFormat_;
 }
 
+MainWindowModel::~MainWindowModel()
+{
+    // Don't leave saved edits only in the journal of the document.
+    compactionThreadPool_.waitForDone();
+    if (fontFaceViewModel_) {
+        fontFaceViewModel_->closeJournal();
+    }
+    if (documentPath_.has_value()) {
+        try {
+            FontFaceViewModel::mergeJournal(documentPath_.value());
+        } catch (std::runtime_error& e) {
+            qCritical() << e.what();
+        }
+    }
+}
+
 void MainWindowModel::restoreSession()
 {
     auto path = settings_.value(SettingsKey::documentPath).toString();
@@ -159,6 +205,7 @@ void MainWindowModel::updateDocumentTitle()
 
 void MainWindowModel::importFont(const QFont &font)
 {
+    mergeJournal();
     fontFaceViewModel_ = std::make_unique<FontFaceViewModel>(font);
     registerInputEvent(UIState::UserLoadedDocument);
     setDocumentPath({});
@@ -173,11 +220,17 @@ void MainWindowModel::openDocument(const QString &fileName)
 
 void MainWindowModel::openDocument(const QString &fileName, bool failSilently)
 {
+    mergeJournal();
     try {
-        fontFaceViewModel_ = std::make_unique<FontFaceViewModel>(fileName);
+        auto viewModel = std::make_unique<FontFaceViewModel>(fileName);
 
         qDebug() << "face loaded from" << fileName;
 
+        if (auto recovered = viewModel->openJournal()) {
+            qDebug() << "recovered" << recovered << "unsaved edits from journal";
+        }
+        fontFaceViewModel_ = std::move(viewModel);
+
         registerInputEvent(UIState::UserLoadedDocument);
         setDocumentPath(fileName);
         updateDocumentTitle();
@@ -198,9 +251,21 @@ void MainWindowModel::openDocument(const QString &fileName, bool failSilently)
 void MainWindowModel::saveDocument(const QString& fileName)
 {
     try {
-        fontFaceViewModel_->saveToFile(fileName);
-
-        qDebug() << "face saved to" << fileName;
+        if (fontFaceViewModel_->saveIncrementally(fileName)) {
+            qDebug() << "face saved to journal of" << fileName;
+            compactJournal();
+        } else {
+            if (documentPath_.has_value() && documentPath_.value() != fileName) {
+                // Saving as another document; the previous one keeps its saved edits.
+                mergeJournal();
+            } else {
+                // Don't let a running compaction overwrite the document afterwards.
+                compactionThreadPool_.waitForDone();
+            }
+            fontFaceViewModel_->saveToFile(fileName);
+            fontFaceViewModel_->openJournal();
+            qDebug() << "face saved to" << fileName;
+        }
 
         setDocumentPath(fileName);
         updateDocumentTitle();
@@ -212,13 +277,72 @@ void MainWindowModel::saveDocument(const QString& fileName)
 
 void MainWindowModel::closeCurrentDocument()
 {
-    fontFaceViewModel_.release();
+    sourceCodeScheduler_.cancel();
+    mergeJournal();
+    fontFaceViewModel_.reset();
     setDocumentPath({});
     updateDocumentTitle();
     registerInputEvent(UIState::UserIdle);
     emit documentClosed();
 }
 
+void MainWindowModel::compactJournal()
+{
+    if (journalCompaction_.has_value()) {
+        return;
+    }
+
+    journalCompaction_ = fontFaceViewModel_->journalCompaction();
+    if (!journalCompaction_.has_value()) {
+        return;
+    }
+
+    auto r = new JournalCompactionRunnable([this, write = journalCompaction_->write] {
+        emit journalCompactionFinished(write());
+    });
+    r->setAutoDelete(true);
+    compactionThreadPool_.start(r);
+}
+
+void MainWindowModel::finishJournalCompaction(bool success)
+{
+    if (!journalCompaction_.has_value()) {
+        return;
+    }
+
+    // The document may have been closed or replaced in the meantime,
+    // in which case the compaction no longer matches its journal.
+    if (success && fontFaceViewModel_) {
+        fontFaceViewModel_->finishJournalCompaction(journalCompaction_.value());
+        qDebug() << "journal compacted";
+    }
+    journalCompaction_ = {};
+
+    // Merge edits saved while the compaction was running.
+    if (success && fontFaceViewModel_ && fontFaceViewModel_->shouldCompactJournal()) {
+        compactJournal();
+    }
+}
+
+void MainWindowModel::mergeJournal()
+{
+    // Let a running compaction finish writing the document first.
+    compactionThreadPool_.waitForDone();
+    if (fontFaceViewModel_) {
+        fontFaceViewModel_->closeJournal();
+    }
+    if (!documentPath_.has_value()) {
+        return;
+    }
+
+    try {
+        FontFaceViewModel::mergeJournal(documentPath_.value());
+    } catch (std::runtime_error& e) {
+        qCritical() << e.what();
+        emit documentError(QString::fromStdString(e.what()));
+    }
+}
+
 void MainWindowModel::setActiveGlyphIndex(std::optional<std::size_t> index)
 {
     if (fontFaceViewModel_->activeGlyphIndex().has_value() and
@@ -319,6 +443,13 @@ QString MainWindowModel::lastVisitedDirectory() const
     return settings_.value(SettingsKey::lastDocumentDirectory).toString();
 }
 
+std::size_t MainWindowModel::undoMemoryBudget() const
+{
+    auto budget = settings_.value(SettingsKey::undoMemoryBudget,
+                                  static_cast<qulonglong>(UndoHistory::defaultMemoryBudget)).toULongLong();
+    return static_cast<std::size_t>(budget);
+}
+
 void MainWindowModel::setLastVisitedDirectory(const QString& path)
 {
     settings_.setValue(SettingsKey::lastDocumentDirectory, QFileInfo(path).path());
@@ -334,21 +465,36 @@ void MainWindowModel::setLastSourceCodeDirectory(const QString& path)
     settings_.setValue(SettingsKey::lastSourceCodeDirectory, QFileInfo(path).path());
 }
 
+bool MainWindowModel::exportSourceCode(const QString& filePath)
+{
+    if (fontFaceViewModel_ == nullptr) {
+        return false;
+    }
+
+    QSaveFile f(filePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    f2b::font_source_code_generator generator { sourceCodeOptions_, glyphFragmentCache_ };
+    SourceCodeRunnable::generate(fontFaceViewModel_->face(), generator,
+                                 currentFormat_.toStdString(), fontArrayName_.toStdString(),
+                                 f2b::qiodevice_sink(f));
+
+    qDebug() << "Source code exported in" << timer.elapsed() << "ms";
+
+    return f.commit();
+}
+
 void MainWindowModel::reloadSourceCode()
 {
-    /// WIP :)
     emit sourceCodeUpdating();
 
-    auto r = new SourceCodeRunnable { faceModel()->face(), sourceCodeOptions_, currentFormat_, fontArrayName_ };
-    r->setCompletionHandler([&](const QString& output) {
-        qDebug() << "Source code size:" << output.size() << "bytes";
-        std::scoped_lock { sourceCodeMutex_ };
-        sourceCode_ = std::move(output);
-        emit runnableFinished();
-    });
-    r->setAutoDelete(true);
-
-    QThreadPool::globalInstance()->start(r);
+    sourceCodeScheduler_.submit(faceModel()->face(), sourceCodeOptions_,
+                                currentFormat_, fontArrayName_, glyphFragmentCache_);
 }
 
 void MainWindowModel::resetGlyph(std::size_t index)
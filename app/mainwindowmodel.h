@@ -2,6 +2,7 @@
 #define MAINWINDOWMODEL_H
 
 #include "fontfaceviewmodel.h"
+#include "sourcecodescheduler.h"
 #include <f2b.h>
 #include <memory>
 #include <functional>
@@ -13,6 +14,7 @@
 
 #include <QMap>
 #include <QSettings>
+#include <QThreadPool>
 
 struct UIState {
     enum InterfaceAction {
@@ -63,6 +65,7 @@ public:
     using InputEvent = std::variant<UIState::InterfaceAction,UIState::UserAction>;
 
     explicit MainWindowModel(QObject *parent = nullptr);
+    ~MainWindowModel();
     void restoreSession();
 
     FontFaceViewModel* faceModel() const {
@@ -101,6 +104,14 @@ public:
         return formats_.value(currentFormat_, formats_.first());
     }
 
+    QString outputFormatIdentifier() const {
+        return formats_.contains(currentFormat_) ? currentFormat_ : formats_.firstKey();
+    }
+
+    const f2b::source_code_options& sourceCodeOptions() const {
+        return sourceCodeOptions_;
+    }
+
     const std::vector<std::pair<f2b::source_code::indentation, QString>>& indentationStyles() const {
         return indentationStyles_;
     }
@@ -116,6 +127,8 @@ public:
     QString documentTitle() const { return documentTitle_; }
     void updateDocumentTitle();
 
+    QString fontArrayName() const { return fontArrayName_; }
+
     void setFontArrayName(const QString& fontArrayName) {
         if (fontArrayName_ != fontArrayName) {
             fontArrayName_ = fontArrayName;
@@ -125,9 +138,18 @@ public:
 
     QString lastVisitedDirectory() const;
 
+    /// Memory budget of the undo history, in bytes.
+    std::size_t undoMemoryBudget() const;
+
     QString lastSourceCodeDirectory() const;
     void setLastSourceCodeDirectory(const QString& path);
 
+    /**
+     * Generates source code with current options and writes it directly
+     * to \c filePath. Returns true on success.
+     */
+    bool exportSourceCode(const QString& filePath);
+
     void resetGlyph(std::size_t index);
     void modifyGlyph(std::size_t index, const f2b::font::glyph &new_glyph);
     void modifyGlyph(std::size_t index,
@@ -168,12 +190,16 @@ signals:
     void documentTitleChanged(const QString& title);
     void documentClosed();
     void documentError(const QString& error);
+    void journalCompactionFinished(bool success);
 
 private:
     void reloadSourceCode();
     void setDocumentPath(const std::optional<QString>& path);
     void setLastVisitedDirectory(const QString& path);
     void openDocument(const QString& fileName, bool failSilently);
+    void compactJournal();
+    void finishJournalCompaction(bool success);
+    void mergeJournal();
 
     UIState uiState_ {};
     std::unique_ptr<FontFaceViewModel> fontFaceViewModel_;
@@ -185,11 +211,21 @@ private:
 
     QString sourceCode_;
     std::mutex sourceCodeMutex_;
+    // Source code of glyphs reused between subsequent generations
+    std::shared_ptr<f2b::glyph_fragment_cache> glyphFragmentCache_ { std::make_shared<f2b::glyph_fragment_cache>() };
+    // Cancels outdated generations, so that only the latest source code is published
+    SourceCodeScheduler sourceCodeScheduler_;
 
     QMap<QString, QString> formats_; // identifier <-> human-readable
     QString currentFormat_; // identifier
     std::vector<std::pair<f2b::source_code::indentation, QString>> indentationStyles_;
     QSettings settings_;
+
+    // Journal compaction in progress, if any
+    std::optional<FontFaceViewModel::JournalCompaction> journalCompaction_;
+    // Runs journal compactions one at a time; declared last so that it's destroyed
+    // (waiting for a running compaction) before other members.
+    QThreadPool compactionThreadPool_;
 };
 
 #endif // MAINWINDOWMODEL_H
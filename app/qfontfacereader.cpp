@@ -1,39 +1,116 @@
 #include "qfontfacereader.h"
 #include "f2b_qt_compat.h"
+#include "glyphrastercache.h"
 
 #include <QAbstractTextDocumentLayout>
 #include <QFontMetrics>
 #include <QImage>
 #include <QPainter>
+#include <QRunnable>
+#include <QTextBlock>
 #include <QTextDocument>
 #include <QTextFrame>
+#include <QTextLayout>
+#include <QThread>
+#include <QThreadPool>
 #include "utf8.h"
 
+#include <functional>
+
 using namespace std::literals::string_view_literals;
 
 static constexpr std::string_view ascii_glyphs =
         " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~"sv;
 
-QFontFaceReader::QFontFaceReader(const QFont &font, std::string text, std::optional<f2b::font::glyph_size> forced_size) :
+namespace {
+
+class RasterizeRunnable : public QRunnable
+{
+public:
+    RasterizeRunnable(std::function<void()> work) : work_ { std::move(work) } {}
+    void run() override { work_(); }
+
+private:
+    std::function<void()> work_;
+};
+
+}
+
+QFontFaceReader::QFontFaceReader(const QFont &font, std::string text,
+                                 std::optional<f2b::font::glyph_size> forced_size,
+                                 options opts) :
     f2b::font::face_reader()
 {
-    std::string source_text { text.empty() ? ascii_glyphs : std::move(text) };
-    num_glyphs_ = source_text.length();
+    auto glyphs = split_glyphs(text.empty() ? std::string(ascii_glyphs) : std::move(text));
+    num_glyphs_ = glyphs.size();
 
-    auto result = read_font(font, std::move(source_text), forced_size);
-    sz_ = result.first;
-    font_image_ = std::move(result.second);
+    std::vector<char32_t> code_points;
+    code_points.reserve(glyphs.size());
+    for (const auto& glyph : glyphs) {
+        code_points.push_back(static_cast<char32_t>(glyph.toUcs4().value(0)));
+    }
+    code_points_ = f2b::font::code_point_map(code_points);
+
+    read_font(font, glyphs, forced_size, opts);
+}
+
+std::pair<const QImage&, int> QFontFaceReader::image_line(std::size_t glyph_id, std::size_t y) const
+{
+    auto position = render_positions_[glyph_id];
+    const auto& image = chunk_images_[position / glyphs_per_chunk_];
+    return { image, static_cast<int>((position % glyphs_per_chunk_) * sz_.height + y) };
 }
 
 bool QFontFaceReader::is_pixel_set(std::size_t glyph_id, f2b::font::point p) const
 {
-    p.y += glyph_id * sz_.height;
-    return font_image_->pixelColor(f2b::font::qpoint_with_point(p)) == Qt::color1;
+    if (!cached_glyphs_.empty() && cached_glyphs_[glyph_id].has_value()) {
+        return cached_glyphs_[glyph_id]->is_pixel_set(p);
+    }
+
+    auto [image, line] = image_line(glyph_id, p.y);
+    return image.pixelColor(static_cast<int>(p.x), line) == Qt::color1;
+}
+
+void QFontFaceReader::read_row(std::size_t glyph_id, std::size_t y, f2b::font::glyph::word_type* row) const
+{
+    using word_type = f2b::font::glyph::word_type;
+    constexpr auto word_bits = f2b::font::glyph::word_bits;
+
+    if (!cached_glyphs_.empty() && cached_glyphs_[glyph_id].has_value()) {
+        const auto& glyph = cached_glyphs_[glyph_id].value();
+        std::copy(glyph.row_data(y), glyph.row_data(y) + glyph.stride(), row);
+        return;
+    }
+
+    std::fill(row, row + f2b::font::glyph::words_per_row(sz_.width), 0);
+
+    auto [image, line] = image_line(glyph_id, y);
+    if (line >= image.height()) {
+        return;
+    }
+
+    // Format_Mono keeps the leftmost pixel in the most significant bit
+    // of each byte, while glyph rows are packed starting from the LSB.
+    // Pixels painted with Qt::color1 are the ones at color table index 1.
+    const uchar *scanline = image.constScanLine(line);
+    const bool is_inverted = image.color(1) != QColor(Qt::color1).rgba();
+    const auto bytes_per_row = (sz_.width + 7) / 8;
+
+    for (std::size_t i = 0; i < bytes_per_row; ++i) {
+        auto byte = f2b::reverse_bits(static_cast<uint8_t>(is_inverted ? ~scanline[i] : scanline[i]));
+        auto bit = i * 8;
+        row[bit / word_bits] |= word_type { byte } << (bit % word_bits);
+    }
+
+    auto trailing_bits = sz_.width % word_bits;
+    if (trailing_bits != 0) {
+        row[(sz_.width - 1) / word_bits] &= (word_type { 1 } << trailing_bits) - 1;
+    }
 }
 
-QString QFontFaceReader::template_text(std::string text)
+std::vector<QString> QFontFaceReader::split_glyphs(const std::string& text)
 {
-    std::stringstream stream;
+    std::vector<QString> glyphs;
 
     utf8::iterator i(text.begin(), text.begin(), text.end());
     utf8::iterator end(text.end(), text.begin(), text.end());
@@ -41,20 +118,122 @@ QString QFontFaceReader::template_text(std::string text)
     while (i != end) {
         auto utf8_begin = i;
         auto utf8_end = ++i;
-        stream << std::string(utf8_begin.base(), utf8_end.base()) << "\n";
+        glyphs.push_back(QString::fromStdString(std::string(utf8_begin.base(), utf8_end.base())));
+    }
+
+    return glyphs;
+}
+
+QString QFontFaceReader::template_text(std::vector<QString>::const_iterator begin,
+                                       std::vector<QString>::const_iterator end)
+{
+    QString text;
+    for (auto i = begin; i != end; ++i) {
+        text += *i;
+        text += '\n';
+    }
+    return text;
+}
+
+static void set_fixed_line_height(QTextDocument &doc, int line_spacing)
+{
+    QTextFrame *rootFrame = doc.rootFrame();
+    for (auto it = rootFrame->begin(); !(it.atEnd()); ++it) {
+        auto block = it.currentBlock();
+        QTextCursor cursor(block);
+        auto blockFormat = block.blockFormat();
+        blockFormat.setLineHeight(line_spacing, QTextBlockFormat::FixedHeight);
+        cursor.setBlockFormat(blockFormat);
+    }
+}
+
+QPointF QFontFaceReader::baseline_position(const QFont &font, int width, int line_spacing)
+{
+    //
+    // Where QTextDocument puts the baseline of a fixed-height line depends
+    // on the Qt version, so lay out a single line once and take the baseline
+    // from there. Every next line is offset by exactly line_spacing.
+    //
+    // The line holds a fixed reference character of the font, so that
+    // the baseline doesn't depend on which glyphs are rendered (e.g. when
+    // some of them come from cache, or the first one uses a fallback font).
+    //
+    QImage image(QSize(std::max(width, 1), std::max(line_spacing, 1)), QImage::Format::Format_Mono);
+
+    QTextDocument doc;
+    doc.documentLayout()->setPaintDevice(&image);
+    doc.setDefaultFont(font);
+    doc.setDocumentMargin(0);
+    doc.setPlainText(QStringLiteral("M"));
+    doc.setTextWidth(width);
+    set_fixed_line_height(doc, line_spacing);
+    doc.documentLayout()->documentSize(); // forces layout
+
+    auto block = doc.firstBlock();
+    auto layout = block.layout();
+    if (layout == nullptr || layout->lineCount() == 0) {
+        return { 0, static_cast<qreal>(QFontMetrics(font).ascent()) };
+    }
+    auto line = layout->lineAt(0);
+    return layout->position() + QPointF(line.x(), line.y() + line.ascent());
+}
+
+QImage QFontFaceReader::draw_glyphs(const QFont &font,
+                                    std::vector<QString>::const_iterator begin,
+                                    std::vector<QString>::const_iterator end,
+                                    QSize glyph_size, int line_spacing, QPointF baseline)
+{
+    auto num_glyphs = static_cast<int>(std::distance(begin, end));
+    QSize img_size(glyph_size.width(), glyph_size.height() * num_glyphs);
+
+    QImage image(img_size, QImage::Format::Format_Mono);
+    QPainter p(&image);
+    p.fillRect(QRect(QPoint(), img_size), QColor(Qt::color0));
+    p.setFont(font);
+    p.setPen(QColor(Qt::color1));
+
+    for (auto i = begin; i != end; ++i, baseline.ry() += line_spacing) {
+        p.drawText(baseline, *i);
     }
 
-    return QString::fromStdString(stream.str());
+    p.end();
+
+    return image;
 }
 
-std::pair<f2b::font::glyph_size, std::unique_ptr<QImage>> QFontFaceReader::read_font(
-            const QFont &font,
-            std::string text,
-            std::optional<f2b::font::glyph_size> forced_size)
+QImage QFontFaceReader::render_glyphs(const QFont &font, const QString& template_text,
+                                      std::size_t num_glyphs, QSize glyph_size, int line_spacing)
 {
-    auto text_length = text.length();
-    auto template_text = QFontFaceReader::template_text(std::move(text));
+    QSize img_size(glyph_size.width(), glyph_size.height() * static_cast<int>(num_glyphs));
+
+    QImage image(img_size, QImage::Format::Format_Mono);
+    QPainter p(&image);
+    p.fillRect(QRect(QPoint(), img_size), QColor(Qt::color0));
+
+    QTextDocument doc;
+    doc.useDesignMetrics();
+    doc.documentLayout()->setPaintDevice(&image);
+    doc.setDefaultFont(font);
+    doc.setDocumentMargin(0);
+    doc.setPlainText(template_text);
+    doc.setTextWidth(img_size.width());
+    set_fixed_line_height(doc, line_spacing);
 
+    QAbstractTextDocumentLayout::PaintContext ctx;
+    ctx.palette.setColor(QPalette::Text, Qt::color1);
+
+    doc.documentLayout()->draw(&p, ctx);
+
+    p.end();
+
+    return image;
+}
+
+void QFontFaceReader::read_font(const QFont &font,
+                                const std::vector<QString>& glyphs,
+                                std::optional<f2b::font::glyph_size> forced_size,
+                                options opts)
+{
     QFontMetrics fm(font);
     qDebug() << font << fm.height() << fm.maxWidth() << fm.leading() << fm.lineSpacing();
 
@@ -62,7 +241,7 @@ std::pair<f2b::font::glyph_size, std::unique_ptr<QImage>> QFontFaceReader::read_
         if (forced_size.has_value()) {
             return static_cast<int>(forced_size.value().width);
         }
-        return fm.boundingRect(QRect(), Qt::AlignLeft, template_text).width();
+        return fm.boundingRect(QRect(), Qt::AlignLeft, template_text(glyphs.cbegin(), glyphs.cend())).width();
     }();
     int height = [&] {
         if (forced_size.has_value()) {
@@ -71,40 +250,88 @@ std::pair<f2b::font::glyph_size, std::unique_ptr<QImage>> QFontFaceReader::read_
         return fm.lineSpacing();
     }();
 
-    QSize img_size(width, height * text_length);
+    auto line_spacing = fm.lineSpacing();
+    sz_ = f2b::font::size_with_qsize(QSize(width, line_spacing));
 
-//    qDebug() << "img size" << img_size;
+    // Look up cached glyphs and only rasterize the remaining ones.
+    std::vector<QString> glyphs_to_render;
+    QString font_key;
+    render_positions_.resize(glyphs.size());
 
-    auto image = std::make_unique<QImage>(img_size, QImage::Format::Format_Mono);
-    QPainter p(image.get());
-    p.fillRect(QRect(QPoint(), img_size), QColor(Qt::color0));
+    if (opts.cache != nullptr) {
+        font_key = GlyphRasterCache::fontKey(font, { static_cast<std::size_t>(width), static_cast<std::size_t>(height) }, opts.rendering_engine);
+        cached_glyphs_.resize(glyphs.size());
 
-    QTextDocument doc;
-    doc.useDesignMetrics();
-    doc.documentLayout()->setPaintDevice(image.get());
-    doc.setDefaultFont(font);
-    doc.setDocumentMargin(0);
-    doc.setPlainText(template_text);
-    doc.setTextWidth(img_size.width());
-
-    QTextFrame *rootFrame = doc.rootFrame();
-    for (auto it = rootFrame->begin(); !(it.atEnd()); ++it) {
-        auto block = it.currentBlock();
-        QTextCursor cursor(block);
-        auto blockFormat = block.blockFormat();
-        blockFormat.setLineHeight(fm.lineSpacing(), QTextBlockFormat::FixedHeight);
-        cursor.setBlockFormat(blockFormat);
+        for (std::size_t i = 0; i < glyphs.size(); ++i) {
+            auto glyph = opts.cache->glyph(font_key, glyphs[i].toUcs4().value(0));
+            if (glyph.has_value() && glyph->size() == sz_) {
+                cached_glyphs_[i] = std::move(glyph);
+            } else {
+                render_positions_[i] = glyphs_to_render.size();
+                glyphs_to_render.push_back(glyphs[i]);
+            }
+        }
+        qDebug() << glyphs.size() - glyphs_to_render.size() << "of" << glyphs.size() << "glyphs found in cache";
+    } else {
+        for (std::size_t i = 0; i < glyphs.size(); ++i) {
+            render_positions_[i] = i;
+        }
+        glyphs_to_render = glyphs;
     }
 
-    QAbstractTextDocumentLayout::PaintContext ctx;
-    ctx.palette.setColor(QPalette::Text, Qt::color1);
+    auto thread_count = opts.thread_count > 0 ? opts.thread_count : QThread::idealThreadCount();
 
-    doc.documentLayout()->draw(&p, ctx);
+    auto num_threads = static_cast<std::size_t>(std::max(thread_count, 1));
+    glyphs_per_chunk_ = num_threads == 1
+            ? std::max<std::size_t>(glyphs_to_render.size(), 1)
+            : std::max((glyphs_to_render.size() + num_threads - 1) / num_threads, min_glyphs_per_chunk);
 
-    p.end();
+    auto num_chunks = (glyphs_to_render.size() + glyphs_per_chunk_ - 1) / glyphs_per_chunk_;
+    chunk_images_.resize(num_chunks);
 
-//    image->save("output.bmp");
+    QPointF baseline;
+    if (opts.rendering_engine == engine::direct && !glyphs_to_render.empty()) {
+        baseline = baseline_position(font, width, line_spacing);
+    }
 
-    return { f2b::font::size_with_qsize(QSize(width, fm.lineSpacing())), std::move(image) };
-}
+    auto render_chunk = [&, width, height, line_spacing](std::size_t chunk) {
+        auto begin = glyphs_to_render.cbegin() + static_cast<std::ptrdiff_t>(chunk * glyphs_per_chunk_);
+        auto end = glyphs_to_render.cbegin() + static_cast<std::ptrdiff_t>(std::min((chunk + 1) * glyphs_per_chunk_, glyphs_to_render.size()));
+        switch (opts.rendering_engine) {
+        case engine::text_document:
+            chunk_images_[chunk] = render_glyphs(font, template_text(begin, end),
+                                                 static_cast<std::size_t>(std::distance(begin, end)),
+                                                 QSize(width, height), line_spacing);
+            break;
+        case engine::direct:
+            chunk_images_[chunk] = draw_glyphs(font, begin, end, QSize(width, height), line_spacing, baseline);
+            break;
+        }
+    };
 
+    if (num_chunks <= 1) {
+        for (std::size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            render_chunk(chunk);
+        }
+    } else {
+        // QPainter on QImage is safe to use outside of the GUI thread,
+        // and every chunk is rendered to its own image.
+        QThreadPool pool;
+        pool.setMaxThreadCount(thread_count);
+        for (std::size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            pool.start(new RasterizeRunnable([&render_chunk, chunk] { render_chunk(chunk); }));
+        }
+        pool.waitForDone();
+    }
+
+    if (opts.cache != nullptr && !glyphs_to_render.empty()) {
+        for (std::size_t i = 0; i < glyphs.size(); ++i) {
+            if (!cached_glyphs_[i].has_value()) {
+                opts.cache->insert(font_key, glyphs[i].toUcs4().value(0), QFontFaceReader::read_glyph(i));
+            }
+        }
+        if (opts.save_cache) {
+            opts.cache->save();
+        }
+    }
+}
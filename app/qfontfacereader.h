@@ -5,26 +5,83 @@
 #include <QFont>
 #include <QImage>
 #include <memory>
+#include <optional>
 #include <utility>
+#include <vector>
+
+class GlyphRasterCache;
 
 class QFontFaceReader : public f2b::font::face_reader
 {
 public:
-    explicit QFontFaceReader(const QFont &font, std::string text = {}, std::optional<f2b::font::glyph_size> forced_size = {});
+    /// Glyphs are rasterized in chunks of at least this many characters.
+    static constexpr std::size_t min_glyphs_per_chunk = 32;
+
+    enum class engine {
+        /// Lays out all characters in a QTextDocument, one per line.
+        text_document,
+        /// Draws every character with QPainter::drawText at a precomputed baseline.
+        /// Faster, and produces the same glyphs as text_document for the fonts covered
+        /// by tests, but isn't verified for every font, so it has to be chosen explicitly
+        /// (e.g. with fontedit-cli --import-engine direct).
+        direct
+    };
+
+    struct options {
+        /// Number of rasterizing threads; 0 means QThread::idealThreadCount().
+        int thread_count { 0 };
+        engine rendering_engine { engine::text_document };
+        /// Cache to look up glyphs before rasterizing them (and to store newly rasterized glyphs).
+        GlyphRasterCache *cache { nullptr };
+        /// Whether to save the cache after inserting newly rasterized glyphs. Saving writes
+        /// the whole cache, so interactive imports leave it to be saved once on quit.
+        bool save_cache { false };
+    };
+
+    /**
+     * Rasterizes \c text (or printable ASCII characters if \c text is empty)
+     * using \c font.
+     *
+     * Characters are split into chunks that are rendered into separate images
+     * on up to \c options.thread_count threads. A thread count of 1 renders
+     * all characters into a single image on the calling thread.
+     */
+    explicit QFontFaceReader(const QFont &font, std::string text = {},
+                             std::optional<f2b::font::glyph_size> forced_size = {},
+                             options opts = {});
     virtual ~QFontFaceReader() override = default;
 
     virtual f2b::font::glyph_size font_size() const override { return sz_; }
     virtual std::size_t num_glyphs() const override { return num_glyphs_; }
     virtual bool is_pixel_set(std::size_t glyph_id, f2b::font::point p) const override;
+    virtual void read_row(std::size_t glyph_id, std::size_t y, f2b::font::glyph::word_type* row) const override;
+    virtual f2b::font::code_point_map code_points() const override { return code_points_; }
 
 private:
-    static QString template_text(std::string text);
-    static std::pair<f2b::font::glyph_size, std::unique_ptr<QImage>> read_font(
-            const QFont &font, std::string text, std::optional<f2b::font::glyph_size> forcedSize);
+    static std::vector<QString> split_glyphs(const std::string& text);
+    static QString template_text(std::vector<QString>::const_iterator begin,
+                                 std::vector<QString>::const_iterator end);
+    static QImage render_glyphs(const QFont &font, const QString& template_text,
+                                std::size_t num_glyphs, QSize glyph_size, int line_spacing);
+    static QImage draw_glyphs(const QFont &font,
+                              std::vector<QString>::const_iterator begin,
+                              std::vector<QString>::const_iterator end,
+                              QSize glyph_size, int line_spacing, QPointF baseline);
+    static QPointF baseline_position(const QFont &font, int width, int line_spacing);
+    void read_font(const QFont &font, const std::vector<QString>& glyphs,
+                   std::optional<f2b::font::glyph_size> forced_size, options opts);
+
+    std::pair<const QImage&, int> image_line(std::size_t glyph_id, std::size_t y) const;
 
     f2b::font::glyph_size sz_ { 0, 0 };
-    std::unique_ptr<QImage> font_image_ { nullptr };
+    // Glyphs found in cache, indexed by glyph ID (empty if no cache is used)
+    std::vector<std::optional<f2b::font::glyph>> cached_glyphs_;
+    // Glyph ID -> position of the glyph in chunk images
+    std::vector<std::size_t> render_positions_;
+    std::vector<QImage> chunk_images_;
+    std::size_t glyphs_per_chunk_ { 0 };
     std::size_t num_glyphs_ { 0 };
+    f2b::font::code_point_map code_points_;
 };
 
 #endif // QFONTFACEREADER_H
@@ -4,43 +4,44 @@
 
 void SourceCodeRunnable::run()
 {
-    QString output;
+    std::string output;
 
     QElapsedTimer timer;
     timer.start();
-    if (format_ == f2b::format::arduino::identifier) {
-        output = QString::fromStdString(generator_.generate<f2b::format::arduino>(face_, fontArrayName_));
-    } else if (format_ == f2b::format::c::identifier) {
-        output = QString::fromStdString(generator_.generate<f2b::format::c>(face_, fontArrayName_));
-    } else if (format_ == f2b::format::python_list::identifier) {
-        output = QString::fromStdString(generator_.generate<f2b::format::python_list>(face_, fontArrayName_));
-    } else if (format_ == f2b::format::python_bytes::identifier) {
-        output = QString::fromStdString(generator_.generate<f2b::format::python_bytes>(face_, fontArrayName_));
+    try {
+        generate(face_, generator_, format_, fontArrayName_, f2b::string_sink(output));
+    } catch (const f2b::generation_canceled&) {
+        qDebug() << "Generation canceled after" << timer.elapsed() << "ms";
+        setFinished(true);
+        return;
     }
     qDebug() << "Generation finished in" << timer.elapsed() << "ms";
 
     setFinished(true);
     if (!isCanceled()) {
-        handler_(output);
+        handler_(QString::fromStdString(output));
     }
 }
 
-bool SourceCodeRunnable::isFinished()
-{
-    std::scoped_lock lock { mutex_ };
-    return m_finished;
-}
-
-bool SourceCodeRunnable::isCanceled()
+void SourceCodeRunnable::generate(const f2b::font::face& face, f2b::font_source_code_generator& generator,
+                                  const std::string& format, const std::string& fontArrayName,
+                                  const f2b::output_sink& sink)
 {
-    std::scoped_lock lock { mutex_ };
-    return m_canceled;
+    if (format == f2b::format::arduino::identifier) {
+        generator.generate<f2b::format::arduino>(face, sink, fontArrayName);
+    } else if (format == f2b::format::c::identifier) {
+        generator.generate<f2b::format::c>(face, sink, fontArrayName);
+    } else if (format == f2b::format::python_list::identifier) {
+        generator.generate<f2b::format::python_list>(face, sink, fontArrayName);
+    } else if (format == f2b::format::python_bytes::identifier) {
+        generator.generate<f2b::format::python_bytes>(face, sink, fontArrayName);
+    }
 }
 
-void SourceCodeRunnable::setCanceled(bool canceled)
+bool SourceCodeRunnable::isFinished()
 {
     std::scoped_lock lock { mutex_ };
-    m_canceled = canceled;
+    return m_finished;
 }
 
 void SourceCodeRunnable::setFinished(bool finished)
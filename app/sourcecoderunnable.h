@@ -15,33 +15,44 @@ class SourceCodeRunnable : public QRunnable
 
 public:
     SourceCodeRunnable(f2b::font::face face, f2b::source_code_options options,
-                       const QString& format, const QString& fontArrayName)
+                       const QString& format, const QString& fontArrayName,
+                       std::shared_ptr<f2b::glyph_fragment_cache> fragmentCache = {})
         : QRunnable(),
           face_ { std::move(face) },
-          generator_ { options },
+          generator_ { options, std::move(fragmentCache) },
           format_ { format.toStdString() },
           fontArrayName_ { fontArrayName.toStdString() }
-    {};
+    {
+        generator_.set_cancellation_token(cancellationToken_);
+    };
 
     void run() override;
 
+    /// Generates source code in a given \c format (identifier) and passes it to \c sink.
+    static void generate(const f2b::font::face& face, f2b::font_source_code_generator& generator,
+                         const std::string& format, const std::string& fontArrayName,
+                         const f2b::output_sink& sink);
+
     void setCompletionHandler(CompletionHandler handler) {
         handler_ = std::move(handler);
     }
 
     bool isFinished();
 
-    bool isCanceled();
-    void setCanceled(bool canceled);
+    /// The token canceling this runnable; the generator checks it between glyphs.
+    std::shared_ptr<f2b::cancellation_token> cancellationToken() const { return cancellationToken_; }
+
+    bool isCanceled() const { return cancellationToken_->is_canceled(); }
+    void cancel() { cancellationToken_->cancel(); }
 
 protected:
     void setFinished(bool finished);
 
 private:
     bool m_finished { false };
-    bool m_canceled { false };
     std::mutex mutex_;
 
+    std::shared_ptr<f2b::cancellation_token> cancellationToken_ { std::make_shared<f2b::cancellation_token>() };
     f2b::font::face face_;
     f2b::font_source_code_generator generator_;
     std::string format_;
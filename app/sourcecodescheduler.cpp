@@ -0,0 +1,94 @@
+#include "sourcecodescheduler.h"
+#include "sourcecoderunnable.h"
+
+#include <QDebug>
+
+// Shared with running jobs, so that they can finish safely after the scheduler is gone.
+struct SourceCodeScheduler::State
+{
+    std::atomic<quint64> latestEpoch { 0 };
+    std::atomic<quint64> publishedEpoch { 0 };
+
+    // Guards currentToken
+    std::mutex mutex;
+    std::shared_ptr<f2b::cancellation_token> currentToken;
+
+    // Serializes publishing, so that a stale result can't overwrite a newer one
+    std::mutex publishMutex;
+    ResultHandler handler;
+
+    void publish(quint64 epoch, const f2b::cancellation_token& token, const QString& sourceCode)
+    {
+        std::scoped_lock lock { publishMutex };
+        if (token.is_canceled() || epoch != latestEpoch || epoch <= publishedEpoch) {
+            qDebug() << "Dropping stale source code, epoch" << epoch;
+            return;
+        }
+        publishedEpoch = epoch;
+        if (handler) {
+            handler(sourceCode, epoch);
+        }
+    }
+};
+
+SourceCodeScheduler::SourceCodeScheduler(QThreadPool *threadPool) :
+    threadPool_ { threadPool },
+    state_ { std::make_shared<State>() }
+{
+}
+
+SourceCodeScheduler::~SourceCodeScheduler()
+{
+    cancel();
+}
+
+void SourceCodeScheduler::setResultHandler(ResultHandler handler)
+{
+    std::scoped_lock lock { state_->publishMutex };
+    state_->handler = std::move(handler);
+}
+
+quint64 SourceCodeScheduler::submit(f2b::font::face face, f2b::source_code_options options,
+                                    const QString& format, const QString& fontArrayName,
+                                    std::shared_ptr<f2b::glyph_fragment_cache> fragmentCache)
+{
+    auto r = new SourceCodeRunnable { std::move(face), options, format, fontArrayName, std::move(fragmentCache) };
+    auto token = r->cancellationToken();
+
+    quint64 epoch;
+    {
+        std::scoped_lock lock { state_->mutex };
+        epoch = ++state_->latestEpoch;
+        if (state_->currentToken) {
+            state_->currentToken->cancel();
+        }
+        state_->currentToken = token;
+    }
+
+    r->setCompletionHandler([state = state_, epoch, token](const QString& output) {
+        state->publish(epoch, *token, output);
+    });
+    r->setAutoDelete(true);
+
+    threadPool_->start(r);
+    return epoch;
+}
+
+void SourceCodeScheduler::cancel()
+{
+    std::scoped_lock lock { state_->mutex };
+    if (state_->currentToken) {
+        state_->currentToken->cancel();
+        state_->currentToken.reset();
+    }
+}
+
+quint64 SourceCodeScheduler::latestEpoch() const
+{
+    return state_->latestEpoch;
+}
+
+quint64 SourceCodeScheduler::publishedEpoch() const
+{
+    return state_->publishedEpoch;
+}
@@ -0,0 +1,57 @@
+#ifndef SOURCECODESCHEDULER_H
+#define SOURCECODESCHEDULER_H
+
+#include <QString>
+#include <QThreadPool>
+#include <f2b.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief Runs source code generation in the background, publishing
+ *        only the most recently requested result.
+ *
+ * Every submitted job is assigned an epoch greater than epochs of all jobs
+ * submitted before it. Submitting a job cancels the previous one (the generator
+ * stops at the next glyph), and a result is passed to the result handler
+ * only if no newer job was submitted in the meantime, so results are
+ * published in increasing epoch order and stale results are dropped.
+ */
+class SourceCodeScheduler
+{
+public:
+    /// Called on a worker thread with generated source code and the epoch of its job.
+    using ResultHandler = std::function<void(const QString& sourceCode, quint64 epoch)>;
+
+    explicit SourceCodeScheduler(QThreadPool *threadPool = QThreadPool::globalInstance());
+    ~SourceCodeScheduler();
+
+    SourceCodeScheduler(const SourceCodeScheduler&) = delete;
+    SourceCodeScheduler& operator=(const SourceCodeScheduler&) = delete;
+
+    void setResultHandler(ResultHandler handler);
+
+    /// Starts generating source code for \c face, canceling the previous job. Returns the job's epoch.
+    quint64 submit(f2b::font::face face, f2b::source_code_options options,
+                   const QString& format, const QString& fontArrayName,
+                   std::shared_ptr<f2b::glyph_fragment_cache> fragmentCache = {});
+
+    /// Cancels the current job, if any.
+    void cancel();
+
+    /// The epoch of the most recently submitted job (0 if none).
+    quint64 latestEpoch() const;
+    /// The epoch of the most recently published result (0 if none).
+    quint64 publishedEpoch() const;
+
+private:
+    struct State;
+
+    QThreadPool *threadPool_;
+    std::shared_ptr<State> state_;
+};
+
+#endif // SOURCECODESCHEDULER_H
@@ -1,38 +1,156 @@
 #ifndef GLYPHEDITCOMMAND_H
 #define GLYPHEDITCOMMAND_H
 
-#include <unordered_map>
-#include <memory>
-#include <functional>
 #include <f2b.h>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
-struct PointHash {
-    size_t operator()(const f2b::font::point &p) const {
-        return std::hash<std::size_t>()(p.x) ^ std::hash<std::size_t>()(p.y);
-    }
-};
-
-struct BatchPixelChange {
+/**
+ * @brief Pixels of a glyph set to new values, stored as a pair of glyph-sized
+ *        bitmasks: pixels touched by the change, and values they're set to.
+ *
+ * Changes are applied (or reversed) one row word at a time.
+ */
+class BatchPixelChange {
+public:
     enum class ChangeType {
         Normal, Reverse
     };
 
-    std::unordered_map<f2b::font::point,bool,PointHash> changes;
+    using word_type = f2b::font::glyph::word_type;
+
+    explicit BatchPixelChange(f2b::font::glyph_size size = {}) :
+        touched_ { size },
+        values_ { size }
+    {}
 
-    void add(const f2b::font::point &pixel, bool value) {
-        auto i = changes.find(pixel);
-        if (i == changes.end()) {
-            changes.insert({ pixel, value });
-        } else if (i->second != value) {
-            changes.erase(pixel);
+    /**
+     * A change of pixels set in \c touched to their values in \c values.
+     * Throws \c std::invalid_argument if the masks differ in size.
+     */
+    static BatchPixelChange fromMasks(const f2b::font::glyph& touched, const f2b::font::glyph& values) {
+        if (touched.size() != values.size()) {
+            throw std::invalid_argument { "Pixel change masks differ in size" };
         }
+        BatchPixelChange change { touched.size() };
+        change.touched_ = touched;
+        std::vector<word_type> row(touched.stride());
+        for (std::size_t y = 0; y < touched.size().height; ++y) {
+            auto touchedRow = touched.row_data(y);
+            auto valuesRow = values.row_data(y);
+            for (std::size_t i = 0; i < row.size(); ++i) {
+                row[i] = touchedRow[i] & valuesRow[i];
+            }
+            change.values_.set_row(y, row.data());
+        }
+        return change;
+    }
+
+    f2b::font::glyph_size size() const noexcept { return touched_.size(); }
+
+    /// Pixels changed by the change.
+    const f2b::font::glyph& touched() const noexcept { return touched_; }
+    /// Values of changed pixels (other pixels are clear).
+    const f2b::font::glyph& values() const noexcept { return values_; }
+
+    /**
+     * Sets pixel \c p to \c value. Setting a pixel back to a value opposite
+     * to the one it was previously changed to cancels the change.
+     */
+    void add(const f2b::font::point &p, bool value) {
+        if (!touched_.is_pixel_set(p)) {
+            touched_.set_pixel_set(p, true);
+            values_.set_pixel_set(p, value);
+        } else if (values_.is_pixel_set(p) != value) {
+            touched_.set_pixel_set(p, false);
+            values_.set_pixel_set(p, false);
+        }
+    }
+
+    /// The value pixel \c p is changed to, or nothing if it isn't changed.
+    std::optional<bool> valueAt(const f2b::font::point &p) const {
+        if (!touched_.is_pixel_set(p)) {
+            return {};
+        }
+        return values_.is_pixel_set(p);
+    }
+
+    bool isEmpty() const {
+        for (auto word : touched_.words()) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear() {
+        touched_ = f2b::font::glyph { size() };
+        values_ = f2b::font::glyph { size() };
+    }
+
+    /// A change setting the same pixels to opposite values.
+    BatchPixelChange reversed() const {
+        BatchPixelChange change { size() };
+        change.touched_ = touched_;
+        std::vector<word_type> row(touched_.stride());
+        for (std::size_t y = 0; y < size().height; ++y) {
+            auto touched = touched_.row_data(y);
+            auto values = values_.row_data(y);
+            for (std::size_t i = 0; i < row.size(); ++i) {
+                row[i] = touched[i] & ~values[i];
+            }
+            change.values_.set_row(y, row.data());
+        }
+        return change;
     }
 
     void apply(f2b::font::glyph& glyph, ChangeType type = ChangeType::Normal) const {
-        for (const auto& i : changes) {
-            glyph.set_pixel_set(i.first, type == ChangeType::Normal ? i.second : !i.second);
+        if (glyph.size() != size()) {
+            throw std::invalid_argument { "Pixel change size doesn't match glyph size" };
+        }
+
+        // Reversing sets touched pixels to the opposite of their values.
+        word_type flip = type == ChangeType::Normal ? 0 : ~word_type { 0 };
+        std::vector<word_type> row(glyph.stride());
+        for (std::size_t y = 0; y < size().height; ++y) {
+            auto pixels = glyph.row_data(y);
+            auto touched = touched_.row_data(y);
+            auto values = values_.row_data(y);
+            for (std::size_t i = 0; i < row.size(); ++i) {
+                row[i] = (pixels[i] & ~touched[i]) | ((values[i] ^ flip) & touched[i]);
+            }
+            glyph.set_row(y, row.data());
+        }
+    }
+
+    /// Calls \c f with every changed pixel and the value it's set to, in row-major order.
+    template<typename F>
+    void forEach(F f) const {
+        constexpr auto word_bits = f2b::font::glyph::word_bits;
+        for (std::size_t y = 0; y < size().height; ++y) {
+            auto touched = touched_.row_data(y);
+            for (std::size_t i = 0; i < touched_.stride(); ++i) {
+                for (auto word = touched[i]; word != 0; word &= word - 1) {
+                    std::size_t bit = 0;
+                    while (((word >> bit) & 1u) == 0) {
+                        ++bit;
+                    }
+                    f2b::font::point p { i * word_bits + bit, y };
+                    f(p, values_.is_pixel_set(p));
+                }
+            }
         }
     }
+
+    bool operator==(const BatchPixelChange& other) const {
+        return touched_ == other.touched_ && values_ == other.values_;
+    }
+
+private:
+    f2b::font::glyph touched_;
+    f2b::font::glyph values_;
 };
 
 
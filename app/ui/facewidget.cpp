@@ -5,11 +5,10 @@
 #include <QGraphicsSceneEvent>
 #include <QGraphicsScene>
 #include <QGraphicsView>
-#include <QQueue>
+#include <QScrollBar>
 #include <algorithm>
-#include <iterator>
+#include <cmath>
 
-static constexpr auto printable_ascii_offset = ' ';
 static constexpr auto min_cell_height = 120.0;
 static constexpr auto min_image_height = min_cell_height - GlyphInfoWidget::descriptionHeight - 3 * GlyphInfoWidget::cellMargin;
 static constexpr auto max_image_width = FaceWidget::cell_width - 2 * GlyphInfoWidget::cellMargin;
@@ -19,21 +18,6 @@ FaceWidget::FaceWidget(int columnCount, QGraphicsItem *parent) :
     columnCount_ { columnCount }
 {
     setFocusPolicy(Qt::ClickFocus);
-    layout_->setSpacing(0);
-    layout_->setContentsMargins(0, 0, 0, 0);
-    setLayout(layout_);
-}
-
-void FaceWidget::reset()
-{
-    // TODO: Reuse items instead of deleting them all
-    for (auto& item : childItems()) {
-        if (item->zValue() == 0) {
-            delete item;
-        }
-    }
-
-    resetFocusWidget();
 }
 
 QSizeF FaceWidget::calculateImageSize(f2b::font::glyph_size glyph_size)
@@ -65,193 +49,325 @@ void FaceWidget::load(const f2b::font::face &face, f2b::font::margins margins)
 {
     face_ = &face;
     margins_ = margins;
-    reset();
-    auto imageSize = calculateImageSize(face.glyphs_size());
-
-    auto index = 0;
-    for (const auto& g : face.glyphs()) {
-        auto glyphWidget = new GlyphInfoWidget(g, index, true, printable_ascii_offset + index, imageSize, margins);
-        glyphWidget->setIsExportedAdjustable(false);
-
-        addGlyphInfoWidget(glyphWidget, index);
-        index++;
-    }
+    isReadOnly_ = true;
+    focusedGlyphIndex_ = {};
+    reloadFace();
 }
 
 void FaceWidget::load(f2b::font::face &face, f2b::font::margins margins)
 {
     face_ = &face;
     margins_ = margins;
+    isReadOnly_ = false;
+    focusedGlyphIndex_ = {};
     reloadFace();
 }
 
 void FaceWidget::reloadFace()
 {
-    reset();
-
     if (face_ == nullptr) {
+        recycleItems();
+        exportedGlyphs_ = {};
+        previewAtlas_ = {};
         return;
     }
 
-    auto imageSize = calculateImageSize(face_->glyphs_size());
-
-    auto index = 0;
-    auto widgetIndex = 0;
-    auto exportedGlyphIDs = face_->exported_glyph_ids();
-    for (const auto& g : face_->glyphs()) {
-        auto isExported = exportedGlyphIDs.find(index) != exportedGlyphIDs.end();
+    imageSize_ = calculateImageSize(face_->glyphs_size());
+    exportedGlyphs_.assign(face_->num_glyphs(), face_->exported_glyph_ids());
+    previewAtlas_ = GlyphPreviewAtlas(face_->glyphs_size(), face_->num_glyphs(), margins_);
+    relayoutCells();
+}
 
-        if (isExported || showsNonExportedItems_) {
-            auto glyphWidget = new GlyphInfoWidget(g, index, isExported, printable_ascii_offset + index, imageSize, margins_);
+void FaceWidget::relayoutCells()
+{
+    recycleItems();
 
-            connect(glyphWidget, &GlyphInfoWidget::isExportedChanged, [&, index] (bool isExported) {
-                emit glyphExportedStateChanged(index, isExported);
-            });
+    auto rowCount = (cellCount() + columnCount_ - 1) / columnCount_;
+    QSizeF size { itemSize_.width() * columnCount_, itemSize_.height() * rowCount };
+    setMinimumSize(size);
+    setMaximumSize(size);
+    resize(size);
 
-            addGlyphInfoWidget(glyphWidget, widgetIndex);
-            widgetIndex++;
-        }
+    updateVisibleItems();
+    updateFocusWidget();
+}
 
-        index++;
+std::size_t FaceWidget::cellCount() const
+{
+    if (face_ == nullptr) {
+        return 0;
     }
+    return isReadOnly_ || showsNonExportedItems_ ? exportedGlyphs_.size() : exportedGlyphs_.count();
 }
 
-void FaceWidget::addGlyphInfoWidget(QGraphicsLayoutItem *glyphWidget, std::size_t index)
+QRectF FaceWidget::cellRect(std::size_t cell) const
 {
-    auto row = index / columnCount_;
-    auto col = index % columnCount_;
+    auto row = cell / columnCount_;
+    auto col = cell % columnCount_;
+    return { QPointF(col * itemSize_.width(), row * itemSize_.height()), itemSize_ };
+}
 
-    if (row == 0) {
-        layout_->setColumnFixedWidth(index % columnCount_, itemSize_.width());
+std::optional<std::size_t> FaceWidget::cellAtPos(QPointF pos) const
+{
+    if (pos.x() < 0 || pos.y() < 0 || itemSize_.isEmpty()) {
+        return {};
+    }
+    auto col = static_cast<std::size_t>(pos.x() / itemSize_.width());
+    auto row = static_cast<std::size_t>(pos.y() / itemSize_.height());
+    auto cell = row * columnCount_ + col;
+    if (col >= static_cast<std::size_t>(columnCount_) || cell >= cellCount()) {
+        return {};
     }
+    return cell;
+}
 
-    if (col == 0) {
-        layout_->setRowFixedHeight(index / columnCount_, itemSize_.height());
+std::size_t FaceWidget::glyphIndexForCell(std::size_t cell) const
+{
+    return isReadOnly_ || showsNonExportedItems_ ? cell : exportedGlyphs_.select(cell);
+}
+
+std::optional<std::size_t> FaceWidget::cellForGlyphIndex(std::size_t index) const
+{
+    if (index >= exportedGlyphs_.size()) {
+        return {};
+    }
+    if (isReadOnly_ || showsNonExportedItems_) {
+        return index;
     }
+    if (!exportedGlyphs_.test(index)) {
+        return {};
+    }
+    return exportedGlyphs_.rank(index);
+}
 
-    layout_->addItem(glyphWidget, index / columnCount_, index % columnCount_, 1, 1);
+bool FaceWidget::isGlyphExported(std::size_t index) const
+{
+    return isReadOnly_ || exportedGlyphs_.test(index);
 }
 
-void FaceWidget::setCurrentGlyphIndex(std::optional<std::size_t> index)
+QRectF FaceWidget::visibleRect() const
 {
-    if (index.has_value()) {
-        auto item = glyphWidgetAtIndex(index.value());
-        if (item) {
-            setFocusForItem(item, true);
+    QRectF visibleRect;
+    if (scene() != nullptr) {
+        for (auto view : scene()->views()) {
+            auto viewportRect = view->mapToScene(view->viewport()->rect()).boundingRect();
+            visibleRect |= mapRectFromScene(viewportRect);
         }
-    } else {
-        clearFocus();
     }
+    return visibleRect;
 }
 
-void FaceWidget::updateGlyphInfo(std::size_t index, std::optional<f2b::font::glyph> glyph, std::optional<bool> isExported)
+void FaceWidget::attachToViews()
 {
-    auto item = glyphWidgetAtIndex(index);
-    if (item) {
-        item->updateGlyph(glyph, isExported);
+    if (scene() == nullptr) {
+        return;
     }
+
+    for (auto view : scene()->views()) {
+        connect(view->verticalScrollBar(), &QScrollBar::valueChanged,
+                this, &FaceWidget::updateVisibleItems, Qt::UniqueConnection);
+        connect(view->horizontalScrollBar(), &QScrollBar::valueChanged,
+                this, &FaceWidget::updateVisibleItems, Qt::UniqueConnection);
+        // Catch viewport resizes
+        view->viewport()->installEventFilter(this);
+    }
+    updateVisibleItems();
+}
+
+bool FaceWidget::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Resize) {
+        updateVisibleItems();
+    }
+    return QGraphicsWidget::eventFilter(watched, event);
 }
 
-GlyphInfoWidget* FaceWidget::glyphWidgetAtIndex(std::size_t index)
+QVariant FaceWidget::itemChange(GraphicsItemChange change, const QVariant &value)
 {
-    int itemIndex = index;
+    if (change == ItemSceneHasChanged) {
+        attachToViews();
+    }
+    return QGraphicsWidget::itemChange(change, value);
+}
+
+void FaceWidget::updateVisibleItems()
+{
+    auto count = cellCount();
+    auto visible = visibleRect().intersected(rect());
+    if (count == 0 || visible.isEmpty() || itemSize_.isEmpty()) {
+        recycleItems();
+        return;
+    }
 
-    if (!showsNonExportedItems_) {
-        itemIndex = std::count_if(face_->exported_glyph_ids().begin(),
-                                  face_->exported_glyph_ids().find(index),
-                                  [&](std::size_t i) { return i < index; });
+    auto firstRow = static_cast<std::size_t>(visible.top() / itemSize_.height());
+    auto lastRow = static_cast<std::size_t>(visible.bottom() / itemSize_.height());
+    firstRow = firstRow > overscan_rows ? firstRow - overscan_rows : 0;
+    lastRow += overscan_rows;
+
+    auto firstCell = firstRow * columnCount_;
+    auto endCell = std::min(count, (lastRow + 1) * columnCount_);
+
+    for (auto i = items_.begin(); i != items_.end();) {
+        if (i->first < firstCell || i->first >= endCell) {
+            i->second->hide();
+            recycledItems_.push_back(i->second);
+            i = items_.erase(i);
+        } else {
+            ++i;
+        }
     }
 
-    return dynamic_cast<GlyphInfoWidget *>(layout_->itemAt(itemIndex / columnCount_,
-                                                           itemIndex % columnCount_));
+    for (auto cell = firstCell; cell < endCell; ++cell) {
+        if (items_.count(cell) == 0) {
+            items_[cell] = itemForCell(cell);
+        }
+    }
 }
 
-QSize FaceWidget::glyphCoordsAtPos(QPointF pos)
+GlyphInfoWidget* FaceWidget::itemForCell(std::size_t cell)
 {
-    qreal leftMargin;
-    qreal topMargin;
-    layout_->getContentsMargins(&leftMargin, &topMargin, nullptr, nullptr);
-    int row = static_cast<int>((pos.y() - topMargin) / itemSize_.height());
-    int col = static_cast<int>((pos.x() - leftMargin) / itemSize_.width());
-    return { col, row };
+    auto index = glyphIndexForCell(cell);
+    if (!previewAtlas_.containsGlyph(index)) {
+        previewAtlas_.setGlyph(index, face_->glyph_at(index));
+    }
+    auto isExported = isGlyphExported(index);
+    auto codePoint = face_->code_point(index);
+
+    GlyphInfoWidget* item;
+    if (!recycledItems_.empty()) {
+        item = recycledItems_.back();
+        recycledItems_.pop_back();
+        item->load(index, isExported, codePoint, imageSize_);
+        item->show();
+    } else {
+        item = new GlyphInfoWidget(previewAtlas_, index, isExported, codePoint, imageSize_, this);
+        connect(item, &GlyphInfoWidget::isExportedChanged, [&, item] (bool isExported) {
+            emit glyphExportedStateChanged(item->glyphIndex(), isExported);
+        });
+    }
+    item->setIsExportedAdjustable(!isReadOnly_);
+    item->setGeometry(cellRect(cell));
+    return item;
 }
 
-GlyphInfoWidget* FaceWidget::glyphWidgetAtPos(QPointF pos)
+void FaceWidget::recycleItems()
 {
-    auto coords = glyphCoordsAtPos(pos);
-    return dynamic_cast<GlyphInfoWidget *>(layout_->itemAt(coords.height(), coords.width()));
+    for (const auto& [cell, item] : items_) {
+        item->hide();
+        recycledItems_.push_back(item);
+    }
+    items_.clear();
 }
 
-void FaceWidget::setFocusForItem(QGraphicsLayoutItem *item, bool isFocused)
+void FaceWidget::setCurrentGlyphIndex(std::optional<std::size_t> index)
 {
-    if (focusWidget_ == nullptr) {
-        focusWidget_ = std::make_unique<FocusWidget>(this);
-        focusWidget_->setZValue(1);
-        focusWidget_->setColor(Qt::blue);
+    if (index.has_value()) {
+        if (cellForGlyphIndex(index.value()).has_value()) {
+            focusedGlyphIndex_ = index;
+            updateFocusWidget();
+        }
+    } else {
+        clearFocus();
+    }
+}
+
+void FaceWidget::updateGlyphInfo(std::size_t index, std::optional<f2b::font::glyph> glyph, std::optional<bool> isExported)
+{
+    if (glyph.has_value() && index < previewAtlas_.numGlyphs()) {
+        previewAtlas_.setGlyph(index, glyph.value());
     }
 
-    focusedItem_ = item;
-    focusWidget_->setFocus(item, isFocused);
-    if (isFocused) {
-        QGraphicsView *graphicsView = scene()->views().first();
-        if (graphicsView != nullptr)
-            graphicsView->ensureVisible(focusWidget_->geometry());
+    if (isExported.has_value() && !isReadOnly_ && index < exportedGlyphs_.size()
+            && exportedGlyphs_.test(index) != isExported.value()) {
+        exportedGlyphs_.set(index, isExported.value());
+        if (!showsNonExportedItems_) {
+            // Cells following the glyph shift by one
+            relayoutCells();
+            return;
+        }
+    }
+
+    // Cells without widgets are read from the face once they're scrolled into view.
+    auto cell = cellForGlyphIndex(index);
+    if (!cell.has_value()) {
+        return;
+    }
+    auto i = items_.find(cell.value());
+    if (i != items_.end()) {
+        i->second->updateGlyph(isExported);
     }
 }
 
-void FaceWidget::resetFocusWidget()
+void FaceWidget::updateFocusWidget()
 {
-    if (focusWidget_ != nullptr) {
-        focusWidget_->setFocus(nullptr);
+    std::optional<std::size_t> cell;
+    if (focusedGlyphIndex_.has_value()) {
+        cell = cellForGlyphIndex(focusedGlyphIndex_.value());
+    }
+
+    if (!cell.has_value()) {
+        if (focusWidget_ != nullptr) {
+            focusWidget_->setFocus({});
+        }
+        return;
     }
-    focusedItem_ = nullptr;
+
+    if (focusWidget_ == nullptr) {
+        focusWidget_ = std::make_unique<FocusWidget>(this);
+        focusWidget_->setZValue(1);
+        focusWidget_->setColor(Qt::blue);
+    }
+    focusWidget_->setFocus(cellRect(cell.value()));
 }
 
 void FaceWidget::keyPressEvent(QKeyEvent *event)
 {
-    if (focusWidget_ == nullptr) {
+    if (!focusedGlyphIndex_.has_value()) {
         return;
     }
-
-    auto coords = glyphCoordsAtPos(focusWidget_->pos());
-    auto item = dynamic_cast<GlyphInfoWidget *>(layout_->itemAt(coords.height(), coords.width()));
-    if (item == nullptr) {
+    auto focusedCell = cellForGlyphIndex(focusedGlyphIndex_.value());
+    if (!focusedCell.has_value()) {
         return;
     }
 
+    auto row = focusedCell.value() / columnCount_;
+    auto col = focusedCell.value() % columnCount_;
+    auto rowCount = (cellCount() + columnCount_ - 1) / columnCount_;
+
     switch (event->key()) {
     case Qt::Key_Left:
     case Qt::Key_H:
-        if (coords.width() > 0)
-            --coords.rwidth();
+        if (col > 0)
+            --col;
         break;
     case Qt::Key_Right:
     case Qt::Key_L:
-        if (coords.width() < columnCount_ - 1)
-            ++coords.rwidth();
+        if (col < static_cast<std::size_t>(columnCount_) - 1)
+            ++col;
         break;
     case Qt::Key_Up:
     case Qt::Key_K:
-        if (coords.height() > 0)
-            --coords.rheight();
+        if (row > 0)
+            --row;
         break;
     case Qt::Key_Down:
-    case Qt::Key_J: {
-        auto rowCount = (layout_->count() + columnCount_) / columnCount_;
-        if (coords.height() < rowCount - 1)
-            ++coords.rheight();
+    case Qt::Key_J:
+        if (row < rowCount - 1)
+            ++row;
         break;
-    }
-    case Qt::Key_Space: {
-        auto isExported = face_->exported_glyph_ids().find(item->glyphIndex()) != face_->exported_glyph_ids().end();
-        emit glyphExportedStateChanged(item->glyphIndex(), !isExported);
-    }
+    case Qt::Key_Space:
+        if (!isReadOnly_) {
+            auto index = focusedGlyphIndex_.value();
+            emit glyphExportedStateChanged(index, !isGlyphExported(index));
+        }
     }
 
-    item = dynamic_cast<GlyphInfoWidget *>(layout_->itemAt(coords.height(), coords.width()));
-    if (item) {
-        setFocusForItem(item, true);
-        emit currentGlyphIndexChanged(item->glyphIndex());
+    auto cell = row * columnCount_ + col;
+    if (cell < cellCount()) {
+        auto index = glyphIndexForCell(cell);
+        focusedGlyphIndex_ = index;
+        updateFocusWidget();
+        emit currentGlyphIndexChanged(index);
     }
 }
 
@@ -267,20 +383,23 @@ void FaceWidget::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
 
 void FaceWidget::handleMousePress(QGraphicsSceneMouseEvent *event)
 {
-    auto item = glyphWidgetAtPos(event->pos());
-    if (item != nullptr) {
-        setFocusForItem(item, true);
-        emit currentGlyphIndexChanged(item->glyphIndex());
+    auto cell = cellAtPos(event->pos());
+    if (cell.has_value()) {
+        auto index = glyphIndexForCell(cell.value());
+        focusedGlyphIndex_ = index;
+        updateFocusWidget();
+        emit currentGlyphIndexChanged(index);
     } else {
-        resetFocusWidget();
+        focusedGlyphIndex_ = {};
+        updateFocusWidget();
     }
 }
 
 void FaceWidget::updateGeometry()
 {
     QGraphicsWidget::updateGeometry();
-    if (auto fw = focusWidget_.get()) {
-        fw->setFocus(focusedItem_, true);
+    if (focusWidget_ != nullptr) {
+        updateFocusWidget();
     }
 }
 
@@ -288,16 +407,18 @@ void FaceWidget::setShowsNonExportedItems(bool isEnabled)
 {
     if (showsNonExportedItems_ != isEnabled) {
         showsNonExportedItems_ = isEnabled;
-        if (face_ != nullptr && face_->exported_glyph_ids().size() != face_->num_glyphs()) {
-            reloadFace();
+        if (exportedGlyphs_.count() != exportedGlyphs_.size()) {
+            relayoutCells();
         }
-        if (auto fw = focusWidget_.get()) {
-            auto item = glyphWidgetAtPos(fw->pos());
-            if (item != nullptr) {
-                setFocusForItem(item, true);
-                emit currentGlyphIndexChanged(item->glyphIndex());
-            }
+
+        // Keep the focused glyph, or move focus to the next visible glyph if it got hidden.
+        if (focusedGlyphIndex_.has_value() && !cellForGlyphIndex(focusedGlyphIndex_.value()).has_value()
+                && exportedGlyphs_.count() > 0) {
+            auto cell = std::min(exportedGlyphs_.rank(focusedGlyphIndex_.value()), exportedGlyphs_.count() - 1);
+            auto index = glyphIndexForCell(cell);
+            focusedGlyphIndex_ = index;
+            updateFocusWidget();
+            emit currentGlyphIndexChanged(index);
         }
     }
 }
-
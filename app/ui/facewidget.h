@@ -2,20 +2,34 @@
 #define FACEWIDGET_H
 
 #include <QGraphicsWidget>
-#include <QGraphicsGridLayout>
 #include <f2b.h>
 #include "focuswidget.h"
+#include "glyphpreviewatlas.h"
+#include "rankselectindex.h"
 
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 class GlyphInfoWidget;
 
+/**
+ * @brief A grid of glyphs of a face.
+ *
+ * Cell positions are computed from cell indexes, and widgets are created only
+ * for cells in the visible area of the views showing the widget (plus a few
+ * rows around it). Widgets of cells scrolled out of view are reused for cells
+ * scrolled into view.
+ */
 class FaceWidget : public QGraphicsWidget
 {
     Q_OBJECT
 
 public:
     static constexpr auto cell_width = 80.0;
+    /// Rows of cells prepared above and below the visible area.
+    static constexpr std::size_t overscan_rows = 2;
 
     explicit FaceWidget(int columnCount = 3, QGraphicsItem *parent = nullptr);
 
@@ -27,6 +41,8 @@ public:
     bool showsNonExportedItems() const { return showsNonExportedItems_; }
     void setShowsNonExportedItems(bool isEnabled);
 
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 signals:
     void currentGlyphIndexChanged(std::optional<std::size_t> index);
     void glyphExportedStateChanged(std::size_t index, bool isExported);
@@ -36,27 +52,46 @@ protected:
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void updateGeometry() override;
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
 
 private:
     void handleMousePress(QGraphicsSceneMouseEvent *event);
     void reloadFace();
-    void reset();
+    void relayoutCells();
+    void attachToViews();
+    void updateVisibleItems();
+    void recycleItems();
     QSizeF calculateImageSize(f2b::font::glyph_size glyph_size);
-    void addGlyphInfoWidget(QGraphicsLayoutItem* glyphWidget, std::size_t index);
-    void setFocusForItem(QGraphicsLayoutItem *item, bool isFocused);
-    void resetFocusWidget();
+    void updateFocusWidget();
+
+    std::size_t cellCount() const;
+    QRectF cellRect(std::size_t cell) const;
+    std::optional<std::size_t> cellAtPos(QPointF pos) const;
+    std::size_t glyphIndexForCell(std::size_t cell) const;
+    std::optional<std::size_t> cellForGlyphIndex(std::size_t index) const;
+    bool isGlyphExported(std::size_t index) const;
+    QRectF visibleRect() const;
 
+    GlyphInfoWidget* itemForCell(std::size_t cell);
 
-    GlyphInfoWidget* glyphWidgetAtIndex(std::size_t index);
-    GlyphInfoWidget* glyphWidgetAtPos(QPointF pos);
-    QSize glyphCoordsAtPos(QPointF pos);
+    // Cell index -> widget, for cells that have widgets
+    std::unordered_map<std::size_t, GlyphInfoWidget*> items_;
+    // Hidden widgets ready to be reused
+    std::vector<GlyphInfoWidget*> recycledItems_;
+    // Exported state of every glyph; when non-exported glyphs are hidden,
+    // a glyph's cell is its rank and a cell's glyph is selected by the cell index.
+    RankSelectIndex exportedGlyphs_;
+    // Previews of glyphs shown so far, shared by all cells
+    GlyphPreviewAtlas previewAtlas_;
 
-    QGraphicsLayoutItem *focusedItem_ { nullptr };
-    QGraphicsGridLayout *layout_ { new QGraphicsGridLayout() };
+    std::optional<std::size_t> focusedGlyphIndex_;
     std::unique_ptr<FocusWidget> focusWidget_ { nullptr };
     QSizeF itemSize_;
+    QSizeF imageSize_;
     int columnCount_;
-    bool showsNonExportedItems_;
+    bool showsNonExportedItems_ { false };
+    // Set for faces loaded as const: all glyphs are shown as exported and can't be toggled
+    bool isReadOnly_ { false };
     const f2b::font::face* face_ { nullptr };
     f2b::font::margins margins_;
 };
@@ -18,16 +18,12 @@ void FocusWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
     painter->drawRect(rect());
 }
 
-void FocusWidget::setFocus(QGraphicsLayoutItem *item, bool isFocused)
+void FocusWidget::setFocus(std::optional<QRectF> rect)
 {
-    if (item != nullptr) {
-        if (isFocused) {
-            setVisible(true);
-            setGeometry(item->geometry());
-            ensureVisible();
-        } else {
-            setVisible(false);
-        }
+    if (rect.has_value()) {
+        setVisible(true);
+        setGeometry(rect.value());
+        ensureVisible();
     } else {
         setVisible(false);
     }
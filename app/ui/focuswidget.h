@@ -2,8 +2,7 @@
 #define FOCUSWIDGET_H
 
 #include <QGraphicsWidget>
-
-class QGraphicsLayoutItem;
+#include <optional>
 
 class FocusWidget : public QGraphicsWidget
 {
@@ -11,7 +10,8 @@ public:
     explicit FocusWidget(QGraphicsItem *parent = nullptr);
     virtual ~FocusWidget() = default;
 
-    void setFocus(QGraphicsLayoutItem *item, bool isFocused = true);
+    /// Shows the focus frame around \c rect (in parent coordinates), or hides it.
+    void setFocus(std::optional<QRectF> rect);
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
@@ -1,5 +1,5 @@
 #include "glyphinfowidget.h"
-#include "f2b_qt_compat.h"
+#include "glyphpreviewatlas.h"
 #include "common.h"
 
 #include <QPainter>
@@ -10,27 +10,63 @@
 #include <sstream>
 #include <iomanip>
 
-static QString description(unsigned char asciiCode)
+static QString description(std::optional<char32_t> codePoint)
 {
+    if (!codePoint.has_value()) {
+        return QObject::tr("no character");
+    }
+
+    auto value = static_cast<uint>(codePoint.value());
     std::stringstream stream;
-    stream << "hex: 0x" << std::setw(2) << std::setfill('0') << std::hex << static_cast<uint>(asciiCode) << std::endl;
-    stream << "dec: " << std::setw(3) << std::dec << static_cast<uint>(asciiCode) << std::endl;
-    if (std::isprint(asciiCode)) {
-        stream << "chr: '" << asciiCode << "'";
+    stream << "hex: 0x" << std::setw(2) << std::setfill('0') << std::hex << value << std::endl;
+    stream << "dec: " << std::setw(3) << std::dec << value << std::endl;
+
+    auto text = QString::fromStdString(stream.str());
+    auto character = QString::fromUcs4(&value, 1);
+    if (!character.isEmpty() && character.at(0).isPrint()) {
+        text += QString("chr: '%1'").arg(character);
     }
-    return QString::fromStdString(stream.str());
+    return text;
+}
+
+// Created once and shared by all widgets, as they're needed on every paint
+static const QFont& descriptionFont()
+{
+    static const QFont font = [] {
+        QFont f(consoleFontName);
+        f.setStyleHint(QFont::TypeWriter);
+        f.setPixelSize(12);
+        return f;
+    }();
+    return font;
+}
+
+static const QPen& borderPen()
+{
+    static const QPen pen(QBrush(Qt::darkGray), 0.5);
+    return pen;
+}
+
+static const QPen& inactiveTextPen()
+{
+    static const QPen pen(QBrush(QColor(Color::inactiveText)), 0.5);
+    return pen;
 }
 
-GlyphInfoWidget::GlyphInfoWidget(const f2b::font::glyph &glyph, std::size_t index, bool isExported,
-                                 unsigned char asciiCode, QSizeF imageSize,
-                                 f2b::font::margins margins, QGraphicsItem *parent) :
+static const QPen& previewOutlinePen()
+{
+    static const QPen pen(QBrush(Qt::lightGray), 1);
+    return pen;
+}
+
+GlyphInfoWidget::GlyphInfoWidget(const GlyphPreviewAtlas &atlas, std::size_t index, bool isExported,
+                                 std::optional<char32_t> codePoint, QSizeF imageSize, QGraphicsItem *parent) :
     QGraphicsWidget(parent),
-    description_ { description(asciiCode) },
+    description_ { description(codePoint) },
     imageSize_ { imageSize },
     isExportedAdjustable_ { true },
     isExported_ { isExported },
-    preview_ { f2b::font::glyph_preview_image(glyph, margins) },
-    margins_ { margins },
+    atlas_ { atlas },
     toggleExportedAction_ { QAction(tr("Exported")) },
     glyphIndex_ { index }
 {
@@ -40,21 +76,26 @@ GlyphInfoWidget::GlyphInfoWidget(const f2b::font::glyph &glyph, std::size_t inde
     connect(&toggleExportedAction_, &QAction::triggered, this, &GlyphInfoWidget::isExportedChanged);
 }
 
+void GlyphInfoWidget::load(std::size_t index, bool isExported, std::optional<char32_t> codePoint, QSizeF imageSize)
+{
+    description_ = description(codePoint);
+    imageSize_ = imageSize;
+    isExported_ = isExported;
+    glyphIndex_ = index;
+    toggleExportedAction_.setChecked(isExported_);
+    update();
+}
+
 void GlyphInfoWidget::setIsExportedAdjustable(bool isEnabled)
 {
     isExportedAdjustable_ = isEnabled;
 }
 
-void GlyphInfoWidget::updateGlyph(std::optional<f2b::font::glyph> glyph, std::optional<bool> isExported, std::optional<f2b::font::margins> margins)
+void GlyphInfoWidget::updateGlyph(std::optional<bool> isExported)
 {
     if (isExported.has_value()) {
         isExported_ = isExported.value();
-    }
-    if (margins.has_value()) {
-        margins_ = margins.value();
-    }
-    if (glyph.has_value()) {
-        preview_ = f2b::font::glyph_preview_image(glyph.value(), margins_);
+        toggleExportedAction_.setChecked(isExported_);
     }
     update();
 }
@@ -76,13 +117,9 @@ void GlyphInfoWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
     Q_UNUSED(widget);    
 
     painter->fillRect(rect(), QBrush(Qt::white));
-    QPen pen(QBrush(Qt::darkGray), 0.5);
-    painter->setPen(pen);
+    painter->setPen(borderPen());
     painter->drawRect(rect());
 
-    QFont f(consoleFontName);
-    f.setStyleHint(QFont::TypeWriter);
-    f.setPixelSize(12);
     QRectF textRect(rect());
     textRect.setTop(cellMargin);
     textRect.setLeft(cellMargin);
@@ -90,10 +127,10 @@ void GlyphInfoWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
     textRect.setHeight(descriptionHeight);
 
     if (!isExported_) {
-        painter->setPen(QPen(QBrush(QColor(Color::inactiveText)), 0.5));
+        painter->setPen(inactiveTextPen());
     }
 
-    painter->setFont(f);
+    painter->setFont(descriptionFont());
     painter->drawText(textRect, Qt::TextWordWrap, description_);
 
 
@@ -106,14 +143,13 @@ void GlyphInfoWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 
 
     // Glyph rect (margins removed)
-    preview_.setColor(0, isExported_ ? Color::activeGlyph : Color::inactiveGlyph);
-
-    QRectF imageSansMarginsRect = imageRect.marginsRemoved(QMarginsF(0, margins_.top, 0, margins_.bottom));
-    painter->drawImage(imageSansMarginsRect, preview_, preview_.rect());
+    auto margins = atlas_.margins();
+    QRectF imageSansMarginsRect = imageRect.marginsRemoved(QMarginsF(0, margins.top, 0, margins.bottom));
+    painter->drawImage(imageSansMarginsRect, atlas_.image(isExported_), atlas_.tileRect(glyphIndex_));
 
 
     // Glyph preview outline
 
-    painter->setPen(QPen(QBrush(Qt::lightGray), 1));
+    painter->setPen(previewOutlinePen());
     painter->drawRect(imageRect.marginsAdded(QMarginsF(0.5, 0.5, 0.5, 0.5)));
 }
@@ -2,12 +2,13 @@
 #define GLYPHINFOWIDGET_H
 
 #include <QGraphicsWidget>
-#include <QImage>
 #include <QAction>
 #include <f2b.h>
 
 #include <optional>
 
+class GlyphPreviewAtlas;
+
 class GlyphInfoWidget : public QGraphicsWidget
 {
     Q_OBJECT
@@ -16,12 +17,20 @@ public:
     static constexpr auto cellMargin = 6.0;
     static constexpr auto descriptionHeight = 50.0;
 
-    GlyphInfoWidget(const f2b::font::glyph& glyph, std::size_t index, bool isExported,
-                    unsigned char asciiCode, QSizeF imageSize,
-                    f2b::font::margins margins = {}, QGraphicsItem *parent = nullptr);
+    /**
+     * Creates a widget showing the glyph at \c index, with the preview drawn from
+     * the atlas tile of the glyph. \c atlas must outlive the widget.
+     */
+    GlyphInfoWidget(const GlyphPreviewAtlas& atlas, std::size_t index, bool isExported,
+                    std::optional<char32_t> codePoint, QSizeF imageSize, QGraphicsItem *parent = nullptr);
 
     std::size_t glyphIndex() const { return glyphIndex_; }
-    void updateGlyph(std::optional<f2b::font::glyph> glyph, std::optional<bool> isExported = {}, std::optional<f2b::font::margins> margins = {});
+
+    /// Shows another glyph, so that the widget can be reused for a different grid cell.
+    void load(std::size_t index, bool isExported, std::optional<char32_t> codePoint, QSizeF imageSize);
+
+    /// Repaints the glyph after its atlas tile (or exported state) was updated.
+    void updateGlyph(std::optional<bool> isExported = {});
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
@@ -34,12 +43,11 @@ protected:
     void contextMenuEvent(QGraphicsSceneContextMenuEvent *event) override;
 
 private:
-    const QString description_;
-    const QSizeF imageSize_;
+    QString description_;
+    QSizeF imageSize_;
     bool isExportedAdjustable_;
     bool isExported_;
-    QImage preview_;
-    f2b::font::margins margins_;
+    const GlyphPreviewAtlas& atlas_;
     QAction toggleExportedAction_;
 
     std::size_t glyphIndex_;
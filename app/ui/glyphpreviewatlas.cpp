@@ -0,0 +1,70 @@
+#include "glyphpreviewatlas.h"
+#include "f2b_qt_compat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static constexpr QRgb background = 0xffffffff;
+
+GlyphPreviewAtlas::GlyphPreviewAtlas(f2b::font::glyph_size glyphSize, std::size_t numGlyphs, f2b::font::margins margins) :
+    glyphSize_ { glyphSize },
+    margins_ { margins },
+    isFilled_(numGlyphs, false)
+{
+    auto height = glyphSize.height > margins.top + margins.bottom ? glyphSize.height - margins.top - margins.bottom : 0;
+    tileSize_ = QSize(static_cast<int>(glyphSize.width), static_cast<int>(height));
+    tileStride_ = (tileSize_.width() + 7) / 8 * 8;
+
+    if (numGlyphs == 0 || tileSize_.isEmpty()) {
+        return;
+    }
+
+    // Roughly square, to stay within image dimension limits for large faces
+    auto tileCount = std::sqrt(static_cast<double>(numGlyphs) * tileSize_.height() / tileStride_);
+    columnCount_ = static_cast<int>(std::max(1.0, std::ceil(tileCount)));
+    auto rowCount = static_cast<int>((numGlyphs + static_cast<std::size_t>(columnCount_) - 1) / static_cast<std::size_t>(columnCount_));
+
+    // Bit 0 is the background, bit 1 is a set pixel (least significant bit first, like glyph rows)
+    exportedImage_ = QImage(columnCount_ * tileStride_, rowCount * tileSize_.height(), QImage::Format_MonoLSB);
+    exportedImage_.setColorTable({ background, Color::activeGlyph });
+    exportedImage_.fill(0);
+    nonExportedImage_ = exportedImage_.copy();
+    nonExportedImage_.setColor(1, Color::inactiveGlyph);
+}
+
+void GlyphPreviewAtlas::setGlyph(std::size_t index, const f2b::font::glyph &glyph)
+{
+    if (index >= numGlyphs()) {
+        throw std::out_of_range { "Glyph index out of range" };
+    }
+    if (glyph.size() != glyphSize_) {
+        throw std::invalid_argument { "Glyph size doesn't match atlas glyph size" };
+    }
+
+    isFilled_[index] = true;
+    if (tileSize_.isEmpty()) {
+        return;
+    }
+
+    auto rowBytes = static_cast<std::size_t>(tileStride_ / 8);
+    auto tile = tileRect(index);
+    auto byteOffset = tile.x() / 8;
+
+    for (int y = 0; y < tileSize_.height(); ++y) {
+        auto exported = exportedImage_.scanLine(tile.y() + y) + byteOffset;
+        pack_glyph_row(glyph, static_cast<std::size_t>(y) + margins_.top, exported);
+        std::copy(exported, exported + rowBytes, nonExportedImage_.scanLine(tile.y() + y) + byteOffset);
+    }
+}
+
+QRect GlyphPreviewAtlas::tileRect(std::size_t index) const
+{
+    if (columnCount_ == 0) {
+        return {};
+    }
+    auto columnCount = static_cast<std::size_t>(columnCount_);
+    auto row = static_cast<int>(index / columnCount);
+    auto col = static_cast<int>(index % columnCount);
+    return { QPoint(col * tileStride_, row * tileSize_.height()), tileSize_ };
+}
@@ -0,0 +1,59 @@
+#ifndef GLYPHPREVIEWATLAS_H
+#define GLYPHPREVIEWATLAS_H
+
+#include <QImage>
+#include <QRect>
+#include <f2b.h>
+
+#include <vector>
+
+/**
+ * @brief Previews of all glyphs of a face, stored as tiles of a single 1-bit image.
+ *
+ * Tiles hold glyphs with top and bottom margins removed, and are filled by copying
+ * packed glyph rows straight into image scan lines. The atlas is kept in two color
+ * variants, for exported and non-exported glyphs, so that previews can be drawn
+ * as sub-rectangles of a ready image.
+ *
+ * Tiles start empty and are filled with \c setGlyph, which allows filling only
+ * tiles of glyphs that are actually shown.
+ */
+class GlyphPreviewAtlas
+{
+public:
+    GlyphPreviewAtlas() = default;
+    GlyphPreviewAtlas(f2b::font::glyph_size glyphSize, std::size_t numGlyphs, f2b::font::margins margins);
+
+    std::size_t numGlyphs() const noexcept { return isFilled_.size(); }
+    f2b::font::margins margins() const noexcept { return margins_; }
+
+    /// Size of a glyph preview, i.e. a glyph without margins.
+    QSize tileSize() const noexcept { return tileSize_; }
+
+    /// True if the tile at \c index was filled with \c setGlyph.
+    bool containsGlyph(std::size_t index) const { return isFilled_.at(index); }
+
+    /// Replaces the tile at \c index with \c glyph.
+    void setGlyph(std::size_t index, const f2b::font::glyph& glyph);
+
+    /// The rectangle of the tile at \c index in the atlas image.
+    QRect tileRect(std::size_t index) const;
+
+    const QImage& image(bool isExported) const noexcept {
+        return isExported ? exportedImage_ : nonExportedImage_;
+    }
+
+private:
+    f2b::font::glyph_size glyphSize_ {};
+    f2b::font::margins margins_ {};
+    QSize tileSize_;
+    // Tiles start at byte boundaries of scan lines
+    int tileStride_ { 0 };
+    int columnCount_ { 0 };
+    std::vector<bool> isFilled_;
+
+    QImage exportedImage_;
+    QImage nonExportedImage_;
+};
+
+#endif // GLYPHPREVIEWATLAS_H
@@ -1,5 +1,5 @@
 #include "glyphwidget.h"
-#include "common.h"
+#include "f2b_qt_compat.h"
 #include <QPainter>
 #include <QDebug>
 #include <QGraphicsSceneMouseEvent>
@@ -7,7 +7,8 @@
 #include <QStyleOptionGraphicsItem>
 #include <QElapsedTimer>
 
-#include <iostream>
+#include <algorithm>
+#include <cmath>
 
 static constexpr qreal gridSize = 20;
 
@@ -21,9 +22,13 @@ QRectF rectForPoint(const f2b::font::point& point)
 GlyphWidget::GlyphWidget(const f2b::font::glyph& glyph, f2b::font::margins margins, QGraphicsItem* parent) :
     QGraphicsWidget(parent),
     glyph_ { glyph },
-    margins_ { margins }
+    margins_ { margins },
+    affectedPixels_ { glyph.size() }
 {
     setFocusPolicy(Qt::ClickFocus);
+    // Paint only the exposed part of the grid
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    updatePixelsImage();
     setPreferredSize({ gridSize * static_cast<qreal>(glyph.size().width),
                        gridSize * static_cast<qreal>(glyph.size().height) });
 }
@@ -32,6 +37,10 @@ void GlyphWidget::load(const f2b::font::glyph &glyph, f2b::font::margins margins
 {
     glyph_ = glyph;
     margins_ = margins;
+    if (affectedPixels_.size() != glyph.size()) {
+        affectedPixels_ = BatchPixelChange { glyph.size() };
+    }
+    updatePixelsImage();
     setPreferredSize({ gridSize * static_cast<qreal>(glyph.size().width),
                        gridSize * static_cast<qreal>(glyph.size().height) });
     update();
@@ -54,11 +63,12 @@ void GlyphWidget::setPixel(f2b::font::point p, bool value)
 {
     if (glyph_.is_pixel_set(p) != value) {
         glyph_.set_pixel_set(p, value);
+        pixelsImage_.setPixel(static_cast<int>(p.x), static_cast<int>(p.y), value ? 1 : 0);
         affectedPixels_.add(p, value);
 
         if (!isDuringMouseMove_) {
             emit pixelsChanged(affectedPixels_);
-            affectedPixels_.changes.clear();
+            affectedPixels_.clear();
         }
     }
 }
@@ -69,16 +79,29 @@ void GlyphWidget::applyChange(const BatchPixelChange &change, BatchPixelChange::
     // Apply only if there are no affected pixels (no operation in progress)
     // - this is the initial call to redo() action.
     //
-    if (affectedPixels_.changes.size() == 0) {
+    if (affectedPixels_.isEmpty()) {
         change.apply(glyph_, changeType);
+        updatePixelsImage();
         update();
     }
 }
 
+void GlyphWidget::updatePixelsImage()
+{
+    auto size = f2b::font::qsize_with_size(glyph_.size());
+    if (pixelsImage_.size() != size) {
+        pixelsImage_ = QImage(size, QImage::Format_MonoLSB);
+        // Unset pixels are transparent, to show the background of margins and the active area
+        pixelsImage_.setColorTable({ qRgba(0, 0, 0, 0), qRgb(0, 0, 0) });
+    }
+    for (std::size_t y = 0; y < glyph_.size().height; ++y) {
+        pack_glyph_row(glyph_, y, pixelsImage_.scanLine(static_cast<int>(y)));
+    }
+}
+
 
 void GlyphWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    Q_UNUSED(option);
     Q_UNUSED(widget);
 
 //    QElapsedTimer timer;
@@ -91,27 +114,43 @@ void GlyphWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
                                    boundingRect().width(),
                                    (glyph_.size().height - margins_.top - margins_.bottom) * gridSize);
 
-    painter->fillRect(rect, Color::glyphMargin);
-    painter->fillRect(activeAreaRect, Qt::white);
+    // Glyph cells intersecting the exposed rect
+    auto exposedRect = option->exposedRect.intersected(rect);
+    auto firstCol = static_cast<int>(std::floor(exposedRect.left() / gridSize));
+    auto firstRow = static_cast<int>(std::floor(exposedRect.top() / gridSize));
+    auto endCol = std::min(static_cast<int>(std::ceil(exposedRect.right() / gridSize)),
+                           static_cast<int>(glyph_.size().width));
+    auto endRow = std::min(static_cast<int>(std::ceil(exposedRect.bottom() / gridSize)),
+                           static_cast<int>(glyph_.size().height));
+    QRect cells { QPoint(std::max(firstCol, 0), std::max(firstRow, 0)), QPoint(endCol - 1, endRow - 1) };
+    QRectF cellsRect { cells.x() * gridSize, cells.y() * gridSize, cells.width() * gridSize, cells.height() * gridSize };
+
+    if (!cells.isEmpty()) {
+        painter->fillRect(cellsRect, Color::glyphMargin);
+        painter->fillRect(cellsRect.intersected(activeAreaRect), Qt::white);
+    }
 
     painter->setPen(QPen(QBrush(Qt::darkGray), 0.5));
     painter->drawRect(rect);
 
-    for (std::size_t row = 0; row < glyph_.size().height; ++row) {
-        for (std::size_t col = 0; col < glyph_.size().width; ++col) {
-            f2b::font::point p { col, row };
-            if (glyph_.is_pixel_set(p)) {
-                painter->fillRect(rectForPoint(p), Qt::black);
-            }
+    if (!cells.isEmpty()) {
+        // Set pixels are drawn in one go, by scaling the glyph image up to the grid.
+        painter->save();
+        painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+        painter->drawImage(cellsRect, pixelsImage_, cells);
+        painter->restore();
+
+        QVector<QLineF> gridLines;
+        gridLines.reserve(cells.width() + cells.height() + 2);
+        for (auto col = cells.left(); col <= cells.right() + 1; ++col) {
+            gridLines.append(QLineF(col * gridSize, cellsRect.top(), col * gridSize, cellsRect.bottom()));
         }
+        for (auto row = cells.top(); row <= cells.bottom() + 1; ++row) {
+            gridLines.append(QLineF(cellsRect.left(), row * gridSize, cellsRect.right(), row * gridSize));
+        }
+        painter->drawLines(gridLines);
     }
 
-    for (qreal w = 0; w < rect.width(); w += gridSize) {
-        painter->drawLine(QLineF(QPointF(w, rect.top()), QPointF(w, rect.bottom())));
-    }
-    for (qreal h = 0; h < rect.height(); h += gridSize) {
-        painter->drawLine(QLineF(QPointF(rect.left(), h), QPointF(rect.right(), h)));
-    }
     if (focusedPixel_.has_value()) {
         painter->setPen(QPen(QBrush(Qt::red), 1));
         painter->drawRect(rectForPoint(focusedPixel_.value()));
@@ -197,7 +236,7 @@ void GlyphWidget::handleMousePress(QGraphicsSceneMouseEvent *event)
 
     penState_ = !event->modifiers().testFlag(Qt::AltModifier)
             && !event->modifiers().testFlag(Qt::ControlModifier);
-    affectedPixels_.changes.clear();
+    affectedPixels_.clear();
     isDuringMouseMove_ = true;
 
     setPixel(currentPixel, penState_);
@@ -214,9 +253,7 @@ void GlyphWidget::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
     auto updateMode = UpdateMode::UpdateFocus;
 
     // If item not visited or visited with a different state
-    if (affectedPixels_.changes.find(currentPixel) == affectedPixels_.changes.end() ||
-            affectedPixels_.changes[currentPixel] != penState_)
-    {
+    if (affectedPixels_.valueAt(currentPixel) != penState_) {
 //        qDebug() << "mouse move to new item" << currentPixel.x << currentPixel.y << penState_;
         updateMode = UpdateMode::UpdateFocusAndPixels;
 
@@ -264,13 +301,8 @@ void GlyphWidget::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
 
     isDuringMouseMove_ = false;
 
-    for (const auto& i : affectedPixels_.changes) {
-        std::cout << "((" << i.first.x << ", " << i.first.y << "), " << i.second << ") ";
-    }
-    std::cout << std::endl;
-
     emit pixelsChanged(affectedPixels_);
-    affectedPixels_.changes.clear();
+    affectedPixels_.clear();
 }
 
 f2b::font::point GlyphWidget::pointForEvent(QGraphicsSceneMouseEvent *event) const
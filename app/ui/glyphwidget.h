@@ -2,6 +2,7 @@
 #define RAWGLYPHWIDGET_H
 
 #include <QGraphicsWidget>
+#include <QImage>
 #include <f2b.h>
 #include <memory>
 #include <optional>
@@ -46,11 +47,14 @@ private:
 
     void togglePixel(f2b::font::point p);
     void setPixel(f2b::font::point p, bool value);
+    void updatePixelsImage();
 
     f2b::font::point pointForEvent(QGraphicsSceneMouseEvent *event) const;
 
     f2b::font::glyph glyph_;
     f2b::font::margins margins_;
+    // Glyph pixels (one image pixel per glyph pixel), scaled to the grid when painted
+    QImage pixelsImage_;
     BatchPixelChange affectedPixels_;
     std::optional<f2b::font::point> focusedPixel_ {};
 
@@ -0,0 +1,170 @@
+#ifndef RANKSELECTINDEX_H
+#define RANKSELECTINDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief A bit vector answering rank (number of set bits before a position)
+ *        and select (position of the n-th set bit) queries.
+ *
+ * Bits are grouped into blocks of \c blockWords words, each storing the number
+ * of set bits preceding it, so rank takes constant time. Select additionally
+ * samples the block of every \c selectSample -th set bit and binary searches
+ * the blocks between two samples, which takes time logarithmic in the number
+ * of those blocks (small unless set bits are sparse).
+ * Setting a bit updates the counts of the following blocks.
+ */
+class RankSelectIndex
+{
+public:
+    using word_type = std::uint64_t;
+    static constexpr std::size_t wordBits = 64;
+    static constexpr std::size_t blockWords = 8;
+    static constexpr std::size_t blockBits = blockWords * wordBits;
+    static constexpr std::size_t selectSample = 512;
+
+    RankSelectIndex() = default;
+
+    /// Creates an index of \c size bits, with bits at \c ones positions set.
+    RankSelectIndex(std::size_t size, const std::set<std::size_t>& ones) {
+        assign(size, ones);
+    }
+
+    void assign(std::size_t size, const std::set<std::size_t>& ones) {
+        size_ = size;
+        words_.assign((size + blockBits - 1) / blockBits * blockWords, 0);
+        for (auto i : ones) {
+            if (i >= size) {
+                break;
+            }
+            words_[i / wordBits] |= word_type { 1 } << (i % wordBits);
+        }
+        updateCounts();
+    }
+
+    std::size_t size() const noexcept { return size_; }
+
+    /// Number of set bits.
+    std::size_t count() const noexcept { return count_; }
+
+    bool test(std::size_t i) const {
+        checkIndex(i);
+        return (words_[i / wordBits] >> (i % wordBits)) & 1u;
+    }
+
+    void set(std::size_t i, bool value) {
+        if (test(i) == value) {
+            return;
+        }
+        words_[i / wordBits] ^= word_type { 1 } << (i % wordBits);
+        for (auto block = i / blockBits + 1; block < blockRanks_.size(); ++block) {
+            blockRanks_[block] = value ? blockRanks_[block] + 1 : blockRanks_[block] - 1;
+        }
+        count_ = value ? count_ + 1 : count_ - 1;
+        updateSamples();
+    }
+
+    /// Number of set bits at positions lower than \c i (\c i may equal size).
+    std::size_t rank(std::size_t i) const {
+        if (i > size_) {
+            throw std::out_of_range { "Rank position out of range" };
+        }
+        if (i == size_) {
+            return count_;
+        }
+        auto block = i / blockBits;
+        auto rank = blockRanks_[block];
+        auto word = i / wordBits;
+        for (auto w = block * blockWords; w < word; ++w) {
+            rank += popcount(words_[w]);
+        }
+        auto offset = i % wordBits;
+        if (offset > 0) {
+            rank += popcount(words_[word] & ((word_type { 1 } << offset) - 1));
+        }
+        return rank;
+    }
+
+    /// Position of the set bit with rank \c n (i.e. the (n+1)-th set bit).
+    std::size_t select(std::size_t n) const {
+        if (n >= count_) {
+            throw std::out_of_range { "Select rank out of range" };
+        }
+
+        // The last block with fewer than n+1 set bits before it
+        auto sample = n / selectSample;
+        auto first = blockRanks_.begin() + static_cast<std::ptrdiff_t>(samples_[sample]);
+        auto last = sample + 1 < samples_.size()
+                ? blockRanks_.begin() + static_cast<std::ptrdiff_t>(samples_[sample + 1] + 1)
+                : blockRanks_.end();
+        auto block = static_cast<std::size_t>(std::upper_bound(first, last, n) - blockRanks_.begin()) - 1;
+
+        auto remaining = n - blockRanks_[block];
+        auto w = block * blockWords;
+        for (auto bits = popcount(words_[w]); bits <= remaining; bits = popcount(words_[w])) {
+            remaining -= bits;
+            ++w;
+        }
+
+        auto word = words_[w];
+        for (; remaining > 0; --remaining) {
+            word &= word - 1;
+        }
+        std::size_t bit = 0;
+        while (((word >> bit) & 1u) == 0) {
+            ++bit;
+        }
+        return w * wordBits + bit;
+    }
+
+private:
+    static std::size_t popcount(word_type w) noexcept {
+        w = w - ((w >> 1) & 0x5555555555555555ull);
+        w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+        w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return static_cast<std::size_t>((w * 0x0101010101010101ull) >> 56);
+    }
+
+    void checkIndex(std::size_t i) const {
+        if (i >= size_) {
+            throw std::out_of_range { "Bit index out of range" };
+        }
+    }
+
+    void updateCounts() {
+        blockRanks_.resize(words_.size() / blockWords);
+        count_ = 0;
+        for (std::size_t block = 0; block < blockRanks_.size(); ++block) {
+            blockRanks_[block] = count_;
+            for (std::size_t w = block * blockWords; w < (block + 1) * blockWords; ++w) {
+                count_ += popcount(words_[w]);
+            }
+        }
+        updateSamples();
+    }
+
+    void updateSamples() {
+        samples_.clear();
+        for (std::size_t block = 0; block < blockRanks_.size(); ++block) {
+            auto end = block + 1 < blockRanks_.size() ? blockRanks_[block + 1] : count_;
+            // Blocks containing set bits of ranks that are multiples of selectSample
+            while (samples_.size() * selectSample < end) {
+                samples_.push_back(block);
+            }
+        }
+    }
+
+    std::vector<word_type> words_;
+    // Number of set bits before each block
+    std::vector<std::size_t> blockRanks_;
+    // Block index of every selectSample-th set bit
+    std::vector<std::size_t> samples_;
+    std::size_t size_ { 0 };
+    std::size_t count_ { 0 };
+};
+
+#endif // RANKSELECTINDEX_H
@@ -0,0 +1,232 @@
+#include "sourcecodeview.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+static constexpr int textMargin = 4;
+
+SourceCodeView::SourceCodeView(QWidget *parent) :
+    QAbstractScrollArea(parent)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
+    updateScrollBars();
+}
+
+void SourceCodeView::setPlainText(const QString &text)
+{
+    auto change = rope_.update(text);
+    if (change.isEmpty()) {
+        return;
+    }
+
+    // Keep the same lines at the top when lines were added or removed above them
+    auto topLine = verticalScrollBar()->value();
+    if (change.first + change.count <= topLine) {
+        topLine += change.newCount - change.count;
+    }
+
+    if (selection_.has_value()) {
+        if (rope_.lineCount() == 0) {
+            selection_ = {};
+        } else {
+            selection_->anchor = std::min(selection_->anchor, rope_.lineCount() - 1);
+            selection_->current = std::min(selection_->current, rope_.lineCount() - 1);
+        }
+    }
+
+    updateScrollBars();
+    verticalScrollBar()->setValue(topLine);
+    viewport()->update();
+}
+
+QString SourceCodeView::selectedText() const
+{
+    if (!selection_.has_value()) {
+        return {};
+    }
+
+    QString text;
+    for (auto line = selection_->first(); line <= selection_->last(); ++line) {
+        text += rope_.line(line);
+        text += QLatin1Char('\n');
+    }
+    return text;
+}
+
+void SourceCodeView::copy()
+{
+    if (selection_.has_value()) {
+        QApplication::clipboard()->setText(selectedText());
+    }
+}
+
+void SourceCodeView::selectAll()
+{
+    if (rope_.lineCount() > 0) {
+        selection_ = Selection { 0, rope_.lineCount() - 1 };
+        viewport()->update();
+    }
+}
+
+void SourceCodeView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+    painter.setFont(font());
+
+    auto lineHeight = fontMetrics().lineSpacing();
+    auto ascent = fontMetrics().ascent();
+    auto x = textMargin - horizontalScrollBar()->value();
+    auto top = verticalScrollBar()->value();
+
+    // Only lines intersecting the exposed rect
+    auto first = std::max(0, (event->rect().top() - textMargin) / lineHeight);
+    auto last = std::min(rope_.lineCount() - 1 - top, (event->rect().bottom() - textMargin) / lineHeight);
+
+    for (auto row = first; row <= last; ++row) {
+        auto line = top + row;
+        auto y = textMargin + row * lineHeight;
+        auto isSelected = selection_.has_value() && line >= selection_->first() && line <= selection_->last();
+        if (isSelected) {
+            painter.fillRect(0, y, viewport()->width(), lineHeight, palette().highlight());
+            painter.setPen(palette().highlightedText().color());
+        } else {
+            painter.setPen(palette().text().color());
+        }
+        painter.drawText(x, y + ascent, expandedLine(line));
+    }
+}
+
+void SourceCodeView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void SourceCodeView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        updateScrollBars();
+        viewport()->update();
+    }
+}
+
+void SourceCodeView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy)) {
+        copy();
+    } else if (event->matches(QKeySequence::SelectAll)) {
+        selectAll();
+    } else if (event->matches(QKeySequence::MoveToStartOfDocument)) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMinimum);
+    } else if (event->matches(QKeySequence::MoveToEndOfDocument)) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
+    } else {
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void SourceCodeView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) {
+        return;
+    }
+
+    auto line = lineAt(event->pos());
+    if (line < 0) {
+        selection_ = {};
+    } else if (event->modifiers().testFlag(Qt::ShiftModifier) && selection_.has_value()) {
+        selection_->current = line;
+    } else {
+        selection_ = Selection { line, line };
+    }
+    viewport()->update();
+}
+
+void SourceCodeView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!event->buttons().testFlag(Qt::LeftButton) || !selection_.has_value()) {
+        return;
+    }
+
+    // Scroll when dragging past the top or bottom edge
+    if (event->pos().y() < 0) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+    } else if (event->pos().y() > viewport()->height()) {
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+    }
+
+    auto line = lineAt(event->pos());
+    if (line >= 0 && line != selection_->current) {
+        selection_->current = line;
+        viewport()->update();
+    }
+}
+
+void SourceCodeView::contextMenuEvent(QContextMenuEvent *event)
+{
+    QMenu menu;
+    auto copyAction = menu.addAction(tr("&Copy"), this, &SourceCodeView::copy);
+    copyAction->setEnabled(selection_.has_value());
+    menu.addSeparator();
+    menu.addAction(tr("Select All"), this, &SourceCodeView::selectAll);
+    menu.exec(event->globalPos());
+}
+
+void SourceCodeView::updateScrollBars()
+{
+    auto visibleLines = visibleLineCount();
+    verticalScrollBar()->setSingleStep(1);
+    verticalScrollBar()->setPageStep(visibleLines);
+    verticalScrollBar()->setRange(0, std::max(0, rope_.lineCount() - visibleLines));
+
+    auto charWidth = fontMetrics().averageCharWidth();
+    auto contentWidth = rope_.maxLineWidth() * charWidth + 2 * textMargin;
+    horizontalScrollBar()->setSingleStep(charWidth);
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, std::max(0, contentWidth - viewport()->width()));
+}
+
+int SourceCodeView::lineAt(QPoint pos) const
+{
+    if (rope_.lineCount() == 0) {
+        return -1;
+    }
+    auto row = (pos.y() - textMargin) / fontMetrics().lineSpacing();
+    if (pos.y() < textMargin) {
+        row = -1;
+    }
+    return std::clamp(verticalScrollBar()->value() + row, 0, rope_.lineCount() - 1);
+}
+
+int SourceCodeView::visibleLineCount() const
+{
+    return std::max(1, (viewport()->height() - textMargin) / fontMetrics().lineSpacing());
+}
+
+QString SourceCodeView::expandedLine(int index) const
+{
+    auto line = rope_.line(index);
+    if (!line.contains(QLatin1Char('\t'))) {
+        return line;
+    }
+
+    QString expanded;
+    expanded.reserve(TextRope::lineWidth(line));
+    for (auto c : line) {
+        if (c == QLatin1Char('\t')) {
+            expanded += QString(TextRope::tabWidth - expanded.size() % TextRope::tabWidth, QLatin1Char(' '));
+        } else {
+            expanded += c;
+        }
+    }
+    return expanded;
+}
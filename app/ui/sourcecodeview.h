@@ -0,0 +1,61 @@
+#ifndef SOURCECODEVIEW_H
+#define SOURCECODEVIEW_H
+
+#include <QAbstractScrollArea>
+#include "textrope.h"
+
+#include <algorithm>
+#include <optional>
+
+/**
+ * @brief A read-only view of generated source code.
+ *
+ * The text is kept in a \c TextRope and only lines in the visible area are
+ * drawn, so that showing and updating large files doesn't depend on their size.
+ * Setting new text keeps the scroll position. Whole lines can be selected
+ * with the mouse and copied.
+ */
+class SourceCodeView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit SourceCodeView(QWidget *parent = nullptr);
+
+    void setPlainText(const QString& text);
+    QString toPlainText() const { return rope_.text(); }
+
+    QString selectedText() const;
+
+public slots:
+    void copy();
+    void selectAll();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+
+private:
+    struct Selection {
+        int anchor;
+        int current;
+
+        int first() const { return std::min(anchor, current); }
+        int last() const { return std::max(anchor, current); }
+    };
+
+    void updateScrollBars();
+    int lineAt(QPoint pos) const;
+    int visibleLineCount() const;
+    QString expandedLine(int index) const;
+
+    TextRope rope_;
+    std::optional<Selection> selection_;
+};
+
+#endif // SOURCECODEVIEW_H
@@ -0,0 +1,146 @@
+#include "textrope.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+TextRope::Change TextRope::update(const QString &text)
+{
+    // Chunks matching the beginning of the text, ending with a line break
+    // (unless the text ends there too), so that they end with a whole line
+    std::size_t prefix = 0;
+    int begin = 0;
+    while (prefix < chunks_.size() && matches(chunks_[prefix], text, begin)) {
+        const auto& chunkText = chunks_[prefix].text;
+        auto chunkEnd = begin + chunkText.size();
+        if (!chunkText.endsWith(QLatin1Char('\n')) && chunkEnd != text.size()) {
+            break;
+        }
+        begin = chunkEnd;
+        ++prefix;
+    }
+
+    if (prefix == chunks_.size() && begin == text.size()) {
+        return {};
+    }
+
+    // Chunks matching the end of the text, starting after a line break
+    std::size_t suffix = 0;
+    int end = text.size();
+    while (prefix + suffix < chunks_.size()) {
+        const auto& chunk = chunks_[chunks_.size() - 1 - suffix];
+        auto start = end - chunk.text.size();
+        if (start < begin || (start > begin && text.at(start - 1) != QLatin1Char('\n'))
+                || !matches(chunk, text, start)) {
+            break;
+        }
+        end = start;
+        ++suffix;
+    }
+
+    Change change;
+    change.first = prefix < firstLines_.size() ? firstLines_[prefix] : lineCount_;
+    auto replacedEnd = chunks_.size() - suffix;
+    for (auto i = prefix; i < replacedEnd; ++i) {
+        change.count += static_cast<int>(chunks_[i].lineStarts.size());
+    }
+
+    std::vector<Chunk> chunks;
+    appendChunks(chunks, text, begin, end);
+    for (const auto& chunk : chunks) {
+        change.newCount += static_cast<int>(chunk.lineStarts.size());
+    }
+
+    auto first = chunks_.begin() + static_cast<std::ptrdiff_t>(prefix);
+    auto last = chunks_.begin() + static_cast<std::ptrdiff_t>(replacedEnd);
+    auto position = chunks_.erase(first, last);
+    chunks_.insert(position, std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+
+    updateLineCounts();
+    return change;
+}
+
+QString TextRope::line(int index) const
+{
+    if (index < 0 || index >= lineCount_) {
+        throw std::out_of_range { "Line index out of range" };
+    }
+
+    // The last chunk starting at or before the line
+    auto i = std::upper_bound(firstLines_.begin(), firstLines_.end(), index) - 1;
+    auto chunk = static_cast<std::size_t>(i - firstLines_.begin());
+    return chunkLine(chunks_[chunk], static_cast<std::size_t>(index - *i));
+}
+
+QString TextRope::text() const
+{
+    QString text;
+    for (const auto& chunk : chunks_) {
+        text += chunk.text;
+    }
+    return text;
+}
+
+int TextRope::lineWidth(const QString &line)
+{
+    int width = 0;
+    for (auto c : line) {
+        width = c == QLatin1Char('\t') ? (width / tabWidth + 1) * tabWidth : width + 1;
+    }
+    return width;
+}
+
+bool TextRope::matches(const Chunk &chunk, const QString &text, int position)
+{
+    auto size = chunk.text.size();
+    if (position < 0 || position + size > text.size()) {
+        return false;
+    }
+    return std::memcmp(chunk.text.constData(), text.constData() + position,
+                       static_cast<std::size_t>(size) * sizeof(QChar)) == 0;
+}
+
+void TextRope::appendChunks(std::vector<Chunk> &chunks, const QString &text, int begin, int end)
+{
+    Chunk chunk;
+    auto chunkStart = begin;
+    auto lineStart = begin;
+    while (lineStart < end) {
+        auto newline = text.indexOf(QLatin1Char('\n'), lineStart);
+        auto lineEnd = newline < 0 || newline >= end ? end : newline + 1;
+        chunk.lineStarts.push_back(lineStart - chunkStart);
+        lineStart = lineEnd;
+
+        if (chunk.lineStarts.size() == static_cast<std::size_t>(linesPerChunk) || lineStart == end) {
+            chunk.text = text.mid(chunkStart, lineStart - chunkStart);
+            for (std::size_t i = 0; i < chunk.lineStarts.size(); ++i) {
+                chunk.maxLineWidth = std::max(chunk.maxLineWidth, lineWidth(chunkLine(chunk, i)));
+            }
+            chunks.push_back(std::move(chunk));
+            chunk = Chunk {};
+            chunkStart = lineStart;
+        }
+    }
+}
+
+QString TextRope::chunkLine(const Chunk &chunk, std::size_t line)
+{
+    auto start = chunk.lineStarts[line];
+    auto end = line + 1 < chunk.lineStarts.size() ? chunk.lineStarts[line + 1] : chunk.text.size();
+    if (end > start && chunk.text.at(end - 1) == QLatin1Char('\n')) {
+        --end;
+    }
+    return chunk.text.mid(start, end - start);
+}
+
+void TextRope::updateLineCounts()
+{
+    firstLines_.resize(chunks_.size());
+    lineCount_ = 0;
+    maxLineWidth_ = 0;
+    for (std::size_t i = 0; i < chunks_.size(); ++i) {
+        firstLines_[i] = lineCount_;
+        lineCount_ += static_cast<int>(chunks_[i].lineStarts.size());
+        maxLineWidth_ = std::max(maxLineWidth_, chunks_[i].maxLineWidth);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef TEXTROPE_H
+#define TEXTROPE_H
+
+#include <QString>
+#include <vector>
+
+/**
+ * @brief Multi-line text stored in chunks of whole lines.
+ *
+ * Lines are looked up by index through cumulative line counts of chunks.
+ * Replacing the text with \c update keeps chunks that match the beginning
+ * and the end of the new text, and splits only the text between them into
+ * new chunks, so that a change local to a few lines costs a comparison
+ * of the text rather than splitting all of it into lines again.
+ */
+class TextRope
+{
+public:
+    static constexpr int linesPerChunk = 256;
+    static constexpr int tabWidth = 4;
+
+    /// Lines replaced by \c update: \c count lines starting at \c first were replaced by \c newCount lines.
+    struct Change {
+        int first { 0 };
+        int count { 0 };
+        int newCount { 0 };
+
+        bool isEmpty() const noexcept { return count == 0 && newCount == 0; }
+    };
+
+    TextRope() = default;
+    explicit TextRope(const QString& text) { update(text); }
+
+    /// Replaces the text with \c text, reusing chunks that didn't change.
+    Change update(const QString& text);
+
+    int lineCount() const noexcept { return lineCount_; }
+    std::size_t chunkCount() const noexcept { return chunks_.size(); }
+
+    /// Width of the longest line in columns, with tabs advancing to multiples of \c tabWidth.
+    int maxLineWidth() const noexcept { return maxLineWidth_; }
+
+    /// Line at \c index (without the line break).
+    QString line(int index) const;
+
+    /// Width of \c line in columns, with tabs expanded.
+    static int lineWidth(const QString& line);
+
+    QString text() const;
+
+private:
+    struct Chunk {
+        QString text;
+        // Offsets of lines in text
+        std::vector<int> lineStarts;
+        int maxLineWidth { 0 };
+    };
+
+    static bool matches(const Chunk& chunk, const QString& text, int position);
+    static void appendChunks(std::vector<Chunk>& chunks, const QString& text, int begin, int end);
+    static QString chunkLine(const Chunk& chunk, std::size_t line);
+    void updateLineCounts();
+
+    std::vector<Chunk> chunks_;
+    // Index of the first line of every chunk
+    std::vector<int> firstLines_;
+    int lineCount_ { 0 };
+    int maxLineWidth_ { 0 };
+};
+
+#endif // TEXTROPE_H
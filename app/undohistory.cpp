@@ -0,0 +1,172 @@
+#include "undohistory.h"
+#include "command.h"
+
+#include <QAction>
+#include <QDebug>
+
+UndoHistory::UndoHistory(std::size_t memoryBudget, QObject *parent) :
+    QObject(parent),
+    memoryBudget_ { memoryBudget }
+{
+}
+
+UndoHistory::~UndoHistory() = default;
+
+void UndoHistory::push(UndoCommand *command)
+{
+    std::unique_ptr<UndoCommand> c { command };
+    c->redo();
+
+    for (auto i = commands_.begin() + static_cast<std::ptrdiff_t>(index_); i != commands_.end(); ++i) {
+        memoryUsage_ -= (*i)->memoryUsage();
+    }
+    commands_.erase(commands_.begin() + static_cast<std::ptrdiff_t>(index_), commands_.end());
+
+    auto top = commands_.empty() ? nullptr : commands_.back().get();
+    auto topMemoryUsage = top ? top->memoryUsage() : 0;
+    if (top && c->id() != -1 && top->id() == c->id() && top->mergeWith(c.get())) {
+        memoryUsage_ = memoryUsage_ - topMemoryUsage + top->memoryUsage();
+    } else {
+        memoryUsage_ += c->memoryUsage();
+        commands_.push_back(std::move(c));
+        index_ = commands_.size();
+    }
+
+    keepWithinBudget();
+    emit changed();
+}
+
+void UndoHistory::clear()
+{
+    commands_.clear();
+    index_ = 0;
+    memoryUsage_ = 0;
+    emit changed();
+}
+
+QString UndoHistory::undoText() const
+{
+    return canUndo() ? commands_[index_ - 1]->text() : QString();
+}
+
+QString UndoHistory::redoText() const
+{
+    return canRedo() ? commands_[index_]->text() : QString();
+}
+
+void UndoHistory::setMemoryBudget(std::size_t budget)
+{
+    memoryBudget_ = budget;
+    keepWithinBudget();
+    emit changed();
+}
+
+QAction* UndoHistory::createUndoAction(QObject *parent)
+{
+    auto action = new QAction(parent);
+    auto update = [this, action] {
+        action->setEnabled(canUndo());
+        action->setText(canUndo() ? tr("&Undo %1").arg(undoText()) : tr("&Undo"));
+    };
+    update();
+    connect(this, &UndoHistory::changed, action, update);
+    connect(action, &QAction::triggered, this, &UndoHistory::undo);
+    return action;
+}
+
+QAction* UndoHistory::createRedoAction(QObject *parent)
+{
+    auto action = new QAction(parent);
+    auto update = [this, action] {
+        action->setEnabled(canRedo());
+        action->setText(canRedo() ? tr("&Redo %1").arg(redoText()) : tr("&Redo"));
+    };
+    update();
+    connect(this, &UndoHistory::changed, action, update);
+    connect(action, &QAction::triggered, this, &UndoHistory::redo);
+    return action;
+}
+
+void UndoHistory::undo()
+{
+    if (!canUndo()) {
+        return;
+    }
+    --index_;
+    commands_[index_]->undo();
+    emit changed();
+}
+
+void UndoHistory::redo()
+{
+    if (!canRedo()) {
+        return;
+    }
+    commands_[index_]->redo();
+    ++index_;
+    emit changed();
+}
+
+void UndoHistory::keepWithinBudget()
+{
+    if (memoryUsage_ <= memoryBudget_) {
+        return;
+    }
+
+    // Recent commands are kept as they are, so that they can still be undone one by one.
+    coalesce(index_ / 2);
+
+    // The most recently pushed command is kept even if it doesn't fit into the budget.
+    std::size_t dropped = 0;
+    while (memoryUsage_ > memoryBudget_ && index_ > 1) {
+        memoryUsage_ -= commands_[dropped]->memoryUsage();
+        ++dropped;
+        --index_;
+    }
+    commands_.erase(commands_.begin(), commands_.begin() + static_cast<std::ptrdiff_t>(dropped));
+
+    // Then commands that were undone, most distant first.
+    while (memoryUsage_ > memoryBudget_ && commands_.size() > index_) {
+        memoryUsage_ -= commands_.back()->memoryUsage();
+        commands_.pop_back();
+    }
+
+    if (dropped > 0) {
+        qDebug() << "undo history: dropped" << dropped << "oldest commands," << memoryUsage_ << "bytes used";
+    }
+}
+
+void UndoHistory::coalesce(std::size_t end)
+{
+    if (end < 2) {
+        return;
+    }
+
+    // Commands in [0, end) have been executed, so combining them doesn't change
+    // the state they restore when undone as a whole.
+    std::vector<std::unique_ptr<UndoCommand>> coalesced;
+    coalesced.reserve(commands_.size());
+    for (std::size_t i = 0; i < end; ++i) {
+        if (!coalesced.empty() && commands_[i]->coalesceWith(coalesced.back().get())) {
+            coalesced.back() = std::move(commands_[i]);
+        } else {
+            coalesced.push_back(std::move(commands_[i]));
+        }
+    }
+
+    auto numCoalesced = end - coalesced.size();
+    for (std::size_t i = end; i < commands_.size(); ++i) {
+        coalesced.push_back(std::move(commands_[i]));
+    }
+    commands_ = std::move(coalesced);
+    index_ -= numCoalesced;
+    updateMemoryUsage();
+}
+
+void UndoHistory::updateMemoryUsage()
+{
+    memoryUsage_ = 0;
+    for (const auto& command : commands_) {
+        memoryUsage_ += command->memoryUsage();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class QAction;
+class UndoCommand;
+
+/**
+ * @brief A stack of undoable commands kept within a memory budget.
+ *
+ * Works like \c QUndoStack, but once commands hold more memory than the budget
+ * allows, the oldest half of the history is coalesced (adjacent commands that
+ * can be combined are merged into one), and if that's not enough,
+ * the oldest commands are dropped.
+ */
+class UndoHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr std::size_t defaultMemoryBudget = 16 * 1024 * 1024;
+
+    explicit UndoHistory(std::size_t memoryBudget = defaultMemoryBudget, QObject *parent = nullptr);
+    ~UndoHistory() override;
+
+    /**
+     * Takes ownership of \c command and executes it (by calling \c redo).
+     * Commands that can be undone after the current one are dropped.
+     */
+    void push(UndoCommand *command);
+    void clear();
+
+    bool canUndo() const noexcept { return index_ > 0; }
+    bool canRedo() const noexcept { return index_ < commands_.size(); }
+    QString undoText() const;
+    QString redoText() const;
+
+    /// Number of commands in the history (both undoable and redoable).
+    std::size_t count() const noexcept { return commands_.size(); }
+
+    /// Memory held by commands, in bytes.
+    std::size_t memoryUsage() const noexcept { return memoryUsage_; }
+
+    std::size_t memoryBudget() const noexcept { return memoryBudget_; }
+    void setMemoryBudget(std::size_t budget);
+
+    QAction* createUndoAction(QObject *parent);
+    QAction* createRedoAction(QObject *parent);
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    /// Emitted whenever commands are pushed, undone, redone or dropped.
+    void changed();
+
+private:
+    void keepWithinBudget();
+    void coalesce(std::size_t end);
+    void updateMemoryUsage();
+
+    std::vector<std::unique_ptr<UndoCommand>> commands_;
+    // Index of the command that would be redone next
+    std::size_t index_ { 0 };
+    std::size_t memoryBudget_;
+    std::size_t memoryUsage_ { 0 };
+};
+
+#endif // UNDOHISTORY_H
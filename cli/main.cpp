@@ -0,0 +1,307 @@
+#include "batchimport.h"
+#include "documentconverter.h"
+#include "glyphrastercache.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <functional>
+#include <limits>
+#include <optional>
+
+namespace Option {
+static const QCommandLineOption target(QStringList { "t", "target" },
+    "Generates source code in a given format (c, arduino, python-list or python-bytes), "
+    "optionally to a given file, e.g. c={name}_font.h. {name} is replaced with the document "
+    "base name. May be repeated. Defaults to c.", "format[=file]");
+static const QCommandLineOption outputDirectory(QStringList { "o", "output-dir" },
+    "Resolves relative output file paths against <dir> (current directory by default).", "dir");
+static const QCommandLineOption fontName(QStringList { "n", "font-name" },
+    "Names the font array <name> ({name} is replaced with the document base name).", "name", "font");
+static const QCommandLineOption exportAll("export-all",
+    "Exports all glyphs instead of only the ones marked as exported.");
+static const QCommandLineOption msb("msb", "Uses MSB bit numbering.");
+static const QCommandLineOption invertBits("invert-bits", "Inverts all bits.");
+static const QCommandLineOption includeLineSpacing("include-line-spacing",
+    "Includes line spacing (empty rows at the top and bottom of glyphs).");
+static const QCommandLineOption indentation("indent",
+    "Indents with a tab or a given number of spaces (tab by default).", "tab|spaces", "tab");
+static const QCommandLineOption wrapColumn("wrap-column",
+    "Wraps array rows at <column> (80 by default).", "column", "80");
+static const QCommandLineOption jobs(QStringList { "j", "jobs" },
+    "Converts up to <n> documents in parallel (the number of cores by default).", "n");
+static const QCommandLineOption threads("threads",
+    "Formats glyphs of each large document on <n> threads (1 by default, 0 for the number of cores).", "n", "1");
+static const QCommandLineOption importFamily("import-family",
+    "Imports a font family instead of converting documents. May be repeated.", "family");
+static const QCommandLineOption importSize("import-size",
+    "Imports font variants of a given point size, e.g. 8 or 8,10,12. May be repeated.", "sizes");
+static const QCommandLineOption importStyle("import-style",
+    "Imports font variants of a given style (regular, bold, italic or bold-italic). "
+    "May be repeated. Defaults to regular.", "style");
+static const QCommandLineOption importCharacters("import-characters",
+    "Imports only the given characters (printable ASCII by default).", "characters");
+static const QCommandLineOption importEngine("import-engine",
+    "Rasterizes imported glyphs with a given engine: text-document (the default) "
+    "or direct (faster, drawing every character with QPainter).", "engine", "text-document");
+static const QCommandLineOption noDocuments("no-documents",
+    "Doesn't save a .fontedit document for imported font variants.");
+static const QCommandLineOption quiet(QStringList { "q", "quiet" }, "Only reports errors.");
+}
+
+class ConversionRunnable : public QRunnable
+{
+public:
+    explicit ConversionRunnable(std::function<void()> f) : f_ { std::move(f) } {}
+    void run() override { f_(); }
+
+private:
+    std::function<void()> f_;
+};
+
+static std::optional<unsigned> parseUnsigned(const QString& value)
+{
+    bool ok;
+    auto number = value.toUInt(&ok);
+    return ok ? std::optional<unsigned> { number } : std::nullopt;
+}
+
+static int importFonts(const QCommandLineParser& parser, BatchImportOptions options,
+                       QTextStream& out, QTextStream& err)
+{
+    std::vector<int> pointSizes;
+    for (const auto& value : parser.values(Option::importSize)) {
+        for (const auto& part : value.split(',')) {
+            auto pointSize = parseUnsigned(part.trimmed());
+            if (!pointSize.has_value() || pointSize.value() == 0) {
+                err << "Invalid point size: " << part << '\n';
+                return 2;
+            }
+            pointSizes.push_back(static_cast<int>(pointSize.value()));
+        }
+    }
+    if (pointSizes.empty()) {
+        err << "No point size given, use --import-size\n";
+        return 2;
+    }
+
+    std::vector<FontStyle> styles;
+    for (const auto& value : parser.values(Option::importStyle)) {
+        auto style = fontStyleFromString(value);
+        if (!style.has_value()) {
+            err << "Invalid style: " << value << '\n';
+            return 2;
+        }
+        styles.push_back(style.value());
+    }
+    if (styles.empty()) {
+        styles.push_back(FontStyle::Regular);
+    }
+
+    auto engine = parser.value(Option::importEngine);
+    if (engine == "direct") {
+        options.renderingEngine = QFontFaceReader::engine::direct;
+    } else if (engine != "text-document") {
+        err << "Invalid engine: " << engine << '\n';
+        return 2;
+    }
+
+    options.writeDocuments = !parser.isSet(Option::noDocuments);
+    options.cache = &GlyphRasterCache::shared();
+
+    BatchImport batchImport { std::move(options) };
+    auto variants = BatchImport::variants(parser.values(Option::importFamily), pointSizes, styles,
+                                          parser.value(Option::importCharacters));
+    auto report = batchImport.run(variants);
+
+    int numFailed = 0;
+    for (const auto& result : report.results) {
+        if (result.error.has_value()) {
+            err << result.name << ": " << result.error.value() << '\n';
+            ++numFailed;
+            continue;
+        }
+        if (parser.isSet(Option::quiet)) {
+            continue;
+        }
+
+        out << result.name << ": " << result.numGlyphs << " glyphs, "
+            << "rasterize " << QString::number(result.rasterizeTime, 'f', 2) << " ms, "
+            << "write " << QString::number(result.writeTime, 'f', 2) << " ms\n";
+        for (const auto& file : result.files) {
+            out << "  -> " << file << '\n';
+        }
+    }
+
+    if (!parser.isSet(Option::quiet)) {
+        out << report.summary() << '\n';
+    }
+
+    out.flush();
+    err.flush();
+    return numFailed > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // Fonts are rasterized without a display.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fontedit-cli");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts FontEdit documents to source code, "
+                                     "or imports font variants in a batch (see --import-family).");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        Option::target, Option::outputDirectory, Option::fontName, Option::exportAll,
+        Option::msb, Option::invertBits, Option::includeLineSpacing, Option::indentation,
+        Option::wrapColumn, Option::jobs, Option::threads, Option::importFamily, Option::importSize,
+        Option::importStyle, Option::importCharacters, Option::importEngine, Option::noDocuments, Option::quiet
+    });
+    parser.addPositionalArgument("documents", "FontEdit documents (.fontedit) to convert.", "documents...");
+    parser.process(app);
+
+    auto fail = [&](const QString& message) {
+        err << message << '\n';
+        err.flush();
+        return 2;
+    };
+
+    auto isImporting = parser.isSet(Option::importFamily);
+    auto documents = parser.positionalArguments();
+    if (documents.isEmpty() && !isImporting) {
+        parser.showHelp(2);
+    }
+
+    // Imported fonts are only exported to source code if requested explicitly.
+    std::vector<ConversionTarget> targets;
+    auto targetValues = parser.values(Option::target);
+    if (targetValues.isEmpty() && !isImporting) {
+        targetValues << QString::fromStdString(std::string(f2b::format::c::identifier));
+    }
+    for (const auto& value : targetValues) {
+        auto separator = value.indexOf('=');
+        auto format = value.left(separator);
+        if (!DocumentConverter::formats().contains(format)) {
+            return fail(QString("Unknown format: %1").arg(format));
+        }
+        auto filePattern = separator < 0 ? DocumentConverter::defaultFilePattern(format) : value.mid(separator + 1);
+        targets.push_back({ format, filePattern });
+    }
+
+    f2b::source_code_options options;
+    options.export_method = parser.isSet(Option::exportAll)
+            ? f2b::source_code_options::export_all
+            : f2b::source_code_options::export_selected;
+    options.bit_numbering = parser.isSet(Option::msb)
+            ? f2b::source_code_options::msb
+            : f2b::source_code_options::lsb;
+    options.invert_bits = parser.isSet(Option::invertBits);
+    options.include_line_spacing = parser.isSet(Option::includeLineSpacing);
+
+    auto indentation = parser.value(Option::indentation);
+    if (indentation == "tab") {
+        options.indentation = f2b::source_code::tab {};
+    } else if (auto spaces = parseUnsigned(indentation)) {
+        options.indentation = f2b::source_code::space { spaces.value() };
+    } else {
+        return fail(QString("Invalid indentation: %1").arg(indentation));
+    }
+
+    auto wrapColumn = parseUnsigned(parser.value(Option::wrapColumn));
+    if (!wrapColumn.has_value() || wrapColumn.value() > std::numeric_limits<uint8_t>::max()) {
+        return fail(QString("Invalid wrap column: %1").arg(parser.value(Option::wrapColumn)));
+    }
+    options.wrap_column = static_cast<uint8_t>(wrapColumn.value());
+
+    auto threads = parseUnsigned(parser.value(Option::threads));
+    if (!threads.has_value()) {
+        return fail(QString("Invalid number of threads: %1").arg(parser.value(Option::threads)));
+    }
+    options.thread_count = threads.value();
+
+    auto jobs = parser.isSet(Option::jobs) ? parseUnsigned(parser.value(Option::jobs))
+                                           : std::optional<unsigned> { static_cast<unsigned>(qMax(1, QThread::idealThreadCount())) };
+    if (!jobs.has_value() || jobs.value() == 0) {
+        return fail(QString("Invalid number of jobs: %1").arg(parser.value(Option::jobs)));
+    }
+
+    QDir outputDirectory { parser.isSet(Option::outputDirectory) ? parser.value(Option::outputDirectory) : QDir::currentPath() };
+
+    if (isImporting) {
+        BatchImportOptions importOptions;
+        importOptions.outputDirectory = outputDirectory;
+        importOptions.sourceCodeTargets = std::move(targets);
+        importOptions.sourceCodeOptions = options;
+        importOptions.fontArrayName = parser.value(Option::fontName);
+        importOptions.threadCount = static_cast<int>(jobs.value());
+        return importFonts(parser, std::move(importOptions), out, err);
+    }
+
+    DocumentConverter converter { options, parser.value(Option::fontName), std::move(targets), outputDirectory };
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<ConversionResult> results(static_cast<std::size_t>(documents.size()));
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(static_cast<int>(jobs.value()));
+    for (int i = 0; i < documents.size(); ++i) {
+        auto r = new ConversionRunnable([&, i] {
+            results[static_cast<std::size_t>(i)] = converter.convert(documents[i]);
+        });
+        r->setAutoDelete(true);
+        threadPool.start(r);
+    }
+    threadPool.waitForDone();
+
+    auto wallTime = timer.nsecsElapsed() / 1e6;
+
+    int numFailed = 0;
+    qint64 totalSize = 0;
+    for (const auto& result : results) {
+        if (result.error.has_value()) {
+            err << result.documentPath << ": " << result.error.value() << '\n';
+            ++numFailed;
+            continue;
+        }
+
+        for (const auto& output : result.outputs) {
+            totalSize += output.size;
+        }
+        if (parser.isSet(Option::quiet)) {
+            continue;
+        }
+
+        out << result.documentPath << ": load " << QString::number(result.loadTime, 'f', 2) << " ms\n";
+        for (const auto& output : result.outputs) {
+            out << "  " << output.format << " -> " << output.filePath << " (" << output.size << " bytes): "
+                << "generate " << QString::number(output.generateTime, 'f', 2) << " ms, "
+                << "write " << QString::number(output.writeTime, 'f', 2) << " ms\n";
+        }
+    }
+
+    if (!parser.isSet(Option::quiet)) {
+        out << "Converted " << (documents.size() - numFailed) << " of " << documents.size() << " documents "
+            << "(" << totalSize << " bytes) in " << QString::number(wallTime, 'f', 2) << " ms "
+            << "using " << jobs.value() << " jobs\n";
+    }
+
+    out.flush();
+    err.flush();
+    return numFailed > 0 ? 1 : 0;
+}
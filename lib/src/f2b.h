@@ -4,6 +4,7 @@
 #include "fontdata.h"
 #include "fontsourcecodegenerator.h"
 #include "format.h"
+#include "outputsink.h"
 #include "sourcecode.h"
 
 #endif // F2B_PRIVATE_H
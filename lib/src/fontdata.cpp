@@ -7,87 +7,482 @@ namespace font {
 
 glyph::glyph(font::glyph_size sz) :
     size_ { sz },
-    pixels_ { std::vector<bool>(sz.width * sz.height, false) }
+    stride_ { words_per_row(sz.width) },
+    words_ ( stride_ * sz.height, 0 )
 {}
 
-glyph::glyph(font::glyph_size sz, std::vector<bool> pixels) :
-    size_ { sz },
-    pixels_ { std::move(pixels) }
+glyph::glyph(font::glyph_size sz, const std::vector<bool>& pixels) :
+    glyph(sz)
 {
-    if (pixels_.size() != sz.width * sz.height) {
+    if (pixels.size() != sz.width * sz.height) {
         throw std::logic_error { "pixels size must equal glyph size (width * height)" };
     }
+
+    auto pixel = pixels.begin();
+    for (std::size_t y = 0; y < sz.height; ++y) {
+        auto row = words_.data() + y * stride_;
+        for (std::size_t x = 0; x < sz.width; ++x, ++pixel) {
+            if (*pixel) {
+                row[x / word_bits] |= word_type { 1 } << (x % word_bits);
+            }
+        }
+    }
 }
 
 void glyph::clear()
 {
-    pixels_ = std::vector<bool>(size_.width * size_.height, false);
+    std::fill(words_.begin(), words_.end(), 0);
+}
+
+void glyph::set_row(std::size_t y, const word_type* row)
+{
+    auto dest = words_.data() + y * stride_;
+    std::copy(row, row + stride_, dest);
+
+    auto trailing_bits = size_.width % word_bits;
+    if (trailing_bits != 0) {
+        dest[stride_ - 1] &= (word_type { 1 } << trailing_bits) - 1;
+    }
+}
+
+bool glyph::is_row_empty(std::size_t y) const
+{
+    auto row = row_data(y);
+    return std::all_of(row, row + stride_, [](word_type w) { return w == 0; });
+}
+
+std::vector<bool> glyph::pixels() const
+{
+    std::vector<bool> pixels;
+    pixels.reserve(size_.width * size_.height);
+
+    for (std::size_t y = 0; y < size_.height; ++y) {
+        for (std::size_t x = 0; x < size_.width; ++x) {
+            pixels.push_back(is_pixel_set({ x, y }));
+        }
+    }
+    return pixels;
 }
 
 std::size_t glyph::top_margin() const
 {
-    auto first_set_pixel = std::find(pixels_.begin(), pixels_.end(), true);
-    return static_cast<std::size_t>(std::distance(pixels_.begin(), first_set_pixel)) / size_.width;
+    std::size_t y = 0;
+    while (y < size_.height && is_row_empty(y)) {
+        ++y;
+    }
+    return y;
 }
 
 std::size_t glyph::bottom_margin() const
 {
-    auto last_set_pixel = std::find(pixels_.rbegin(), pixels_.rend(), true);
-    return static_cast<std::size_t>(std::distance(pixels_.rbegin(), last_set_pixel)) / size_.width;
+    std::size_t margin = 0;
+    while (margin < size_.height && is_row_empty(size_.height - 1 - margin)) {
+        ++margin;
+    }
+    return margin;
 }
 
+std::vector<glyph::word_type> glyph::column_mask() const
+{
+    std::vector<word_type> mask(stride_, 0);
+    for (std::size_t y = 0; y < size_.height; ++y) {
+        auto row = row_data(y);
+        for (std::size_t i = 0; i < stride_; ++i) {
+            mask[i] |= row[i];
+        }
+    }
+    return mask;
+}
 
-face::face(const face_reader &data) :
-    face(data.font_size(), read_glyphs(data))
+std::size_t glyph::left_margin() const
 {
-    for (std::size_t i = 0; i < glyphs_.size(); i++) {
-        exported_glyph_ids_.insert(i);
+    auto mask = column_mask();
+    for (std::size_t i = 0; i < stride_; ++i) {
+        if (auto word = mask[i]) {
+            std::size_t bit = 0;
+            while ((word & 1u) == 0) {
+                word >>= 1;
+                ++bit;
+            }
+            return i * word_bits + bit;
+        }
     }
+    return size_.width;
 }
 
-face::face(font::glyph_size size, std::vector<glyph> glyphs, std::set<std::size_t> exported_glyph_ids) :
-    sz_ { size },
-    glyphs_ { std::move(glyphs) },
-    exported_glyph_ids_ { std::move(exported_glyph_ids) }
-{}
+std::size_t glyph::right_margin() const
+{
+    auto mask = column_mask();
+    for (std::size_t i = stride_; i > 0; --i) {
+        if (auto word = mask[i - 1]) {
+            std::size_t highest_bit = 0;
+            while (word >>= 1) {
+                ++highest_bit;
+            }
+            return size_.width - 1 - ((i - 1) * word_bits + highest_bit);
+        }
+    }
+    return size_.width;
+}
 
-std::vector<glyph> face::read_glyphs(const face_reader &data)
+glyph& glyph::operator|=(const glyph& other)
 {
-    std::vector<glyph> glyphs;
-    glyphs.reserve(data.num_glyphs());
+    auto height = std::min(size_.height, other.size_.height);
+    auto stride = std::min(stride_, other.stride_);
+    for (std::size_t y = 0; y < height; ++y) {
+        auto dest = words_.data() + y * stride_;
+        auto src = other.row_data(y);
+        for (std::size_t i = 0; i < stride; ++i) {
+            dest[i] |= src[i];
+        }
+    }
+    if (other.size_.width > size_.width && size_.width % word_bits != 0) {
+        auto mask = (word_type { 1 } << (size_.width % word_bits)) - 1;
+        for (std::size_t y = 0; y < size_.height; ++y) {
+            words_[y * stride_ + stride_ - 1] &= mask;
+        }
+    }
+    return *this;
+}
 
-    const std::vector<bool>::size_type pixels_per_glyph { data.font_size().width * data.font_size().height };
 
-    for (std::size_t i = 0; i < data.num_glyphs(); i++) {
+void face_reader::read_row(std::size_t glyph_id, std::size_t y, glyph::word_type* row) const
+{
+    auto width = font_size().width;
+    std::fill(row, row + glyph::words_per_row(width), 0);
+
+    for (std::size_t x = 0; x < width; ++x) {
+        if (is_pixel_set(glyph_id, { x, y })) {
+            row[x / glyph::word_bits] |= glyph::word_type { 1 } << (x % glyph::word_bits);
+        }
+    }
+}
+
+glyph face_reader::read_glyph(std::size_t glyph_id) const
+{
+    auto size = font_size();
+    glyph g { size };
+    std::vector<glyph::word_type> row(g.stride());
+
+    for (std::size_t y = 0; y < size.height; ++y) {
+        read_row(glyph_id, y, row.data());
+        g.set_row(y, row.data());
+    }
+
+    return g;
+}
 
-        std::vector<bool> pixels;
-        pixels.reserve(pixels_per_glyph);
 
-        for (std::size_t y = 0; y < data.font_size().height; y++) {
-            for (std::size_t x = 0; x < data.font_size().width; x++) {
-                point p { x, y };
-                pixels.push_back(data.is_pixel_set(i, p));
+code_point_map face_reader::code_points() const
+{
+    return code_point_map::contiguous(code_point_map::printable_ascii_offset, num_glyphs());
+}
+
+
+code_point_map::code_point_map(const std::vector<char32_t>& code_points)
+{
+    std::vector<std::pair<char32_t, std::size_t>> glyphs;
+    glyphs.reserve(code_points.size());
+    for (std::size_t i = 0; i < code_points.size(); ++i) {
+        glyphs.emplace_back(code_points[i], i);
+    }
+
+    // Stable sort keeps the first glyph of a repeated code point in front.
+    std::stable_sort(glyphs.begin(), glyphs.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    glyphs.erase(std::unique(glyphs.begin(), glyphs.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    }), glyphs.end());
+
+    for (const auto& [code_point, glyph_index] : glyphs) {
+        if (!ranges_.empty()
+                && ranges_.back().last_code_point() + 1 == code_point
+                && ranges_.back().last_glyph() + 1 == glyph_index) {
+            ++ranges_.back().length;
+        } else {
+            ranges_.push_back({ code_point, glyph_index, 1 });
+        }
+    }
+
+    update_glyph_order();
+}
+
+code_point_map code_point_map::contiguous(char32_t first_code_point, std::size_t num_glyphs)
+{
+    code_point_map map;
+    if (num_glyphs > 0) {
+        map.ranges_.push_back({ first_code_point, 0, num_glyphs });
+        map.update_glyph_order();
+    }
+    return map;
+}
+
+code_point_map code_point_map::from_ranges(std::vector<range> ranges)
+{
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const range& r) {
+        return r.length == 0;
+    }), ranges.end());
+    std::sort(ranges.begin(), ranges.end(), [](const range& lhs, const range& rhs) {
+        return lhs.first_code_point < rhs.first_code_point;
+    });
+
+    code_point_map map;
+    map.ranges_ = std::move(ranges);
+    map.update_glyph_order();
+
+    for (std::size_t i = 1; i < map.ranges_.size(); ++i) {
+        const auto& previous = map.ranges_[i - 1];
+        const auto& previous_by_glyph = map.ranges_[map.glyph_order_[i - 1]];
+        if (map.ranges_[i].first_code_point <= previous.last_code_point()
+                || map.ranges_[map.glyph_order_[i]].first_glyph <= previous_by_glyph.last_glyph()) {
+            throw std::invalid_argument { "Code point ranges overlap" };
+        }
+    }
+
+    return map;
+}
+
+std::optional<std::size_t> code_point_map::glyph_index(char32_t code_point) const noexcept
+{
+    auto i = std::upper_bound(ranges_.begin(), ranges_.end(), code_point, [](char32_t code_point, const range& r) {
+        return code_point < r.first_code_point;
+    });
+    if (i == ranges_.begin()) {
+        return {};
+    }
+    --i;
+    auto offset = static_cast<std::size_t>(code_point - i->first_code_point);
+    if (offset >= i->length) {
+        return {};
+    }
+    return i->first_glyph + offset;
+}
+
+std::optional<char32_t> code_point_map::code_point(std::size_t glyph_index) const noexcept
+{
+    auto i = std::upper_bound(glyph_order_.begin(), glyph_order_.end(), glyph_index, [&](std::size_t glyph_index, std::size_t r) {
+        return glyph_index < ranges_[r].first_glyph;
+    });
+    if (i == glyph_order_.begin()) {
+        return {};
+    }
+    const auto& r = ranges_[*std::prev(i)];
+    auto offset = glyph_index - r.first_glyph;
+    if (offset >= r.length) {
+        return {};
+    }
+    return r.first_code_point + static_cast<char32_t>(offset);
+}
+
+bool code_point_map::is_contiguous(char32_t first_code_point) const noexcept
+{
+    return ranges_.size() == 1
+            && ranges_.front().first_code_point == first_code_point
+            && ranges_.front().first_glyph == 0;
+}
+
+void code_point_map::append_glyph(std::size_t glyph_index)
+{
+    if (glyph_index == 0) {
+        if (ranges_.empty()) {
+            ranges_.push_back({ printable_ascii_offset, 0, 1 });
+            update_glyph_order();
+        }
+        return;
+    }
+
+    auto previous = code_point(glyph_index - 1);
+    if (!previous.has_value() || this->glyph_index(previous.value() + 1).has_value()) {
+        return;
+    }
+
+    // The previous glyph is the last one in its range, since it was the last glyph in a face.
+    auto r = std::find_if(ranges_.begin(), ranges_.end(), [&](const range& r) {
+        return r.last_code_point() == previous.value();
+    });
+    if (r != ranges_.end() && r->last_glyph() + 1 == glyph_index) {
+        ++r->length;
+    }
+}
+
+void code_point_map::remove_glyph(std::size_t glyph_index)
+{
+    std::vector<range> ranges;
+    ranges.reserve(ranges_.size() + 1);
+
+    for (const auto& r : ranges_) {
+        if (r.last_glyph() < glyph_index) {
+            ranges.push_back(r);
+        } else if (r.first_glyph > glyph_index) {
+            ranges.push_back({ r.first_code_point, r.first_glyph - 1, r.length });
+        } else {
+            // Split the range containing the glyph
+            auto offset = glyph_index - r.first_glyph;
+            if (offset > 0) {
+                ranges.push_back({ r.first_code_point, r.first_glyph, offset });
+            }
+            if (offset + 1 < r.length) {
+                ranges.push_back({ r.first_code_point + static_cast<char32_t>(offset) + 1, glyph_index, r.length - offset - 1 });
             }
         }
+    }
+
+    ranges_ = std::move(ranges);
+    update_glyph_order();
+}
 
-        glyph g { data.font_size(), pixels };
-        glyphs.push_back(g);
+void code_point_map::update_glyph_order()
+{
+    glyph_order_.resize(ranges_.size());
+    for (std::size_t i = 0; i < ranges_.size(); ++i) {
+        glyph_order_[i] = i;
     }
+    std::sort(glyph_order_.begin(), glyph_order_.end(), [&](std::size_t lhs, std::size_t rhs) {
+        return ranges_[lhs].first_glyph < ranges_[rhs].first_glyph;
+    });
+}
 
-    return glyphs;
+
+glyph_pages::glyph_pages(std::shared_ptr<const face_reader> reader, std::size_t glyphs_per_page) :
+    reader_ { std::move(reader) },
+    size_ { reader_->num_glyphs() },
+    glyphs_per_page_ { std::max<std::size_t>(glyphs_per_page, 1) },
+    pages_ ( (size_ + glyphs_per_page_ - 1) / glyphs_per_page_ )
+{
 }
 
-margins face::calculate_margins() const noexcept
+const glyph& glyph_pages::at(std::size_t index) const
 {
-    margins m {sz_.height, sz_.height};
+    if (index >= size_) {
+        throw std::out_of_range { "Glyph index out of range" };
+    }
+    return load_page(index / glyphs_per_page_).glyphs[index % glyphs_per_page_];
+}
 
-    std::for_each(glyphs_.begin(), glyphs_.end(), [&](const font::glyph& g) {
-        m.top = std::min(m.top, g.top_margin());
-        m.bottom = std::min(m.bottom, g.bottom_margin());
+const glyph_pages::page& glyph_pages::load_page(std::size_t page_index) const
+{
+    auto& p = pages_[page_index];
+    std::call_once(p.once, [&] {
+        auto first = page_index * glyphs_per_page_;
+        auto last = std::min(size_, first + glyphs_per_page_);
+        p.glyphs.reserve(last - first);
+        for (auto i = first; i < last; ++i) {
+            p.glyphs.push_back(reader_->read_glyph(i));
+        }
+        num_loaded_.fetch_add(last - first, std::memory_order_relaxed);
     });
+    return p;
+}
+
+void glyph_pages::load_all() const
+{
+    std::scoped_lock lock { load_all_mutex_ };
+    if (!reader_) {
+        return;
+    }
+    for (std::size_t i = 0; i < pages_.size(); ++i) {
+        load_page(i);
+    }
+    // Every page is loaded at this point, so nothing reads from the reader anymore.
+    reader_.reset();
+}
+
+face::face(const face_reader &data) :
+    face(data.font_size(), read_glyphs(data), {}, data.code_points())
+{
+    auto& exported_glyph_ids = *exported_glyph_ids_;
+    for (std::size_t i = 0; i < glyphs_->size(); i++) {
+        exported_glyph_ids.insert(exported_glyph_ids.end(), i);
+    }
+}
+
+face::face(font::glyph_size size, std::vector<glyph> glyphs, std::set<std::size_t> exported_glyph_ids,
+           std::optional<code_point_map> code_points) :
+    sz_ { size },
+    exported_glyph_ids_ { std::make_shared<std::set<std::size_t>>(std::move(exported_glyph_ids)) },
+    code_points_ { std::make_shared<code_point_map>(code_points.has_value()
+                                                    ? std::move(code_points.value())
+                                                    : code_point_map::contiguous(code_point_map::printable_ascii_offset, glyphs.size())) }
+{
+    glyphs_->reserve(glyphs.size());
+    for (auto& g : glyphs) {
+        glyphs_->push_back(std::make_shared<glyph>(std::move(g)));
+    }
+}
+
+std::size_t face::ascii_glyph_index(char ascii) const
+{
+    if (ascii < ' ') {
+        throw std::out_of_range { "Glyphs for 0-31 ASCII range are not supported" };
+    }
+    auto index = code_points_->glyph_index(static_cast<char32_t>(ascii));
+    if (!index.has_value()) {
+        throw std::out_of_range { "No glyph for a given character" };
+    }
+    return index.value();
+}
 
-    return m;
+face::face(std::shared_ptr<const face_reader> data, std::set<std::size_t> exported_glyph_ids,
+           std::size_t glyphs_per_page) :
+    sz_ { data->font_size() },
+    glyphs_ { std::make_shared<glyph_view::storage>(data->num_glyphs()) },
+    exported_glyph_ids_ { std::make_shared<std::set<std::size_t>>(std::move(exported_glyph_ids)) },
+    code_points_ { std::make_shared<code_point_map>(data->code_points()) },
+    pages_ { std::make_shared<glyph_pages>(std::move(data), glyphs_per_page) }
+{
+}
+
+std::vector<glyph> face::read_glyphs(const face_reader &data)
+{
+    std::vector<glyph> glyphs;
+    glyphs.reserve(data.num_glyphs());
+
+    for (std::size_t i = 0; i < data.num_glyphs(); i++) {
+        glyphs.push_back(data.read_glyph(i));
+    }
+
+    return glyphs;
+}
+
+const glyph& face::occupancy() const
+{
+    if (!occupancy_) {
+        auto g = std::make_shared<glyph>(sz_);
+        for (const auto& other : glyphs()) {
+            *g |= other;
+        }
+        occupancy_ = std::move(g);
+    }
+    return *occupancy_;
+}
+
+margins face::calculate_margins() const
+{
+    const auto& g = occupancy();
+    return { g.top_margin(), g.bottom_margin() };
+}
+
+horizontal_margins face::calculate_horizontal_margins() const
+{
+    const auto& g = occupancy();
+    return { g.left_margin(), g.right_margin() };
 }
 
 } // namespace Font
 } // namespace f2b
+
+std::size_t std::hash<f2b::font::glyph>::operator()(const f2b::font::glyph& g) const noexcept
+{
+    using word_type = f2b::font::glyph::word_type;
+
+    auto combine = [](word_type seed, word_type value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    };
+
+    word_type h = combine(g.size().width, g.size().height);
+    for (auto word : g.words()) {
+        h = combine(h, word);
+    }
+    return static_cast<std::size_t>(h ^ (h >> 32));
+}
@@ -1,12 +1,36 @@
 #ifndef FONTDATA_H
 #define FONTDATA_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <iostream>
 #include <set>
+#include <optional>
+#include <stdexcept>
 
 namespace f2b {
 
+/**
+ * @brief Reverses the order of bits in a byte.
+ */
+constexpr uint8_t reverse_bits(uint8_t byte)
+{
+    byte = static_cast<uint8_t>((byte & 0xF0) >> 4 | (byte & 0x0F) << 4);
+    byte = static_cast<uint8_t>((byte & 0xCC) >> 2 | (byte & 0x33) << 2);
+    byte = static_cast<uint8_t>((byte & 0xAA) >> 1 | (byte & 0x55) << 1);
+    return byte;
+}
+
+static_assert (reverse_bits(0x01) == 0x80, "***");
+static_assert (reverse_bits(0x3C) == 0x3C, "***");
+static_assert (reverse_bits(0x1F) == 0xF8, "***");
+
 namespace font {
 
 /**
@@ -27,6 +51,24 @@ inline bool operator!=(const margins& lhs, const margins& rhs) noexcept {
 }
 
 
+/**
+ * @brief A struct that describes font left and right margins
+ *        (columns where no glyphs are drawn).
+ */
+struct horizontal_margins {
+    std::size_t left;
+    std::size_t right;
+};
+
+inline bool operator==(const horizontal_margins& lhs, const horizontal_margins& rhs) noexcept {
+    return lhs.left == rhs.left && lhs.right == rhs.right;
+}
+
+inline bool operator!=(const horizontal_margins& lhs, const horizontal_margins& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+
 /**
  * @brief A struct that describes font size (glyph size) in pixels.
  */
@@ -77,31 +119,73 @@ inline bool operator!=(const point& lhs, const point& rhs) noexcept {
 /**
  * @brief A class that describes a single Font Glyph.
  *
- * A Glyph is represented by a std::vector<bool> of a fixed size.
+ * A Glyph is represented by a bit-packed array of rows. Each row occupies
+ * \c stride() machine words, with pixel \c x of a row stored at bit
+ * <tt>x % word_bits</tt> of word <tt>x / word_bits</tt>. Bits past the glyph
+ * width are always kept cleared, so rows can be compared and scanned
+ * a word at a time.
  */
 class glyph
 {
 public:
+    using word_type = std::uint64_t;
+    static constexpr std::size_t word_bits = std::numeric_limits<word_type>::digits;
+
+    /// Number of words needed to store a row of \c width pixels.
+    static constexpr std::size_t words_per_row(std::size_t width) {
+        return (width + word_bits - 1) / word_bits;
+    }
+
     explicit glyph(glyph_size sz = {});
-    explicit glyph(glyph_size sz, std::vector<bool> pixels);
+    explicit glyph(glyph_size sz, const std::vector<bool>& pixels);
 
     f2b::font::glyph_size size() const noexcept { return size_; }
-    bool is_pixel_set(point p) const { return pixels_[p.offset(size_)]; }
-    void set_pixel_set(point p, bool is_set) { pixels_[p.offset(size_)] = is_set; }
+    bool is_pixel_set(point p) const {
+        return (words_[p.y * stride_ + p.x / word_bits] >> (p.x % word_bits)) & 1u;
+    }
+    void set_pixel_set(point p, bool is_set) {
+        auto& word = words_[p.y * stride_ + p.x / word_bits];
+        auto mask = word_type { 1 } << (p.x % word_bits);
+        word = is_set ? (word | mask) : (word & ~mask);
+    }
     void clear();
 
-    const std::vector<bool>& pixels() const noexcept { return pixels_; }
+    /// Number of words per glyph row.
+    std::size_t stride() const noexcept { return stride_; }
+
+    /// Pointer to the first word of a given row.
+    const word_type* row_data(std::size_t y) const { return words_.data() + y * stride_; }
+
+    /// Replaces a row with \c stride() words; bits past the glyph width are ignored.
+    void set_row(std::size_t y, const word_type* row);
+
+    /// All rows, stored contiguously with \c stride() words per row.
+    const std::vector<word_type>& words() const noexcept { return words_; }
+
+    bool is_row_empty(std::size_t y) const;
+
+    /// Returns the pixels in row-major order (one element per pixel).
+    std::vector<bool> pixels() const;
 
     std::size_t top_margin() const;
     std::size_t bottom_margin() const;
+    std::size_t left_margin() const;
+    std::size_t right_margin() const;
+
+    /// Sets every pixel that is set in \c other (glyph union, computed per word).
+    glyph& operator|=(const glyph& other);
 
 private:
+    /// OR of all rows - a single row where a bit is set if any pixel in the column is set.
+    std::vector<word_type> column_mask() const;
+
     font::glyph_size size_;
-    std::vector<bool> pixels_;
+    std::size_t stride_;
+    std::vector<word_type> words_;
 };
 
 inline bool operator==(const glyph& lhs, const glyph& rhs) noexcept {
-    return lhs.size() == rhs.size() && lhs.pixels() == rhs.pixels();
+    return lhs.size() == rhs.size() && lhs.words() == rhs.words();
 }
 
 inline bool operator!=(const glyph& lhs, const glyph& rhs) noexcept {
@@ -109,6 +193,94 @@ inline bool operator!=(const glyph& lhs, const glyph& rhs) noexcept {
 }
 
 
+/**
+ * @brief A mapping between Unicode code points and glyph indexes of a face.
+ *
+ * The mapping is stored as an array of ranges sorted by code point, where
+ * each range assigns consecutive code points to consecutive glyphs. Lookups
+ * in both directions use binary search, i.e. take O(log n) in the number
+ * of ranges. Glyphs don't need to have a code point assigned.
+ */
+class code_point_map
+{
+public:
+    /// The code point of the first glyph in a face by default (ASCII space).
+    static constexpr char32_t printable_ascii_offset = ' ';
+
+    struct range {
+        char32_t first_code_point;
+        std::size_t first_glyph;
+        std::size_t length;
+
+        char32_t last_code_point() const noexcept { return first_code_point + static_cast<char32_t>(length) - 1; }
+        std::size_t last_glyph() const noexcept { return first_glyph + length - 1; }
+    };
+
+    explicit code_point_map() = default;
+
+    /**
+     * Builds a map assigning \c code_points[i] to the glyph \c i.
+     *
+     * If a code point is repeated, it's only assigned to the first glyph,
+     * leaving the remaining glyphs without a code point.
+     */
+    explicit code_point_map(const std::vector<char32_t>& code_points);
+
+    /// A map assigning consecutive code points to \c num_glyphs glyphs, starting from \c first_code_point.
+    static code_point_map contiguous(char32_t first_code_point, std::size_t num_glyphs);
+
+    /**
+     * Builds a map out of \c ranges (e.g. previously obtained with \c ranges()).
+     * Throws \c std::invalid_argument if ranges overlap.
+     */
+    static code_point_map from_ranges(std::vector<range> ranges);
+
+    std::optional<std::size_t> glyph_index(char32_t code_point) const noexcept;
+    std::optional<char32_t> code_point(std::size_t glyph_index) const noexcept;
+
+    /// Ranges sorted by code point
+    const std::vector<range>& ranges() const noexcept { return ranges_; }
+    bool empty() const noexcept { return ranges_.empty(); }
+
+    /**
+     * Returns true if the map consists of a single range of code points,
+     * starting at \c first_code_point and assigned to the glyph 0.
+     */
+    bool is_contiguous(char32_t first_code_point) const noexcept;
+
+    /**
+     * Assigns a code point to a glyph appended at \c glyph_index, i.e.
+     * the code point following the one of the previous glyph (or
+     * \c printable_ascii_offset for the first glyph), provided it's unused.
+     */
+    void append_glyph(std::size_t glyph_index);
+
+    /// Removes the code point of \c glyph_index and shifts subsequent glyphs indexes by one.
+    void remove_glyph(std::size_t glyph_index);
+
+private:
+    void update_glyph_order();
+
+    std::vector<range> ranges_;
+    // Indexes to ranges_ sorted by first_glyph
+    std::vector<std::size_t> glyph_order_;
+};
+
+inline bool operator==(const code_point_map::range& lhs, const code_point_map::range& rhs) noexcept {
+    return lhs.first_code_point == rhs.first_code_point
+            && lhs.first_glyph == rhs.first_glyph
+            && lhs.length == rhs.length;
+}
+
+inline bool operator==(const code_point_map& lhs, const code_point_map& rhs) noexcept {
+    return lhs.ranges() == rhs.ranges();
+}
+
+inline bool operator!=(const code_point_map& lhs, const code_point_map& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+
 /**
  * @brief An abstract class defining an interface for a font face reader.
  *
@@ -121,13 +293,154 @@ public:
     virtual std::size_t num_glyphs() const = 0;
     virtual bool is_pixel_set(std::size_t glyph_id, point p) const = 0;
 
+    /**
+     * Fills \c row with a packed glyph row (see \c glyph), i.e.
+     * <tt>glyph::words_per_row(font_size().width)</tt> words.
+     *
+     * The default implementation calls \c is_pixel_set for every pixel.
+     * Readers with direct access to pixel data should override it.
+     */
+    virtual void read_row(std::size_t glyph_id, std::size_t y, glyph::word_type* row) const;
+
+    /// Reads a complete glyph, one row at a time, using \c read_row.
+    virtual glyph read_glyph(std::size_t glyph_id) const;
+
+    /// Code points of glyphs. Defaults to consecutive characters starting from ASCII space.
+    virtual code_point_map code_points() const;
+
     virtual ~face_reader() = default;
 };
 
 
+/**
+ * @brief Glyphs read from a \c face_reader on first access, a page at a time.
+ *
+ * Every page is read once, possibly concurrently with reading other pages,
+ * so the reader must be safe to use from multiple threads.
+ */
+class glyph_pages
+{
+public:
+    static constexpr std::size_t default_glyphs_per_page = 256;
+
+    explicit glyph_pages(std::shared_ptr<const face_reader> reader,
+                         std::size_t glyphs_per_page = default_glyphs_per_page);
+
+    glyph_pages(const glyph_pages&) = delete;
+    glyph_pages& operator=(const glyph_pages&) = delete;
+
+    std::size_t size() const noexcept { return size_; }
+
+    /// Returns a glyph, reading its page first if needed.
+    const glyph& at(std::size_t index) const;
+
+    /// Reads all pages that weren't read yet and releases the reader.
+    void load_all() const;
+
+    /// Number of glyphs in pages read so far.
+    std::size_t num_loaded_glyphs() const noexcept { return num_loaded_.load(std::memory_order_relaxed); }
+
+private:
+    struct page {
+        std::once_flag once;
+        std::vector<glyph> glyphs;
+    };
+
+    const page& load_page(std::size_t page_index) const;
+
+    mutable std::shared_ptr<const face_reader> reader_;
+    const std::size_t size_;
+    const std::size_t glyphs_per_page_;
+    mutable std::vector<page> pages_;
+    mutable std::atomic_size_t num_loaded_ { 0 };
+    mutable std::mutex load_all_mutex_;
+};
+
+
+/**
+ * @brief A read-only view of glyphs of a face, iterated like \c std::vector<glyph>.
+ *
+ * Glyphs missing from storage (null pointers) are taken from \c glyph_pages.
+ * The view is valid as long as the face is alive and not modified.
+ */
+class glyph_view
+{
+public:
+    using storage = std::vector<std::shared_ptr<glyph>>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = glyph;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const glyph*;
+        using reference = const glyph&;
+
+        iterator() = default;
+        iterator(const storage* glyphs, const glyph_pages* pages, std::size_t index) :
+            glyphs_ { glyphs }, pages_ { pages }, index_ { index }
+        {}
+
+        reference operator*() const { return glyph_view::glyph_at(*glyphs_, pages_, index_); }
+        pointer operator->() const { return &glyph_view::glyph_at(*glyphs_, pages_, index_); }
+
+        iterator& operator++() { ++index_; return *this; }
+        iterator operator++(int) { auto i = *this; ++index_; return i; }
+
+        bool operator==(const iterator& other) const { return glyphs_ == other.glyphs_ && index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        const storage* glyphs_ { nullptr };
+        const glyph_pages* pages_ { nullptr };
+        std::size_t index_ { 0 };
+    };
+
+    explicit glyph_view(const storage& glyphs, const glyph_pages* pages = nullptr) :
+        glyphs_ { &glyphs },
+        pages_ { pages }
+    {}
+
+    iterator begin() const { return iterator { glyphs_, pages_, 0 }; }
+    iterator end() const { return iterator { glyphs_, pages_, glyphs_->size() }; }
+
+    std::size_t size() const noexcept { return glyphs_->size(); }
+    bool empty() const noexcept { return glyphs_->empty(); }
+    const glyph& operator[](std::size_t index) const { return glyph_at(*glyphs_, pages_, index); }
+
+private:
+    static const glyph& glyph_at(const storage& glyphs, const glyph_pages* pages, std::size_t index) {
+        const auto& g = glyphs[index];
+        return g ? *g : pages->at(index);
+    }
+
+    const storage* glyphs_;
+    const glyph_pages* pages_;
+};
+
+inline bool operator==(const glyph_view& lhs, const glyph_view& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool operator!=(const glyph_view& lhs, const glyph_view& rhs) {
+    return !(lhs == rhs);
+}
+
 /**
  * @brief A class describing a font face (a set of glyphs for a specific
  *        combination of font family, pixel size and weight).
+ *
+ * Glyphs, exported glyph IDs and code points are held in shared storage
+ * that is copied on write, so copying a face takes constant time regardless
+ * of its size (which makes it cheap to snapshot a face for a background job).
+ * Modifying a glyph of a face that shares storage with another face
+ * copies only the modified glyph and the array of glyph pointers.
+ *
+ * A face can also be read lazily from a \c face_reader, with glyphs read
+ * in pages on first access (see \c glyph_pages).
+ *
+ * A face must not be modified while being copied from another thread.
  */
 class face
 {
@@ -139,64 +452,172 @@ public:
     /// The constructor reading a face using face reader. By default all glyphs are exported.
     explicit face(const face_reader &data);
 
-    /// The constructor initializing a face with a given size, vector of glyphs and exported glyph IDs.
-    explicit face(glyph_size glyphs_size, std::vector<glyph> glyphs, std::set<std::size_t> exported_glyph_ids = {});
+    /**
+     * The constructor initializing a face with a given size, vector of glyphs, exported glyph IDs
+     * and glyph code points (defaulting to consecutive characters starting from ASCII space).
+     */
+    explicit face(glyph_size glyphs_size, std::vector<glyph> glyphs, std::set<std::size_t> exported_glyph_ids = {},
+                  std::optional<code_point_map> code_points = {});
+
+    /**
+     * The constructor initializing a face that reads glyphs from \c data on first access,
+     * \c glyphs_per_page glyphs at a time. \c data is shared by copies of the face
+     * and must be safe to read from multiple threads.
+     */
+    explicit face(std::shared_ptr<const face_reader> data, std::set<std::size_t> exported_glyph_ids,
+                  std::size_t glyphs_per_page = glyph_pages::default_glyphs_per_page);
+
+    // Copying only shares storage, and is used instead of moving
+    // so that a moved-from face stays a valid face.
+    face(const face&) = default;
+    face& operator=(const face&) = default;
 
     f2b::font::glyph_size glyphs_size() const noexcept { return sz_; }
-    std::size_t num_glyphs() const noexcept { return glyphs_.size(); }
+    std::size_t num_glyphs() const noexcept { return glyphs_->size(); }
 
-    glyph& glyph_at(std::size_t index) { return glyphs_.at(index); }
-    const glyph& glyph_at(std::size_t index) const { return glyphs_.at(index); }
+    glyph& glyph_at(std::size_t index) {
+        if (index >= glyphs_->size()) {
+            throw std::out_of_range { "Glyph index out of range" };
+        }
+        return mutable_glyph(index);
+    }
+    const glyph& glyph_at(std::size_t index) const {
+        if (index >= glyphs_->size()) {
+            throw std::out_of_range { "Glyph index out of range" };
+        }
+        return glyphs()[index];
+    }
 
-    std::set<std::size_t>& exported_glyph_ids() { return exported_glyph_ids_; }
-    const std::set<std::size_t>& exported_glyph_ids() const { return exported_glyph_ids_; }
+    std::set<std::size_t>& exported_glyph_ids() { return detach(exported_glyph_ids_); }
+    const std::set<std::size_t>& exported_glyph_ids() const { return *exported_glyph_ids_; }
 
-    const std::vector<glyph>& glyphs() const { return glyphs_; }
-    void set_glyph(glyph g, std::size_t index) { glyphs_[index] = g; }
-    void append_glyph(glyph g) { glyphs_.push_back(std::move(g)); }
-    void delete_last_glyph() { if (glyphs_.size() > 0) glyphs_.pop_back(); }
+    glyph_view glyphs() const { return glyph_view { *glyphs_, pages_.get() }; }
+    void set_glyph(glyph g, std::size_t index) {
+        detach(glyphs_)[index] = std::make_shared<glyph>(std::move(g));
+        invalidate_occupancy();
+    }
+    void append_glyph(glyph g) {
+        auto& glyphs = detach(glyphs_);
+        glyphs.push_back(std::make_shared<glyph>(std::move(g)));
+        detach(code_points_).append_glyph(glyphs.size() - 1);
+        invalidate_occupancy();
+    }
+    void delete_last_glyph() {
+        if (glyphs_->size() > 0) {
+            auto& glyphs = detach(glyphs_);
+            glyphs.pop_back();
+            detach(code_points_).remove_glyph(glyphs.size());
+            invalidate_occupancy();
+        }
+    }
     void clear_glyph(std::size_t index) {
-        if (index >= glyphs_.size()) {
+        if (index >= glyphs_->size()) {
             throw std::out_of_range { "Glyph index out of range" };
         }
-        glyphs_[index].clear();
+        mutable_glyph(index).clear();
+    }
+
+    const code_point_map& code_points() const noexcept { return *code_points_; }
+    void set_code_points(code_point_map code_points) {
+        code_points_ = std::make_shared<code_point_map>(std::move(code_points));
+    }
+
+    /// Returns the index of a glyph for a Unicode \c code_point, if the face contains it.
+    std::optional<std::size_t> glyph_index(char32_t code_point) const noexcept {
+        return code_points_->glyph_index(code_point);
+    }
+
+    /// Returns the Unicode code point of a glyph at \c index, if assigned.
+    std::optional<char32_t> code_point(std::size_t index) const noexcept {
+        return code_points_->code_point(index);
     }
 
     glyph& operator[](char ascii) {
-        if (ascii < ' ') {
-            throw std::out_of_range { "Glyphs for 0-31 ASCII range are not supported" };
-        }
-        return glyphs_[ascii-32];
+        return mutable_glyph(ascii_glyph_index(ascii));
     }
 
     const glyph& operator[](char ascii) const {
-        if (ascii < ' ') {
-            throw std::out_of_range { "Glyphs for 0-31 ASCII range are not supported" };
-        }
-        return glyphs_[ascii-32];
+        return glyph_at(ascii_glyph_index(ascii));
     }
 
+    /**
+     * Returns the union of all glyphs - a glyph where a pixel is set
+     * if it's set in any of the face glyphs.
+     *
+     * The result is cached and recomputed only after the face is modified
+     * (including any non-const access to a glyph).
+     */
+    const glyph& occupancy() const;
+
     /**
      * Calculcates margins of a face.
      *
      * This method analyzes all glyphs and takes the maximum common empty areas
      * on the top and bottom.
      */
-    margins calculate_margins() const noexcept;
+    margins calculate_margins() const;
+
+    /**
+     * Calculates the maximum common empty areas on the left and right
+     * of all glyphs in a face.
+     */
+    horizontal_margins calculate_horizontal_margins() const;
+
+    /// True if \c other shares glyph storage with this face, i.e. none of them was modified since copying.
+    bool shares_glyphs_with(const face& other) const noexcept { return glyphs_ == other.glyphs_; }
+
+    /// Number of glyphs read so far by a lazily read face (all glyphs otherwise).
+    std::size_t num_loaded_glyphs() const noexcept {
+        return pages_ ? pages_->num_loaded_glyphs() : glyphs_->size();
+    }
+
+    /// Reads all glyphs of a lazily read face, so that it no longer needs its reader.
+    void load_all_glyphs() const {
+        if (pages_) {
+            pages_->load_all();
+        }
+    }
 
 private:
     static std::vector<glyph> read_glyphs(const face_reader &data);
+    void invalidate_occupancy() noexcept { occupancy_.reset(); }
+    std::size_t ascii_glyph_index(char ascii) const;
+
+    /// Makes \c storage exclusively owned by this face, copying it if it's shared.
+    template<typename T>
+    static T& detach(std::shared_ptr<T>& storage) {
+        if (storage.use_count() > 1) {
+            storage = std::make_shared<T>(*storage);
+        }
+        return *storage;
+    }
+
+    /// Returns a glyph for modification, copying it first if it's shared with another face.
+    glyph& mutable_glyph(std::size_t index) {
+        auto& g = detach(glyphs_).at(index);
+        if (g) {
+            detach(g);
+        } else {
+            g = std::make_shared<glyph>(pages_->at(index));
+        }
+        invalidate_occupancy();
+        return *g;
+    }
 
     font::glyph_size sz_;
-    std::vector<glyph> glyphs_;
-    std::set<std::size_t> exported_glyph_ids_;
+    std::shared_ptr<glyph_view::storage> glyphs_ { std::make_shared<glyph_view::storage>() };
+    std::shared_ptr<std::set<std::size_t>> exported_glyph_ids_ { std::make_shared<std::set<std::size_t>>() };
+    std::shared_ptr<code_point_map> code_points_ { std::make_shared<code_point_map>() };
+    // Source of glyphs not present in glyphs_ (null pointers) for a lazily read face
+    std::shared_ptr<const glyph_pages> pages_;
+    mutable std::shared_ptr<const glyph> occupancy_;
 };
 
-inline bool operator==(const face& lhs, const face& rhs) noexcept {
+inline bool operator==(const face& lhs, const face& rhs) {
     return lhs.glyphs_size() == rhs.glyphs_size() && lhs.glyphs() == rhs.glyphs();
 }
 
-inline bool operator!=(const face& lhs, const face& rhs) noexcept {
+inline bool operator!=(const face& lhs, const face& rhs) {
     return !(lhs == rhs);
 }
 
@@ -204,15 +625,24 @@ inline bool operator!=(const face& lhs, const face& rhs) noexcept {
 
 } // namespace f2b
 
+namespace std {
+
+/// Hashes glyph size and pixel data.
+template<>
+struct hash<f2b::font::glyph>
+{
+    std::size_t operator()(const f2b::font::glyph& g) const noexcept;
+};
+
+} // namespace std
+
 inline std::ostream& operator<<(std::ostream& os, const f2b::font::glyph& g) {
 
-    std::size_t col = 0;
-    for (auto p : g.pixels()) {
-        os << p;
-        if (++col >= g.size().width) {
-            col = 0;
-            os << std::endl;
+    for (std::size_t y = 0; y < g.size().height; ++y) {
+        for (std::size_t x = 0; x < g.size().width; ++x) {
+            os << g.is_pixel_set({ x, y });
         }
+        os << std::endl;
     }
     os << std::flush;
 
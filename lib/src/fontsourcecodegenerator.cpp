@@ -1,12 +1,79 @@
 #include "fontsourcecodegenerator.h"
+#include <charconv>
 #include <iomanip>
+#include <sstream>
 #include <string>
 
 namespace f2b {
 
-font::margins pixel_margins(font::margins line_margins, font::glyph_size glyph_size)
+std::shared_ptr<const std::string> glyph_fragment_cache::find(const std::string& configuration, const font::glyph& glyph) const
 {
-    return { line_margins.top * glyph_size.width, line_margins.bottom * glyph_size.width };
+    std::scoped_lock lock { mutex_ };
+    if (configuration != configuration_) {
+        return nullptr;
+    }
+    auto i = fragments_.find(glyph);
+    if (i == fragments_.end()) {
+        return nullptr;
+    }
+    return i->second;
+}
+
+void glyph_fragment_cache::insert(const std::string& configuration, const font::glyph& glyph, std::string fragment)
+{
+    std::scoped_lock lock { mutex_ };
+    if (configuration != configuration_ || fragments_.size() >= capacity_) {
+        // Fragments for previous versions of edited glyphs pile up over time,
+        // so start over rather than tracking their usage.
+        fragments_.clear();
+        configuration_ = configuration;
+    }
+    fragments_.insert_or_assign(glyph, std::make_shared<const std::string>(std::move(fragment)));
+}
+
+std::size_t glyph_fragment_cache::size() const
+{
+    std::scoped_lock lock { mutex_ };
+    return fragments_.size();
+}
+
+void glyph_fragment_cache::clear()
+{
+    std::scoped_lock lock { mutex_ };
+    fragments_.clear();
+    configuration_.clear();
+}
+
+std::string font_source_code_generator::fragment_configuration(std::string_view format, font::glyph_size size, font::margins margins) const
+{
+    std::ostringstream s;
+    s << format << '/'
+      << static_cast<unsigned>(options_.wrap_column) << '/'
+      << options_.bit_numbering << '/'
+      << options_.invert_bits << '/';
+    if (std::holds_alternative<source_code::space>(options_.indentation)) {
+        s << std::get<source_code::space>(options_.indentation).num_spaces;
+    } else {
+        s << "tab";
+    }
+    s << '/' << size.width << 'x' << size.height
+      << '/' << margins.top << ',' << margins.bottom;
+    return s.str();
+}
+
+std::size_t font_source_code_generator::formatting_thread_count(std::size_t num_glyphs) const
+{
+    if (num_glyphs < min_glyphs_for_threads) {
+        return 1;
+    }
+
+    auto thread_count = options_.thread_count;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    auto num_chunks = (num_glyphs + glyphs_per_chunk - 1) / glyphs_per_chunk;
+    return std::min(thread_count, num_chunks);
 }
 
 std::string font_source_code_generator::current_timestamp()
@@ -18,21 +85,49 @@ std::string font_source_code_generator::current_timestamp()
     return s.str();
 }
 
-std::string font_source_code_generator::comment_for_glyph(std::size_t index)
+std::string font_source_code_generator::comment_for_glyph(std::size_t index, std::optional<char32_t> code_point)
 {
-    index += 32;
-    std::ostringstream s;
-    s << "Character 0x"
-      << std::hex << std::setfill('0') << std::setw(2) << index
-      << std::dec << " (" << index;
+    if (!code_point.has_value()) {
+        return "Glyph " + std::to_string(index);
+    }
+
+    // Called for every glyph, hence formatted without a string stream.
+    auto value = static_cast<uint32_t>(code_point.value());
+    char hex[8];
+    auto hex_end = std::to_chars(hex, hex + sizeof(hex), value, 16).ptr;
 
-    if (std::isprint(index)) {
-        s << ": '" << static_cast<char>(index) << "'";
+    std::string comment = "Character 0x";
+    if (hex_end - hex < 2) {
+        comment += '0';
     }
+    comment.append(hex, hex_end);
+    comment += " (";
+    comment += std::to_string(value);
 
-    s << ")";
+    if (value < 0x80 && std::isprint(static_cast<int>(value))) {
+        comment += ": '";
+        comment += static_cast<char>(value);
+        comment += "'";
+    }
+
+    comment += ")";
 
+    return comment;
+}
+
+std::string font_source_code_generator::comment_for_range(const font::code_point_map::range& range)
+{
+    std::ostringstream s;
+    s << std::hex << std::uppercase << std::setfill('0')
+      << "U+" << std::setw(4) << static_cast<uint32_t>(range.first_code_point)
+      << "..U+" << std::setw(4) << static_cast<uint32_t>(range.last_code_point());
     return s.str();
 }
 
+bool font_source_code_generator::has_code_point_ranges(const font::face& face)
+{
+    return !face.code_points().empty()
+            && !face.code_points().is_contiguous(font::code_point_map::printable_ascii_offset);
+}
+
 }
@@ -4,11 +4,23 @@
 #include "fontdata.h"
 #include "sourcecode.h"
 #include "format.h"
+#include "outputsink.h"
 
+#include <array>
+#include <atomic>
 #include <string>
-#include <sstream>
-#include <bitset>
 #include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <unordered_map>
 
 namespace f2b
 {
@@ -26,22 +38,78 @@ struct source_code_options
     bool invert_bits { false };
     bool include_line_spacing { false };
     source_code::indentation indentation { source_code::tab {} };
+
+    /**
+     * Number of threads formatting glyphs of large faces; 0 means
+     * std::thread::hardware_concurrency(). Doesn't affect the output.
+     */
+    std::size_t thread_count { 1 };
+};
+
+/**
+ * @brief A cache of source code fragments (array rows) emitted for glyphs.
+ *
+ * Fragments are keyed by glyph contents, and are valid for a single
+ * configuration, i.e. a combination of the output format, source code options,
+ * glyph size and margins. Inserting a fragment for a different configuration
+ * drops all fragments cached so far, as does reaching the capacity.
+ *
+ * The cache is thread-safe and may be shared by multiple generators.
+ */
+class glyph_fragment_cache
+{
+public:
+    static constexpr std::size_t default_capacity = 65536;
+
+    explicit glyph_fragment_cache(std::size_t capacity = default_capacity) :
+        capacity_ { capacity }
+    {}
+
+    std::shared_ptr<const std::string> find(const std::string& configuration, const font::glyph& glyph) const;
+    void insert(const std::string& configuration, const font::glyph& glyph, std::string fragment);
+
+    std::size_t size() const;
+    void clear();
+
+private:
+    mutable std::mutex mutex_;
+    const std::size_t capacity_;
+    std::string configuration_;
+    std::unordered_map<font::glyph, std::shared_ptr<const std::string>> fragments_;
 };
 
+
 /**
- * @brief Converts line margins to pixel margins.
- * @param line_margins - margins expressed in lines
- * @param glyph_size
- * @return Margins expressed in pixel offset for a given glyph size (width).
+ * @brief A flag that requests cancellation of source code generation,
+ *        possibly from another thread.
+ *
+ * Once canceled, a token stays canceled.
  */
-font::margins pixel_margins(font::margins line_margins, font::glyph_size glyph_size);
+class cancellation_token
+{
+public:
+    void cancel() noexcept { canceled_.store(true, std::memory_order_relaxed); }
+    bool is_canceled() const noexcept { return canceled_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic_bool canceled_ { false };
+};
+
+/**
+ * @brief Thrown by \c font_source_code_generator when generation
+ *        is canceled with a \c cancellation_token.
+ */
+struct generation_canceled : public std::runtime_error
+{
+    generation_canceled() : std::runtime_error("source code generation canceled") {}
+};
 
 
 class font_source_code_generator_interface
 {
 public:
     virtual std::string current_timestamp() = 0;
-    virtual std::string comment_for_glyph(std::size_t index) = 0;
+    virtual std::string comment_for_glyph(std::size_t index, std::optional<char32_t> code_point) = 0;
 };
 
 /**
@@ -102,11 +170,31 @@ public:
 class font_source_code_generator : private font_source_code_generator_interface
 {
 public:
+    /// Glyphs are formatted on multiple threads in chunks of this many glyphs.
+    static constexpr std::size_t glyphs_per_chunk = 128;
+    /// Faces with fewer glyphs to output are formatted on the calling thread only.
+    static constexpr std::size_t min_glyphs_for_threads = 2048;
 
-    font_source_code_generator(source_code_options options):
-        options_ { options }
+    /**
+     * Creates a generator with given \c options. If \c fragment_cache is provided,
+     * source code of glyphs is reused from the cache when possible, so that only
+     * modified glyphs are converted when generating source code for the same face again.
+     */
+    font_source_code_generator(source_code_options options,
+                               std::shared_ptr<glyph_fragment_cache> fragment_cache = {}):
+        options_ { options },
+        fragment_cache_ { std::move(fragment_cache) }
     {}
 
+    /**
+     * Sets a token checked by the generator between glyphs. When the token
+     * gets canceled, \c generate stops early and throws \c generation_canceled.
+     * Output passed to a sink before cancellation is incomplete and should be discarded.
+     */
+    void set_cancellation_token(std::shared_ptr<const cancellation_token> token) {
+        cancellation_token_ = std::move(token);
+    }
+
     /**
      * A template method that generates source code for a given \c face.
      *
@@ -122,81 +210,278 @@ public:
     template<typename T>
     std::string generate(const font::face& face, std::string font_name = "font");
 
+    /**
+     * Generates source code for a given \c face like \c generate, passing it
+     * to \c sink in chunks of up to \c buffer_size characters as it's created.
+     */
+    template<typename T>
+    void generate(const font::face& face, const output_sink& sink, std::string font_name = "font",
+                  std::size_t buffer_size = sink_buffer::default_buffer_size);
+
 private:
     template<typename T>
-    std::string generate_all(const font::face& face, std::string font_name = "font");
+    void generate_all(const font::face& face, std::string font_name, std::ostream& s);
 
     template<typename T>
-    std::string generate_subset(const font::face& face, std::string font_name = "font");
+    void generate_subset(const font::face& face, std::string font_name, std::ostream& s);
 
     template<typename T, typename V>
-    std::string subset_lut(const std::set<std::size_t>& exported_glyph_ids,
-                           bool has_dummy_blank_glyph,
-                           std::size_t bytes_per_glyph);
+    void subset_lut(const font::face& face,
+                    bool has_dummy_blank_glyph,
+                    std::size_t bytes_per_glyph,
+                    std::ostream& s);
 
+    /**
+     * Outputs a table of code point ranges: first code point, range length
+     * and the first glyph index for each range, sorted by code point.
+     * Ranges are limited to glyphs up to \c last_glyph.
+     */
+    template<typename T>
+    void code_point_ranges(const font::code_point_map& code_points, std::size_t last_glyph, std::ostream& s);
+
+    /// Outputs glyph rows, skipping \c margins (expressed in lines) at the top and bottom.
     template<typename T>
     void output_glyph(const font::glyph& glyph, font::glyph_size size, font::margins margins, std::ostream& s);
 
+    /// Outputs glyph rows like \c output_glyph, reusing a cached fragment if available.
+    template<typename T>
+    void output_glyph_fragment(const font::glyph& glyph, font::glyph_size size, font::margins margins,
+                               const std::string& configuration, std::ostream& s);
+
+    /// Outputs a glyph followed by its comment and a line break.
+    template<typename T>
+    void output_glyph_entry(const font::face& face, std::size_t glyph_id, font::glyph_size size, font::margins margins,
+                            const std::string& configuration, std::ostream& s);
+
+    /**
+     * Outputs entries (see \c output_glyph_entry) for glyphs with given IDs, in order.
+     *
+     * With \c source_code_options::thread_count other than 1, large faces are
+     * formatted in chunks on multiple threads.
+     */
+    template<typename T>
+    void output_glyph_entries(const font::face& face, const std::vector<std::size_t>& glyph_ids,
+                              font::glyph_size size, font::margins margins,
+                              const std::string& configuration, std::ostream& s);
+
+    /// The number of threads to format \c num_glyphs glyphs with.
+    std::size_t formatting_thread_count(std::size_t num_glyphs) const;
+
+    /// Identifies all parameters affecting glyph fragments, see \c glyph_fragment_cache.
+    std::string fragment_configuration(std::string_view format, font::glyph_size size, font::margins margins) const;
+
 
     std::string current_timestamp() override;
-    std::string comment_for_glyph(std::size_t index) override;
+    std::string comment_for_glyph(std::size_t index, std::optional<char32_t> code_point) override;
+    std::string comment_for_range(const font::code_point_map::range& range);
+
+    /// True if glyphs are not consecutive characters starting from ASCII space, and require a range table.
+    static bool has_code_point_ranges(const font::face& face);
+
+    /// Throws \c generation_canceled if the cancellation token was canceled.
+    void throw_if_canceled() const {
+        if (cancellation_token_ && cancellation_token_->is_canceled()) {
+            throw generation_canceled {};
+        }
+    }
+
     source_code_options options_;
+    std::shared_ptr<glyph_fragment_cache> fragment_cache_;
+    std::shared_ptr<const cancellation_token> cancellation_token_;
 };
 
 template<typename T>
 void font_source_code_generator::output_glyph(const font::glyph& glyph, font::glyph_size size, font::margins margins, std::ostream& s)
 {
     using namespace source_code;
-    std::bitset<byte_size> bits;
-    std::size_t bit_pos { 0 };
-    std::size_t col { 0 };
 
-    auto append_byte = [&](std::bitset<byte_size>& bits, std::ios::pos_type& pos) {
+    // Bytes are formatted into a local buffer that is written out in blocks.
+    // Line length is counted here, so the stream position is only queried
+    // when a new line begins.
+    std::array<char, 1024> buffer;
+    auto out = buffer.data();
+    auto flush = [&] {
+        s.write(buffer.data(), out - buffer.data());
+        out = buffer.data();
+    };
+
+    std::streamoff line_length { 0 };
+    auto begin_row = [&] {
+        auto pos = s.tellp();
+        s << idiom::begin_array_row<T, uint8_t> { options_.indentation };
+        line_length = s.tellp() - pos;
+    };
+
+    auto append_byte = [&](uint8_t byte) {
         if (options_.invert_bits) {
-            bits.flip();
+            byte = ~byte;
         }
-        auto byte = static_cast<uint8_t>(bits.to_ulong());
-        s << idiom::value<T, uint8_t> { std::move(byte) };
-        bits.reset();
+        auto end = format_value<T, uint8_t>(out, byte);
+        line_length += end - out;
+        out = end;
 
-        if (s.tellp() - pos >= options_.wrap_column) {
+        if (line_length >= options_.wrap_column) {
+            flush();
             s << idiom::array_line_break<T, uint8_t> {};
-            pos = s.tellp();
-            s << idiom::begin_array_row<T, uint8_t> { options_.indentation };
+            begin_row();
+        } else if (buffer.data() + buffer.size() - out < static_cast<std::ptrdiff_t>(max_value_length)) {
+            flush();
         }
     };
 
+    begin_row();
+
+    // Glyph rows are packed LSB-first, so each output byte is a single
+    // aligned 8-bit slice of a row word (word size is a multiple of a byte).
+    auto bytes_per_row = size.width / byte_size + (size.width % byte_size ? 1 : 0);
+    auto last_row = glyph.size().height > margins.bottom ? glyph.size().height - margins.bottom : 0;
+
+    for (std::size_t y = margins.top; y < last_row; ++y) {
+        auto row = glyph.row_data(y);
+        for (std::size_t byte_index = 0; byte_index < bytes_per_row; ++byte_index) {
+            auto bit = byte_index * byte_size;
+            auto byte = static_cast<uint8_t>(row[bit / font::glyph::word_bits] >> (bit % font::glyph::word_bits));
+            if (options_.bit_numbering == source_code_options::msb) {
+                byte = reverse_bits(byte);
+            }
+            append_byte(byte);
+        }
+    }
 
-    auto pos = s.tellp();
-    s << idiom::begin_array_row<T, uint8_t> { options_.indentation };
+    flush();
+}
 
-    std::for_each(glyph.pixels().cbegin() + margins.top, glyph.pixels().cend() - margins.bottom,
-                  [&](auto pixel) {
-        switch (options_.bit_numbering) {
-        case source_code_options::lsb:
-            bits[bit_pos] = pixel;
-            break;
-        case source_code_options::msb:
-            bits[byte_size-1-bit_pos] = pixel;
+template<typename T>
+void font_source_code_generator::output_glyph_fragment(const font::glyph& glyph, font::glyph_size size, font::margins margins,
+                                                       const std::string& configuration, std::ostream& s)
+{
+    if (!fragment_cache_) {
+        output_glyph<T>(glyph, size, margins, s);
+        return;
+    }
+
+    if (auto fragment = fragment_cache_->find(configuration, glyph)) {
+        s << *fragment;
+        return;
+    }
+
+    // Line wrapping only depends on the output since the beginning of a glyph,
+    // so the fragment may be generated separately.
+    std::ostringstream fragment;
+    output_glyph<T>(glyph, size, margins, fragment);
+    auto text = fragment.str();
+    s << text;
+    fragment_cache_->insert(configuration, glyph, std::move(text));
+}
+
+template<typename T>
+void font_source_code_generator::output_glyph_entry(const font::face& face, std::size_t glyph_id,
+                                                    font::glyph_size size, font::margins margins,
+                                                    const std::string& configuration, std::ostream& s)
+{
+    using namespace source_code;
+
+    output_glyph_fragment<T>(face.glyph_at(glyph_id), size, margins, configuration, s);
+    s << idiom::comment<T, uint8_t> { comment_for_glyph(glyph_id, face.code_point(glyph_id)) };
+    s << idiom::array_line_break<T, uint8_t> {};
+}
+
+template<typename T>
+void font_source_code_generator::output_glyph_entries(const font::face& face, const std::vector<std::size_t>& glyph_ids,
+                                                      font::glyph_size size, font::margins margins,
+                                                      const std::string& configuration, std::ostream& s)
+{
+    auto thread_count = formatting_thread_count(glyph_ids.size());
+    if (thread_count <= 1) {
+        for (auto glyph_id : glyph_ids) {
+            throw_if_canceled();
+            output_glyph_entry<T>(face, glyph_id, size, margins, configuration, s);
+        }
+        return;
+    }
+
+    // Line wrapping starts over with every glyph, so glyphs can be formatted
+    // independently. Threads claim consecutive chunks of glyphs and format them
+    // into separate buffers that are written out in order once all are done.
+    auto num_chunks = (glyph_ids.size() + glyphs_per_chunk - 1) / glyphs_per_chunk;
+    std::vector<std::string> chunks(num_chunks);
+    std::atomic_size_t next_chunk { 0 };
+    std::atomic_bool failed { false };
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto format_chunks = [&] {
+        try {
+            for (auto chunk = next_chunk++; chunk < num_chunks && !failed; chunk = next_chunk++) {
+                sink_buffer buffer { string_sink(chunks[chunk]) };
+                std::ostream chunk_stream { &buffer };
+
+                auto end = std::min(glyph_ids.size(), (chunk + 1) * glyphs_per_chunk);
+                for (auto i = chunk * glyphs_per_chunk; i < end; ++i) {
+                    throw_if_canceled();
+                    output_glyph_entry<T>(face, glyph_ids[i], size, margins, configuration, chunk_stream);
+                }
+                buffer.flush();
+            }
+        } catch (...) {
+            std::scoped_lock lock { error_mutex };
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (std::size_t i = 1; i < thread_count; ++i) {
+        try {
+            threads.emplace_back(format_chunks);
+        } catch (const std::system_error&) {
+            // Carry on with threads started so far
             break;
         }
+    }
+    format_chunks();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (const auto& chunk : chunks) {
+        s.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+template<typename T>
+void font_source_code_generator::code_point_ranges(const font::code_point_map& code_points, std::size_t last_glyph, std::ostream& s)
+{
+    using namespace source_code;
 
-        ++bit_pos;
-        ++col;
+    s << idiom::begin_array<T, uint32_t> { "ranges" };
 
-        if (col >= size.width) {
-            append_byte(bits, pos);
-            bit_pos = 0;
-            col = 0;
-        } else if (bit_pos >= byte_size) {
-            append_byte(bits, pos);
-            bit_pos = 0;
+    for (auto range : code_points.ranges()) {
+        if (range.first_glyph > last_glyph) {
+            continue;
         }
-    });
+        range.length = std::min(range.length, last_glyph - range.first_glyph + 1);
+
+        s << idiom::begin_array_row<T, uint32_t> { options_.indentation };
+        s << idiom::value<T, uint32_t> { static_cast<uint32_t>(range.first_code_point) };
+        s << idiom::value<T, uint32_t> { static_cast<uint32_t>(range.length) };
+        s << idiom::value<T, uint32_t> { static_cast<uint32_t>(range.first_glyph) };
+        s << idiom::comment<T, uint32_t> { comment_for_range(range) };
+        s << idiom::array_line_break<T, uint32_t> {};
+    }
+
+    s << idiom::end_array<T, uint32_t> {};
 }
 
 template<typename T>
-std::string font_source_code_generator::generate_all(const font::face& face, std::string font_name)
+void font_source_code_generator::generate_all(const font::face& face, std::string font_name, std::ostream& s)
 {
     using namespace source_code;
 
@@ -205,45 +490,52 @@ std::string font_source_code_generator::generate_all(const font::face& face, std
             return { face.glyphs_size(), {} };
         }
         auto line_margins = face.calculate_margins();
-        return { face.glyphs_size().with_margins(line_margins),
-                    pixel_margins(line_margins, face.glyphs_size()) };
+        return { face.glyphs_size().with_margins(line_margins), line_margins };
     }();
 
-    std::ostringstream s;
     s << idiom::begin<T> { font_name, size, current_timestamp() } << std::endl;
 
+    auto uses_ranges = has_code_point_ranges(face);
+
     s << idiom::comment<T> {} << std::endl;
     s << idiom::comment<T> { "Pseudocode for retrieving data for a specific character:" } << std::endl;
     s << idiom::comment<T> {} << std::endl;
     s << idiom::comment<T> { "bytes_per_char = font_height * (font_width / 8 + ((font_width % 8) ? 1 : 0))" } << std::endl;
-    s << idiom::comment<T> { "offset = (ascii_code(character) - ascii_code(' ')) * bytes_per_char" } << std::endl;
+    if (uses_ranges) {
+        s << idiom::comment<T> { "find (first_code_point, length, first_glyph) in ranges (binary search over sorted first_code_point)" } << std::endl;
+        s << idiom::comment<T> { "    such that first_code_point <= code_point(character) < first_code_point + length" } << std::endl;
+        s << idiom::comment<T> { "offset = (first_glyph + code_point(character) - first_code_point) * bytes_per_char" } << std::endl;
+    } else {
+        s << idiom::comment<T> { "offset = (ascii_code(character) - ascii_code(' ')) * bytes_per_char" } << std::endl;
+    }
     s << idiom::comment<T> { "data = " + font_name + "[offset]" } << std::endl;
     s << idiom::comment<T> {};
 
     s << idiom::begin_array<T, uint8_t> { std::move(font_name) };
 
-    std::size_t glyph_id { 0 };
-    for (const auto& glyph : face.glyphs()) {
-        output_glyph<T>(glyph, size, margins, s);
-        s << idiom::comment<T, uint8_t> { comment_for_glyph(glyph_id) };
-        s << idiom::array_line_break<T, uint8_t> {};
-        ++glyph_id;
-    }
+    std::vector<std::size_t> glyph_ids(face.num_glyphs());
+    std::iota(glyph_ids.begin(), glyph_ids.end(), 0);
+    output_glyph_entries<T>(face, glyph_ids, size, margins,
+                            fragment_configuration(T::identifier, size, margins), s);
 
     s << idiom::end_array<T, uint8_t> {};
-    s << idiom::end<T> {};
 
-    return s.str();
+    if (uses_ranges) {
+        code_point_ranges<T>(face.code_points(), face.num_glyphs() - 1, s);
+    }
+
+    s << idiom::end<T> {};
 }
 
 template<typename T, typename V>
-std::string font_source_code_generator::subset_lut(const std::set<std::size_t>& exported_glyph_ids,
-                                                   bool has_dummy_blank_glyph,
-                                                   std::size_t bytes_per_glyph)
+void font_source_code_generator::subset_lut(const font::face& face,
+                                            bool has_dummy_blank_glyph,
+                                            std::size_t bytes_per_glyph,
+                                            std::ostream& s)
 {
     using namespace source_code;
 
-    std::ostringstream s;
+    const auto& exported_glyph_ids = face.exported_glyph_ids();
 
     // If there's a dummy blank glyph, first exported character is at index 1, not 0.
     V exported_id { static_cast<V>(has_dummy_blank_glyph) };
@@ -255,12 +547,13 @@ std::string font_source_code_generator::subset_lut(const std::set<std::size_t>&
     // Control line breaks with this flag - add a line break only before an exported glyph
     bool is_previous_exported = true;
     for (std::size_t glyph_id = 0; glyph_id <= *last_exported_glyph; ++glyph_id) {
+        throw_if_canceled();
         if (exported_glyph_ids.find(glyph_id) != exported_glyph_ids.end()) {
             if (!is_previous_exported)
                 s << idiom::array_line_break<T, V> {};
             s << idiom::begin_array_row<T, V> { options_.indentation };
             s << idiom::value<T, V> { static_cast<V>(bytes_per_glyph * exported_id) };
-            s << idiom::comment<T, V> { comment_for_glyph(glyph_id) };
+            s << idiom::comment<T, V> { comment_for_glyph(glyph_id, face.code_point(glyph_id)) };
             ++exported_id;
             s << idiom::array_line_break<T, V> {};
             is_previous_exported = true;
@@ -273,12 +566,10 @@ std::string font_source_code_generator::subset_lut(const std::set<std::size_t>&
     }
 
     s << idiom::end_array<T, V> {};
-
-    return s.str();
 }
 
 template<typename T>
-std::string font_source_code_generator::generate_subset(const font::face& face, std::string font_name)
+void font_source_code_generator::generate_subset(const font::face& face, std::string font_name, std::ostream& s)
 {
     using namespace source_code;
 
@@ -287,17 +578,23 @@ std::string font_source_code_generator::generate_subset(const font::face& face,
             return { face.glyphs_size(), {} };
         }
         auto line_margins = face.calculate_margins();
-        return { face.glyphs_size().with_margins(line_margins),
-                    pixel_margins(line_margins, face.glyphs_size()) };
+        return { face.glyphs_size().with_margins(line_margins), line_margins };
     }();
 
-    std::ostringstream s;
     s << idiom::begin<T> { font_name, size, current_timestamp() } << std::endl;
 
+    auto uses_ranges = has_code_point_ranges(face);
+
     s << idiom::comment<T> {} << std::endl;
     s << idiom::comment<T> { "Pseudocode for retrieving data for a specific character:" } << std::endl;
     s << idiom::comment<T> {} << std::endl;
-    s << idiom::comment<T> { "offset = ascii_code(character) - ascii_code(' ')" } << std::endl;
+    if (uses_ranges) {
+        s << idiom::comment<T> { "find (first_code_point, length, first_glyph) in ranges (binary search over sorted first_code_point)" } << std::endl;
+        s << idiom::comment<T> { "    such that first_code_point <= code_point(character) < first_code_point + length" } << std::endl;
+        s << idiom::comment<T> { "offset = first_glyph + code_point(character) - first_code_point" } << std::endl;
+    } else {
+        s << idiom::comment<T> { "offset = ascii_code(character) - ascii_code(' ')" } << std::endl;
+    }
     s << idiom::comment<T> { "data = " + font_name + "[lut[offset]]" } << std::endl;
     s << idiom::comment<T> {};
 
@@ -306,20 +603,18 @@ std::string font_source_code_generator::generate_subset(const font::face& face,
     // Not exported characters are replaced with a space character.
     // If space character (ASCII 32, the first glyph) itself is not exported,
     // we add a dummy blank character and default all not exported characters to it.
+    auto configuration = fragment_configuration(T::identifier, size, margins);
+
     bool has_dummy_blank_glyph = false;
     if (face.exported_glyph_ids().find(0) == face.exported_glyph_ids().end()) {
-        output_glyph<T>(font::glyph(face.glyphs_size()), size, margins, s);
+        output_glyph_fragment<T>(font::glyph(face.glyphs_size()), size, margins, configuration, s);
         s << idiom::comment<T, uint8_t> { "Dummy blank character" };
         s << idiom::array_line_break<T, uint8_t> {};
         has_dummy_blank_glyph = true;
     }
 
-    for (auto glyph_id : face.exported_glyph_ids()) {
-        const auto& glyph = face.glyph_at(glyph_id);
-        output_glyph<T>(glyph, size, margins, s);
-        s << idiom::comment<T, uint8_t> { comment_for_glyph(glyph_id) };
-        s << idiom::array_line_break<T, uint8_t> {};
-    }
+    std::vector<std::size_t> glyph_ids(face.exported_glyph_ids().begin(), face.exported_glyph_ids().end());
+    output_glyph_entries<T>(face, glyph_ids, size, margins, configuration, s);
 
     s << idiom::end_array<T, uint8_t> {};
 
@@ -330,29 +625,49 @@ std::string font_source_code_generator::generate_subset(const font::face& face,
     auto max_offset = (face.exported_glyph_ids().size() - 1) * bytes_per_glyph;
 
     if (max_offset < (1<<8)) {
-        s << subset_lut<T,uint8_t>(face.exported_glyph_ids(), has_dummy_blank_glyph, bytes_per_glyph);
+        subset_lut<T,uint8_t>(face, has_dummy_blank_glyph, bytes_per_glyph, s);
     } else if (max_offset < (1<<16)) {
-        s << subset_lut<T,uint16_t>(face.exported_glyph_ids(), has_dummy_blank_glyph, bytes_per_glyph);
+        subset_lut<T,uint16_t>(face, has_dummy_blank_glyph, bytes_per_glyph, s);
     } else if (max_offset < (1ull<<32)) {
-        s << subset_lut<T,uint32_t>(face.exported_glyph_ids(), has_dummy_blank_glyph, bytes_per_glyph);
+        subset_lut<T,uint32_t>(face, has_dummy_blank_glyph, bytes_per_glyph, s);
     } else {
-        s << subset_lut<T,uint64_t>(face.exported_glyph_ids(), has_dummy_blank_glyph, bytes_per_glyph);
+        subset_lut<T,uint64_t>(face, has_dummy_blank_glyph, bytes_per_glyph, s);
     }
 
-    s << idiom::end<T> {};
+    if (uses_ranges && !face.exported_glyph_ids().empty()) {
+        code_point_ranges<T>(face.code_points(), *std::prev(face.exported_glyph_ids().end()), s);
+    }
 
-    return s.str();
+    s << idiom::end<T> {};
 }
 
 template<typename T>
 std::string font_source_code_generator::generate(const font::face &face, std::string font_name)
 {
+    std::string output;
+    generate<T>(face, string_sink(output), std::move(font_name));
+    return output;
+}
+
+template<typename T>
+void font_source_code_generator::generate(const font::face &face, const output_sink& sink,
+                                          std::string font_name, std::size_t buffer_size)
+{
+    throw_if_canceled();
+
+    sink_buffer buffer { sink, buffer_size };
+    std::ostream s { &buffer };
+
     switch (options_.export_method) {
     case source_code_options::export_all:
-        return generate_all<T>(face, font_name);
+        generate_all<T>(face, std::move(font_name), s);
+        break;
     case source_code_options::export_selected:
-        return generate_subset<T>(face, font_name);
+        generate_subset<T>(face, std::move(font_name), s);
+        break;
     }
+
+    buffer.flush();
 }
 
 } // namespace f2b
@@ -1,6 +1,9 @@
 #ifndef FORMAT_H
 #define FORMAT_H
 
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <iomanip>
@@ -100,6 +103,66 @@ static_assert (!is_bytearray<format::python_bytes, std::string>::value, "***");
 static_assert (is_bytearray<format::python_bytes, uint8_t>::value, "***");
 
 
+//
+// Values are formatted directly into a character buffer: bytes are copied
+// from precomputed tables of "0x??," (or "\x??" for Python bytes) literals,
+// and other integers are converted with std::to_chars.
+//
+
+namespace detail {
+
+template<std::size_t Length>
+constexpr std::array<std::array<char, Length>, 256> make_byte_literals(char prefix0, char prefix1, char suffix)
+{
+    constexpr char digits[] = "0123456789ABCDEF";
+    std::array<std::array<char, Length>, 256> literals {};
+    for (std::size_t i = 0; i < literals.size(); ++i) {
+        literals[i][0] = prefix0;
+        literals[i][1] = prefix1;
+        literals[i][2] = digits[i >> 4];
+        literals[i][3] = digits[i & 0xf];
+        if constexpr (Length > 4) {
+            literals[i][4] = suffix;
+        }
+    }
+    return literals;
+}
+
+inline constexpr auto c_byte_literals = make_byte_literals<5>('0', 'x', ',');
+inline constexpr auto python_byte_literals = make_byte_literals<4>('\\', 'x', '\0');
+
+} // namespace detail
+
+/// The maximum number of characters written by \c format_value.
+static constexpr std::size_t max_value_length = 24;
+
+/**
+ * Writes the representation of \c value as an array element in the format \c T
+ * to \c out (that has room for at least \c max_value_length characters).
+ *
+ * @return A pointer past the last character written.
+ */
+template<typename T, typename V>
+inline char* format_value(char* out, V value)
+{
+    if constexpr (std::is_same<V, uint8_t>::value) {
+        if constexpr (std::is_same<T, format::python_bytes>::value) {
+            const auto& literal = detail::python_byte_literals[value];
+            std::memcpy(out, literal.data(), literal.size());
+            return out + literal.size();
+        } else {
+            const auto& literal = detail::c_byte_literals[value];
+            std::memcpy(out, literal.data(), literal.size());
+            return out + literal.size();
+        }
+    } else {
+        out = std::to_chars(out, out + max_value_length - 1, value).ptr;
+        *out++ = ',';
+        return out;
+    }
+}
+
+
 // Begin
 
 template<typename T>
@@ -255,26 +318,9 @@ inline std::ostream& operator<<(std::ostream& s, source_code::idiom::begin_array
 template<typename T, typename V>
 inline std::ostream& operator<<(std::ostream& s, source_code::idiom::value<T, V> v)
 {
-    if constexpr (std::is_same<V, uint8_t>::value) {
-        if constexpr (std::is_same<T, format::python_bytes>::value) {
-            s << "\\x"
-              << std::setw(2)
-              << std::setfill('0')
-              << std::uppercase
-              << std::hex
-              << static_cast<unsigned>(v.value);
-        } else {
-            s << "0x"
-              << std::setw(2)
-              << std::setfill('0')
-              << std::uppercase
-              << std::hex
-              << static_cast<unsigned>(v.value)
-              << ",";
-        }
-    } else {
-        s << std::resetiosflags(std::ios_base::basefield) << v.value << ",";
-    }
+    char buffer[max_value_length];
+    auto end = format_value<T, V>(buffer, v.value);
+    s.write(buffer, end - buffer);
     return s;
 }
 
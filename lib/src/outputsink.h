@@ -0,0 +1,139 @@
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace f2b
+{
+
+/**
+ * @brief A function receiving consecutive chunks of generated output.
+ */
+using output_sink = std::function<void(const char* data, std::size_t size)>;
+
+/// A sink appending output to \c s.
+inline output_sink string_sink(std::string& s)
+{
+    return [&s](const char* data, std::size_t size) { s.append(data, size); };
+}
+
+/// A sink writing output to \c s (e.g. an \c std::ofstream).
+inline output_sink stream_sink(std::ostream& s)
+{
+    return [&s](const char* data, std::size_t size) { s.write(data, static_cast<std::streamsize>(size)); };
+}
+
+/// A sink writing output to a C file handle.
+inline output_sink file_sink(std::FILE* file)
+{
+    return [file](const char* data, std::size_t size) { std::fwrite(data, 1, size, file); };
+}
+
+/**
+ * @brief A stream buffer collecting output in a fixed-size buffer
+ *        and passing it to an \c output_sink whenever the buffer fills up.
+ *
+ * The current output position (\c std::ostream::tellp) is tracked internally,
+ * so it's available without flushing or seeking the underlying output.
+ *
+ * Output must be passed on with an explicit call to \c flush, which reports
+ * errors raised by the sink. A stream writing to the buffer only sets its
+ * badbit when the sink fails, and the destructor drops unflushed output
+ * rather than calling a sink that might throw during stack unwinding.
+ */
+class sink_buffer : public std::streambuf
+{
+public:
+    static constexpr std::size_t default_buffer_size = 16 * 1024;
+
+    explicit sink_buffer(output_sink sink, std::size_t buffer_size = default_buffer_size) :
+        sink_ { std::move(sink) },
+        buffer_(buffer_size > 0 ? buffer_size : 1)
+    {
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    sink_buffer(const sink_buffer&) = delete;
+    sink_buffer& operator=(const sink_buffer&) = delete;
+
+    ~sink_buffer() override = default;
+
+    /// The number of characters written so far.
+    std::streamsize position() const noexcept { return flushed_ + (pptr() - pbase()); }
+
+    /// Passes buffered output to the sink, rethrowing the first error raised by the sink.
+    void flush()
+    {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        flush_buffer();
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if (!try_flush_buffer()) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override
+    {
+        return try_flush_buffer() ? 0 : -1;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        // Only querying the current output position is supported.
+        if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::out) == 0) {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(position());
+    }
+
+private:
+    bool try_flush_buffer()
+    {
+        if (error_) {
+            return false;
+        }
+        try {
+            flush_buffer();
+        } catch (...) {
+            error_ = std::current_exception();
+            return false;
+        }
+        return true;
+    }
+
+    void flush_buffer()
+    {
+        auto size = pptr() - pbase();
+        if (size > 0) {
+            sink_(pbase(), static_cast<std::size_t>(size));
+            flushed_ += size;
+        }
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    output_sink sink_;
+    std::vector<char> buffer_;
+    std::streamsize flushed_ { 0 };
+    // The first error raised by the sink while writing through a stream
+    std::exception_ptr error_;
+};
+
+} // namespace f2b
+
+#endif // OUTPUTSINK_H
@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 #include "fontdata.h"
 
+#include <chrono>
+#include <iostream>
+
 using namespace f2b;
 
 class TestFaceData : public font::face_reader
@@ -66,3 +69,279 @@ TEST(FaceTest, Initialization)
     }
 
 }
+
+TEST(FaceTest, Margins)
+{
+    font::glyph g1({ 4, 5 }, {
+                       0, 0, 0, 0,
+                       0, 0, 1, 0,
+                       0, 0, 1, 0,
+                       0, 0, 0, 0,
+                       0, 0, 0, 0
+                   });
+    font::glyph g2({ 4, 5 }, {
+                       0, 0, 0, 0,
+                       0, 0, 0, 0,
+                       0, 1, 0, 0,
+                       0, 1, 0, 0,
+                       0, 0, 0, 0
+                   });
+    font::face face({ 4, 5 }, { g1, g2 });
+
+    font::margins expected_margins { 1, 1 };
+    font::horizontal_margins expected_horizontal_margins { 1, 1 };
+    EXPECT_EQ(expected_margins, face.calculate_margins());
+    EXPECT_EQ(expected_horizontal_margins, face.calculate_horizontal_margins());
+
+    face.glyph_at(0).set_pixel_set({ 3, 0 }, true);
+    expected_margins = { 0, 1 };
+    expected_horizontal_margins = { 1, 0 };
+    EXPECT_EQ(expected_margins, face.calculate_margins());
+    EXPECT_EQ(expected_horizontal_margins, face.calculate_horizontal_margins());
+
+    face.clear_glyph(0);
+    expected_margins = { 2, 1 };
+    EXPECT_EQ(expected_margins, face.calculate_margins());
+
+    font::glyph g3({ 4, 5 });
+    g3.set_pixel_set({ 0, 4 }, true);
+    face.append_glyph(g3);
+    expected_margins = { 2, 0 };
+    expected_horizontal_margins = { 0, 2 };
+    EXPECT_EQ(expected_margins, face.calculate_margins());
+    EXPECT_EQ(expected_horizontal_margins, face.calculate_horizontal_margins());
+
+    face.set_glyph(font::glyph({ 4, 5 }), 2);
+    expected_margins = { 2, 1 };
+    EXPECT_EQ(expected_margins, face.calculate_margins());
+
+    font::face empty_face({ 4, 5 }, {});
+    expected_margins = { 5, 5 };
+    expected_horizontal_margins = { 4, 4 };
+    EXPECT_EQ(expected_margins, empty_face.calculate_margins());
+    EXPECT_EQ(expected_horizontal_margins, empty_face.calculate_horizontal_margins());
+}
+
+class TestPackedFaceData : public TestFaceData
+{
+public:
+    void read_row(std::size_t glyph_id, std::size_t y, font::glyph::word_type* row) const override
+    {
+        ++rows_read;
+        // deliberately leave garbage past glyph width - it must be dropped
+        row[0] = ~font::glyph::word_type { 0xf };
+        for (std::size_t x = 0; x < font_size().width; ++x) {
+            if (TestFaceData::is_pixel_set(glyph_id, { x, y })) {
+                row[0] |= font::glyph::word_type { 1 } << x;
+            }
+        }
+    }
+
+    bool is_pixel_set(std::size_t, font::point) const override
+    {
+        ADD_FAILURE() << "per-pixel access should not be used by a packed reader";
+        return false;
+    }
+
+    mutable std::size_t rows_read { 0 };
+};
+
+TEST(FaceTest, PackedReader)
+{
+    TestFaceData test_data;
+    TestPackedFaceData packed_test_data;
+
+    font::face face(test_data);
+    font::face packed_face(packed_test_data);
+
+    EXPECT_EQ(test_data.num_glyphs() * test_data.font_size().height, packed_test_data.rows_read);
+    EXPECT_EQ(face, packed_face);
+}
+
+TEST(FaceTest, CodePoints)
+{
+    TestFaceData test_data;
+    font::face face(test_data);
+
+    // Printable ASCII by default
+    EXPECT_EQ(face.code_points(), font::code_point_map::contiguous(' ', 5));
+    EXPECT_EQ(face.glyph_index(U'"'), 2);
+    EXPECT_EQ(face.code_point(4), U'$');
+    EXPECT_EQ(&face['!'], &face.glyph_at(1));
+    EXPECT_THROW(face['%'], std::out_of_range);
+
+    // Latin-1, Cyrillic and CJK, out of order and with a repeated code point
+    std::vector<char32_t> code_points { 0x416, 0xe9, 0xea, 0x4e00, 0x417, 0xe9, 0x4e01 };
+    font::code_point_map map(code_points);
+
+    std::vector<font::code_point_map::range> expected_ranges {
+        { 0xe9, 1, 2 },
+        { 0x416, 0, 1 },
+        { 0x417, 4, 1 },
+        { 0x4e00, 3, 1 },
+        { 0x4e01, 6, 1 }
+    };
+    EXPECT_EQ(map.ranges(), expected_ranges);
+
+    for (std::size_t i = 0; i < code_points.size(); ++i) {
+        if (i == 5) {
+            EXPECT_FALSE(map.code_point(i).has_value());
+        } else {
+            EXPECT_EQ(map.code_point(i), code_points[i]);
+            EXPECT_EQ(map.glyph_index(code_points[i]), i);
+        }
+    }
+    EXPECT_FALSE(map.glyph_index(' ').has_value());
+    EXPECT_FALSE(map.glyph_index(0xeb).has_value());
+    EXPECT_FALSE(map.glyph_index(0x10ffff).has_value());
+    EXPECT_FALSE(map.code_point(7).has_value());
+    EXPECT_EQ(font::code_point_map::from_ranges(map.ranges()), map);
+    EXPECT_THROW(font::code_point_map::from_ranges({ { 0x20, 0, 3 }, { 0x21, 3, 1 } }), std::invalid_argument);
+    EXPECT_THROW(font::code_point_map::from_ranges({ { 0x20, 0, 3 }, { 0x30, 2, 1 } }), std::invalid_argument);
+
+    // Appending and removing glyphs
+    face.append_glyph(font::glyph(face.glyphs_size()));
+    EXPECT_EQ(face.code_point(5), U'%');
+    face.delete_last_glyph();
+    face.delete_last_glyph();
+    EXPECT_EQ(face.code_points(), font::code_point_map::contiguous(' ', 4));
+
+    map.remove_glyph(1);
+    EXPECT_EQ(map.code_point(0), 0x416);
+    EXPECT_EQ(map.code_point(1), 0xea);
+    EXPECT_EQ(map.code_point(3), 0x417);
+    EXPECT_FALSE(map.glyph_index(0xe9).has_value());
+}
+
+TEST(FaceTest, CopyOnWrite)
+{
+    TestFaceData test_data;
+    font::face face(test_data);
+
+    auto snapshot = face;
+    EXPECT_TRUE(snapshot.shares_glyphs_with(face));
+    EXPECT_EQ(&snapshot.glyphs()[2], &face.glyphs()[2]);
+
+    // Modifying a glyph copies only that glyph
+    face.glyph_at(2).set_pixel_set({ 0, 0 }, !face.glyph_at(2).is_pixel_set({ 0, 0 }));
+    EXPECT_FALSE(snapshot.shares_glyphs_with(face));
+    EXPECT_NE(snapshot.glyph_at(2), face.glyph_at(2));
+    EXPECT_EQ(snapshot.glyph_at(2), font::face(test_data).glyph_at(2));
+    EXPECT_EQ(&snapshot.glyphs()[1], &face.glyphs()[1]);
+    EXPECT_NE(&snapshot.glyphs()[2], &face.glyphs()[2]);
+
+    // Further modifications of an unshared glyph don't copy it
+    auto glyph_address = &face.glyph_at(2);
+    face.clear_glyph(2);
+    EXPECT_EQ(&face.glyph_at(2), glyph_address);
+
+    face.exported_glyph_ids().erase(0);
+    face.append_glyph(font::glyph(face.glyphs_size()));
+    EXPECT_EQ(snapshot.num_glyphs(), 5);
+    EXPECT_EQ(snapshot.exported_glyph_ids().size(), 5);
+    EXPECT_FALSE(snapshot.code_point(5).has_value());
+    EXPECT_EQ(face.num_glyphs(), 6);
+    EXPECT_EQ(face.exported_glyph_ids().size(), 4);
+
+    // Moved-from faces stay valid
+    auto moved = std::move(snapshot);
+    EXPECT_EQ(snapshot, moved);
+}
+
+TEST(FaceTest, LazyReading)
+{
+    auto test_data = std::make_shared<TestFaceData>();
+    font::face eager(*test_data);
+    font::face face(test_data, { 0, 1, 2, 3, 4 }, 2);
+
+    EXPECT_EQ(face.num_glyphs(), 5);
+    EXPECT_EQ(face.glyphs_size(), test_data->font_size());
+    EXPECT_EQ(face.num_loaded_glyphs(), 0);
+
+    // Only the page of an accessed glyph is read
+    EXPECT_EQ(face.glyph_at(3), eager.glyph_at(3));
+    EXPECT_EQ(face.num_loaded_glyphs(), 2);
+
+    // Copies share loaded pages, and modified glyphs are copied out of them
+    auto snapshot = face;
+    face.glyph_at(0).set_pixel_set({ 0, 0 }, true);
+    EXPECT_EQ(face.num_loaded_glyphs(), 4);
+    EXPECT_NE(face.glyph_at(0), snapshot.glyph_at(0));
+    EXPECT_EQ(snapshot.glyph_at(0), eager.glyph_at(0));
+
+    face.load_all_glyphs();
+    EXPECT_EQ(face.num_loaded_glyphs(), 5);
+    EXPECT_EQ(snapshot, eager);
+    EXPECT_EQ(snapshot.calculate_margins(), eager.calculate_margins());
+    EXPECT_THROW(face.glyph_at(5), std::out_of_range);
+}
+
+TEST(FaceTest, ReportsReadErrors)
+{
+    // A reader failing to read glyphs, as with a truncated mapped file
+    struct failing_reader : public TestFaceData {
+        bool is_pixel_set(std::size_t, font::point) const override {
+            throw std::runtime_error { "read error" };
+        }
+    };
+
+    font::face face(std::make_shared<failing_reader>(), {}, 2);
+    EXPECT_THROW(face.calculate_margins(), std::runtime_error);
+    EXPECT_THROW(face.calculate_horizontal_margins(), std::runtime_error);
+
+    font::face other(std::make_shared<TestFaceData>(), {}, 2);
+    EXPECT_THROW((void)(face == other), std::runtime_error);
+}
+
+TEST(FaceTest, SnapshotPerformance)
+{
+    using clock = std::chrono::steady_clock;
+
+    font::glyph_size size { 16, 24 };
+    std::vector<font::glyph> glyphs(20000, font::glyph(size));
+    std::set<std::size_t> exported_glyph_ids;
+    for (std::size_t i = 0; i < glyphs.size(); ++i) {
+        glyphs[i].set_pixel_set({ i % size.width, i % size.height }, true);
+        exported_glyph_ids.insert(i);
+    }
+
+    // Memory held by a deep copy, as it was before glyphs were shared
+    auto glyph_bytes = sizeof(font::glyph) + size.height * font::glyph::words_per_row(size.width) * sizeof(font::glyph::word_type);
+    auto set_node_bytes = sizeof(std::size_t) + 4 * sizeof(void*);
+    auto deep_copy_bytes = glyphs.size() * (glyph_bytes + set_node_bytes);
+
+    auto start = clock::now();
+    auto deep_copy = std::make_pair(glyphs, exported_glyph_ids);
+    auto deep_copy_duration = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+
+    font::face face(size, std::move(glyphs), std::move(exported_glyph_ids));
+
+    constexpr int iterations = 1000;
+    std::vector<font::face> snapshots;
+    snapshots.reserve(iterations);
+    start = clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        snapshots.push_back(face);
+    }
+    auto snapshot_duration = std::chrono::duration<double, std::micro>(clock::now() - start).count() / iterations;
+    snapshots.resize(1);
+
+    // The first edit after a snapshot copies the array of glyph pointers and one glyph
+    start = clock::now();
+    face.glyph_at(100).set_pixel_set({ 1, 1 }, true);
+    auto first_edit_duration = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+    auto first_edit_bytes = face.num_glyphs() * sizeof(std::shared_ptr<font::glyph>) + glyph_bytes;
+
+    start = clock::now();
+    face.glyph_at(101).set_pixel_set({ 1, 1 }, true);
+    auto next_edit_duration = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+
+    EXPECT_EQ(snapshots.front().glyph_at(101), deep_copy.first[101]);
+    EXPECT_NE(face.glyph_at(101), deep_copy.first[101]);
+
+    std::cout << face.num_glyphs() << " glyphs, "
+              << "deep copy: " << deep_copy_duration << "us, ~" << deep_copy_bytes / 1024 << "KiB; "
+              << "snapshot: " << snapshot_duration << "us, " << sizeof(font::face) << "B; "
+              << "first edit: " << first_edit_duration << "us, ~" << first_edit_bytes / 1024 << "KiB; "
+              << "next edit: " << next_edit_duration << "us" << std::endl;
+}
@@ -9,3 +9,60 @@ TEST(GlyphTest, API)
 
     EXPECT_EQ(sz, font::glyph(sz).size());
 }
+
+TEST(GlyphTest, PackedRows)
+{
+    font::glyph_size sz { 70, 3 };
+    font::glyph g(sz);
+
+    EXPECT_EQ(2, g.stride());
+    EXPECT_TRUE(g.is_row_empty(0));
+
+    g.set_pixel_set({ 0, 1 }, true);
+    g.set_pixel_set({ 65, 1 }, true);
+
+    EXPECT_EQ(1u, g.row_data(1)[0]);
+    EXPECT_EQ(2u, g.row_data(1)[1]);
+    EXPECT_TRUE(g.is_pixel_set({ 65, 1 }));
+    EXPECT_FALSE(g.is_pixel_set({ 64, 1 }));
+
+    g.set_pixel_set({ 65, 1 }, false);
+    EXPECT_EQ(0u, g.row_data(1)[1]);
+
+    // bits past glyph width are dropped
+    font::glyph::word_type row[] = { ~font::glyph::word_type { 0 }, ~font::glyph::word_type { 0 } };
+    g.set_row(2, row);
+    EXPECT_EQ((font::glyph::word_type { 1 } << 6) - 1, g.row_data(2)[1]);
+}
+
+TEST(GlyphTest, PixelsRoundTrip)
+{
+    std::vector<bool> pixels {
+        0, 0, 0,
+        0, 1, 0,
+        1, 0, 1,
+        0, 0, 0
+    };
+    font::glyph g({ 3, 4 }, pixels);
+
+    EXPECT_EQ(pixels, g.pixels());
+    EXPECT_EQ(font::glyph({ 3, 4 }, pixels), g);
+    EXPECT_NE(font::glyph({ 3, 4 }), g);
+}
+
+TEST(GlyphTest, Margins)
+{
+    font::glyph g({ 3, 4 }, {
+                      0, 0, 0,
+                      0, 1, 0,
+                      1, 0, 1,
+                      0, 0, 0
+                  });
+
+    EXPECT_EQ(1, g.top_margin());
+    EXPECT_EQ(1, g.bottom_margin());
+
+    g.clear();
+    EXPECT_EQ(4, g.top_margin());
+    EXPECT_EQ(4, g.bottom_margin());
+}
@@ -1,6 +1,286 @@
 #include "gtest/gtest.h"
+#include "fontsourcecodegenerator.h"
+
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+using namespace f2b;
+
+class test_source_code_generator : public font_source_code_generator
+{
+public:
+    test_source_code_generator(source_code_options options, std::shared_ptr<glyph_fragment_cache> cache = {}):
+        font_source_code_generator(options, std::move(cache)) {};
+
+    std::string current_timestamp() override {
+        return "<timestamp>";
+    }
+};
+
+static font::face test_face()
+{
+    font::glyph_size size { 12, 5 };
+    std::vector<font::glyph> glyphs;
+    for (std::size_t i = 0; i < 40; ++i) {
+        font::glyph g { size };
+        g.set_pixel_set({ i % size.width, i % size.height }, true);
+        g.set_pixel_set({ size.width - 1 - i % size.width, 2 }, true);
+        glyphs.push_back(g);
+    }
+    return font::face(size, glyphs, { 1, 2, 3, 10, 20, 39 });
+}
 
 
 TEST(SourceCodeTest, IdiomTraits)
 {
 }
+
+TEST(SourceCodeTest, SinkBuffer)
+{
+    std::string output;
+    std::size_t num_chunks { 0 };
+    {
+        sink_buffer buffer { [&](const char* data, std::size_t size) {
+            EXPECT_LE(size, 4);
+            output.append(data, size);
+            ++num_chunks;
+        }, 4 };
+        std::ostream s { &buffer };
+
+        s << "0123456789";
+        EXPECT_EQ(s.tellp(), 10);
+        EXPECT_EQ(output, "01234567");
+        s << 'a';
+        EXPECT_EQ(s.tellp(), 11);
+        buffer.flush();
+    }
+
+    EXPECT_EQ(output, "0123456789a");
+    EXPECT_EQ(num_chunks, 3);
+}
+
+TEST(SourceCodeTest, SinkBufferReportsSinkErrors)
+{
+    std::size_t num_chunks { 0 };
+    auto failing_sink = [&](const char*, std::size_t) {
+        ++num_chunks;
+        throw std::runtime_error { "disk full" };
+    };
+
+    {
+        sink_buffer buffer { failing_sink, 4 };
+        std::ostream s { &buffer };
+
+        // The stream only records the failure, the sink isn't called again
+        s << "0123456789";
+        EXPECT_TRUE(s.bad());
+        EXPECT_EQ(num_chunks, 1u);
+        EXPECT_THROW(buffer.flush(), std::runtime_error);
+    }
+
+    {
+        // Unflushed output is dropped without calling the sink
+        sink_buffer buffer { failing_sink, 4 };
+        std::ostream s { &buffer };
+        s << "01";
+    }
+    EXPECT_EQ(num_chunks, 1u);
+}
+
+TEST(SourceCodeTest, SinkOutputMatchesString)
+{
+    auto face = test_face();
+
+    for (auto export_method : { source_code_options::export_all, source_code_options::export_selected }) {
+        source_code_options options;
+        options.export_method = export_method;
+        options.wrap_column = 20;
+        test_source_code_generator generator { options };
+
+        auto expected = generator.generate<format::c>(face);
+
+        for (std::size_t buffer_size : { 1, 7, 64, 4096 }) {
+            std::string output;
+            generator.generate<format::c>(face, string_sink(output), "font", buffer_size);
+            EXPECT_EQ(expected, output) << "buffer size: " << buffer_size;
+        }
+
+        std::ostringstream stream;
+        generator.generate<format::python_bytes>(face, stream_sink(stream));
+        EXPECT_EQ(generator.generate<format::python_bytes>(face), stream.str());
+    }
+}
+
+template<typename T, typename V>
+static std::string manipulator_value(V value)
+{
+    std::ostringstream s;
+    if constexpr (std::is_same<V, uint8_t>::value) {
+        s << (std::is_same<T, format::python_bytes>::value ? "\\x" : "0x")
+          << std::setw(2) << std::setfill('0') << std::uppercase << std::hex
+          << static_cast<unsigned>(value)
+          << (std::is_same<T, format::python_bytes>::value ? "" : ",");
+    } else {
+        s << std::resetiosflags(std::ios_base::basefield) << value << ",";
+    }
+    return s.str();
+}
+
+template<typename T, typename V>
+static std::string formatted_value(V value)
+{
+    std::ostringstream s;
+    s << source_code::idiom::value<T, V> { value };
+    return s.str();
+}
+
+TEST(SourceCodeTest, ValueFormatting)
+{
+    for (unsigned i = 0; i <= std::numeric_limits<uint8_t>::max(); ++i) {
+        auto byte = static_cast<uint8_t>(i);
+        EXPECT_EQ(formatted_value<format::c>(byte), manipulator_value<format::c>(byte));
+        EXPECT_EQ(formatted_value<format::python_list>(byte), manipulator_value<format::python_list>(byte));
+        EXPECT_EQ(formatted_value<format::python_bytes>(byte), manipulator_value<format::python_bytes>(byte));
+    }
+
+    for (uint64_t value : { uint64_t { 0 }, uint64_t { 9 }, uint64_t { 255 }, uint64_t { 65535 },
+                            uint64_t { 4294967295 }, std::numeric_limits<uint64_t>::max() }) {
+        EXPECT_EQ(formatted_value<format::c>(value), manipulator_value<format::c>(value));
+        EXPECT_EQ(formatted_value<format::c>(static_cast<uint16_t>(value)), manipulator_value<format::c>(static_cast<uint16_t>(value)));
+        EXPECT_EQ(formatted_value<format::python_list>(static_cast<uint32_t>(value)), manipulator_value<format::python_list>(static_cast<uint32_t>(value)));
+    }
+}
+
+TEST(SourceCodeTest, GlyphFragmentCache)
+{
+    auto face = test_face();
+    auto cache = std::make_shared<glyph_fragment_cache>();
+
+    source_code_options options;
+    options.export_method = source_code_options::export_all;
+    options.wrap_column = 20;
+
+    test_source_code_generator uncached { options };
+    test_source_code_generator cached { options, cache };
+
+    EXPECT_EQ(uncached.generate<format::c>(face), cached.generate<format::c>(face));
+    auto num_fragments = cache->size();
+    EXPECT_GT(num_fragments, 0);
+    EXPECT_LE(num_fragments, face.num_glyphs());
+
+    // Regenerating an unmodified face reuses all fragments
+    EXPECT_EQ(uncached.generate<format::c>(face), cached.generate<format::c>(face));
+    EXPECT_EQ(cache->size(), num_fragments);
+
+    // Only the modified glyph is added
+    face.glyph_at(5).set_pixel_set({ 11, 2 }, !face.glyph_at(5).is_pixel_set({ 11, 2 }));
+    EXPECT_EQ(uncached.generate<format::c>(face), cached.generate<format::c>(face));
+    EXPECT_EQ(cache->size(), num_fragments + 1);
+
+    // Different format and options start over
+    EXPECT_EQ(uncached.generate<format::python_bytes>(face), cached.generate<format::python_bytes>(face));
+    options.bit_numbering = source_code_options::msb;
+    EXPECT_EQ(test_source_code_generator { options }.generate<format::c>(face),
+              test_source_code_generator(options, cache).generate<format::c>(face));
+    EXPECT_LE(cache->size(), face.num_glyphs());
+}
+
+TEST(SourceCodeTest, Cancellation)
+{
+    auto face = test_face();
+    auto token = std::make_shared<cancellation_token>();
+
+    for (auto export_method : { source_code_options::export_all, source_code_options::export_selected }) {
+        source_code_options options;
+        options.export_method = export_method;
+
+        test_source_code_generator generator { options };
+        auto expected = generator.generate<format::c>(face);
+
+        // Cancel from within the sink, after the first chunk of output
+        auto cancelable = std::make_shared<cancellation_token>();
+        generator.set_cancellation_token(cancelable);
+        std::string output;
+        EXPECT_THROW(generator.generate<format::c>(face, [&](const char* data, std::size_t size) {
+            output.append(data, size);
+            cancelable->cancel();
+        }, "font", 16), generation_canceled);
+        EXPECT_LT(output.size(), expected.size());
+
+        // A canceled token stays canceled
+        EXPECT_THROW(generator.generate<format::c>(face), generation_canceled);
+
+        // A token that isn't canceled doesn't affect output
+        generator.set_cancellation_token(token);
+        EXPECT_EQ(generator.generate<format::c>(face), expected);
+    }
+}
+
+/// Cancels generation when reaching a given glyph.
+class canceling_generator : public test_source_code_generator
+{
+public:
+    canceling_generator(source_code_options options, std::size_t canceled_glyph_id):
+        test_source_code_generator(options),
+        canceled_glyph_id_ { canceled_glyph_id }
+    {
+        set_cancellation_token(token_);
+    }
+
+    std::string comment_for_glyph(std::size_t index, std::optional<char32_t>) override {
+        if (index == canceled_glyph_id_) {
+            token_->cancel();
+        }
+        return {};
+    }
+
+private:
+    std::size_t canceled_glyph_id_;
+    std::shared_ptr<cancellation_token> token_ { std::make_shared<cancellation_token>() };
+};
+
+TEST(SourceCodeTest, ParallelGeneration)
+{
+    font::glyph_size size { 19, 7 };
+    std::vector<font::glyph> glyphs;
+    std::set<std::size_t> exported_glyph_ids;
+    auto num_glyphs = font_source_code_generator::min_glyphs_for_threads + 3 * font_source_code_generator::glyphs_per_chunk + 5;
+    for (std::size_t i = 0; i < num_glyphs; ++i) {
+        font::glyph g { size };
+        g.set_pixel_set({ i % size.width, i % size.height }, true);
+        g.set_pixel_set({ (i * 7) % size.width, (i / 3) % size.height }, true);
+        glyphs.push_back(std::move(g));
+        if (i % 3 != 0) {
+            exported_glyph_ids.insert(i);
+        }
+    }
+    font::face face(size, std::move(glyphs), std::move(exported_glyph_ids));
+
+    for (auto export_method : { source_code_options::export_all, source_code_options::export_selected }) {
+        source_code_options options;
+        options.export_method = export_method;
+        options.wrap_column = 30;
+
+        test_source_code_generator serial { options };
+        auto expected_c = serial.generate<format::c>(face);
+        auto expected_python = serial.generate<format::python_bytes>(face);
+
+        for (std::size_t thread_count : { 0, 2, 3, 16 }) {
+            options.thread_count = thread_count;
+            test_source_code_generator parallel { options };
+            EXPECT_EQ(parallel.generate<format::c>(face), expected_c);
+            EXPECT_EQ(parallel.generate<format::python_bytes>(face), expected_python);
+
+            test_source_code_generator cached { options, std::make_shared<glyph_fragment_cache>() };
+            EXPECT_EQ(cached.generate<format::c>(face), expected_c);
+            EXPECT_EQ(cached.generate<format::c>(face), expected_c);
+        }
+
+        // Cancellation while formatting is passed on from formatting threads
+        options.thread_count = 4;
+        canceling_generator parallel { options, 1000 };
+        EXPECT_THROW(parallel.generate<format::c>(face), generation_canceled);
+    }
+}
@@ -0,0 +1,38 @@
+#include "gtest/gtest.h"
+
+#include <QGuiApplication>
+
+#include <memory>
+
+/**
+ * @brief Runs all app tests within a QGuiApplication, which rasterizing fonts requires.
+ *
+ * The offscreen platform is used unless QT_QPA_PLATFORM is set.
+ */
+class ApplicationEnvironment : public ::testing::Environment
+{
+public:
+    void SetUp() override
+    {
+        if (QGuiApplication::instance() != nullptr) {
+            return;
+        }
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        application_ = std::make_unique<QGuiApplication>(argc_, argv_);
+    }
+
+    void TearDown() override
+    {
+        application_.reset();
+    }
+
+private:
+    int argc_ { 1 };
+    char name_[19] = "fontedit_app_tests";
+    char *argv_[2] = { name_, nullptr };
+    std::unique_ptr<QGuiApplication> application_;
+};
+
+[[maybe_unused]] static auto *const applicationEnvironment = ::testing::AddGlobalTestEnvironment(new ApplicationEnvironment);
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "batchimport.h"
+#include "fontfaceviewmodel.h"
+#include "glyphrastercache.h"
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+TEST(BatchImportTest, Variants)
+{
+    auto variants = BatchImport::variants({ "Monaco", "Courier" }, { 8, 12 },
+                                          { FontStyle::Regular, FontStyle::BoldItalic }, "abc");
+    ASSERT_EQ(variants.size(), 8);
+
+    EXPECT_EQ(variants[0].name(), "Monaco_8pt");
+    EXPECT_EQ(variants[1].name(), "Monaco_8pt_Bold_Italic");
+    EXPECT_EQ(variants[1].font.bold(), true);
+    EXPECT_EQ(variants[1].font.italic(), true);
+    EXPECT_EQ(variants[7].name(), "Courier_12pt_Bold_Italic");
+    EXPECT_EQ(variants[7].characters, "abc");
+
+    EXPECT_EQ(fontStyleFromString("bold-italic"), FontStyle::BoldItalic);
+    EXPECT_FALSE(fontStyleFromString("oblique").has_value());
+}
+
+TEST(BatchImportTest, WritesDocumentsAndSourceCode)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    GlyphRasterCache cache;
+    BatchImportOptions options;
+    options.outputDirectory = QDir(dir.path());
+    options.sourceCodeTargets.push_back({ "c", DocumentConverter::defaultFilePattern("c") });
+    options.threadCount = 2;
+    options.cache = &cache;
+
+    auto variants = BatchImport::variants({ "Monaco" }, { 8, 12 }, { FontStyle::Regular, FontStyle::Bold }, "0123456789");
+
+    std::size_t numProgressCalls = 0;
+    BatchImport batchImport { options };
+    auto report = batchImport.run(variants, [&](std::size_t, std::size_t total) {
+        EXPECT_EQ(total, variants.size());
+        ++numProgressCalls;
+    });
+
+    EXPECT_EQ(numProgressCalls, variants.size());
+    ASSERT_EQ(report.results.size(), variants.size());
+    EXPECT_EQ(report.numImported(), variants.size());
+    EXPECT_EQ(report.numGlyphs(), variants.size() * 10);
+    EXPECT_GT(cache.size(), 0);
+
+    for (const auto& result : report.results) {
+        ASSERT_FALSE(result.error.has_value()) << result.error.value().toStdString();
+        ASSERT_EQ(result.files.size(), 2);
+        for (const auto& file : result.files) {
+            EXPECT_TRUE(QFileInfo(file).size() > 0) << file.toStdString();
+        }
+
+        FontFaceViewModel document { QDir(dir.path()).filePath(result.name + ".fontedit") };
+        EXPECT_EQ(document.face().num_glyphs(), 10);
+    }
+}
+
+TEST(BatchImportTest, DirectEngine)
+{
+    QTemporaryDir textDocumentDir;
+    QTemporaryDir directDir;
+    ASSERT_TRUE(textDocumentDir.isValid());
+    ASSERT_TRUE(directDir.isValid());
+
+    auto variants = BatchImport::variants({ "Monaco" }, { 8, 12 }, { FontStyle::Regular }, "0123456789");
+
+    BatchImportOptions options;
+    options.outputDirectory = QDir(textDocumentDir.path());
+    auto textDocumentReport = BatchImport { options }.run(variants);
+
+    options.outputDirectory = QDir(directDir.path());
+    options.renderingEngine = QFontFaceReader::engine::direct;
+    auto directReport = BatchImport { options }.run(variants);
+
+    ASSERT_EQ(directReport.numImported(), variants.size());
+    for (const auto& variant : variants) {
+        auto fileName = variant.name() + ".fontedit";
+        FontFaceViewModel textDocument { QDir(textDocumentDir.path()).filePath(fileName) };
+        FontFaceViewModel direct { QDir(directDir.path()).filePath(fileName) };
+        EXPECT_EQ(textDocument.face(), direct.face()) << fileName.toStdString();
+    }
+}
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "batchpixelchange.h"
+
+#include <vector>
+
+using namespace f2b;
+
+TEST(BatchPixelChangeTest, AddAndLookUp)
+{
+    BatchPixelChange change { { 70, 3 } };
+    EXPECT_TRUE(change.isEmpty());
+
+    change.add({ 1, 2 }, true);
+    change.add({ 2, 1 }, false);
+    change.add({ 69, 0 }, true);
+    EXPECT_FALSE(change.isEmpty());
+
+    EXPECT_EQ(change.valueAt({ 1, 2 }), true);
+    EXPECT_EQ(change.valueAt({ 2, 1 }), false);
+    EXPECT_EQ(change.valueAt({ 69, 0 }), true);
+    EXPECT_EQ(change.valueAt({ 2, 2 }), std::nullopt);
+
+    // Changing a pixel back cancels the change
+    change.add({ 1, 2 }, false);
+    EXPECT_EQ(change.valueAt({ 1, 2 }), std::nullopt);
+
+    std::vector<std::pair<std::size_t, std::size_t>> points;
+    change.forEach([&](const font::point& p, bool) { points.push_back({ p.x, p.y }); });
+    EXPECT_EQ(points, (std::vector<std::pair<std::size_t, std::size_t>> { { 69, 0 }, { 2, 1 } }));
+
+    change.clear();
+    EXPECT_TRUE(change.isEmpty());
+}
+
+TEST(BatchPixelChangeTest, ApplyAndReverse)
+{
+    font::glyph_size size { 70, 3 };
+    font::glyph original { size };
+    original.set_pixel_set({ 0, 0 }, true);
+    original.set_pixel_set({ 65, 1 }, true);
+
+    BatchPixelChange change { size };
+    change.add({ 0, 0 }, false);
+    change.add({ 65, 2 }, true);
+    change.add({ 3, 1 }, true);
+
+    auto glyph = original;
+    change.apply(glyph);
+    EXPECT_FALSE(glyph.is_pixel_set({ 0, 0 }));
+    EXPECT_TRUE(glyph.is_pixel_set({ 65, 1 }));
+    EXPECT_TRUE(glyph.is_pixel_set({ 65, 2 }));
+    EXPECT_TRUE(glyph.is_pixel_set({ 3, 1 }));
+
+    change.apply(glyph, BatchPixelChange::ChangeType::Reverse);
+    EXPECT_EQ(glyph, original);
+
+    auto reversed = change.reversed();
+    EXPECT_EQ(reversed.valueAt({ 0, 0 }), true);
+    EXPECT_EQ(reversed.valueAt({ 65, 2 }), false);
+    change.apply(glyph);
+    reversed.apply(glyph);
+    EXPECT_EQ(glyph, original);
+
+    font::glyph other { { 8, 8 } };
+    EXPECT_THROW(change.apply(other), std::invalid_argument);
+}
+
+TEST(BatchPixelChangeTest, FromMasks)
+{
+    BatchPixelChange change { { 70, 3 } };
+    change.add({ 0, 0 }, true);
+    change.add({ 65, 1 }, false);
+    change.add({ 69, 2 }, true);
+
+    EXPECT_EQ(BatchPixelChange::fromMasks(change.touched(), change.values()), change);
+
+    // Values of untouched pixels are ignored
+    font::glyph values = change.values();
+    values.set_pixel_set({ 1, 0 }, true);
+    EXPECT_EQ(BatchPixelChange::fromMasks(change.touched(), values), change);
+
+    EXPECT_THROW(BatchPixelChange::fromMasks(change.touched(), font::glyph({ 70, 4 })), std::invalid_argument);
+}
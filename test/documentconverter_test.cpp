@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+#include "documentconverter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+template<typename T>
+QString asset(const T& fileName)
+{
+    return QString("%1/%2").arg(ASSETS_DIR, fileName);
+}
+
+static QString readWithoutTimestamp(const QString& filePath)
+{
+    QFile f(filePath);
+    if (!f.open(QFileDevice::ReadOnly)) {
+        return {};
+    }
+    QStringList lines;
+    for (const auto& line : QString::fromUtf8(f.readAll()).split('\n')) {
+        if (!line.startsWith("// Created:")) {
+            lines << line;
+        }
+    }
+    return lines.join('\n');
+}
+
+TEST(DocumentConverterTest, DefaultFilePatterns)
+{
+    EXPECT_EQ(DocumentConverter::formats().size(), 4);
+    EXPECT_EQ(DocumentConverter::defaultFilePattern("c"), "{name}.c");
+    EXPECT_EQ(DocumentConverter::defaultFilePattern("arduino"), "{name}.h");
+    EXPECT_EQ(DocumentConverter::defaultFilePattern("other"), "{name}.other");
+}
+
+TEST(DocumentConverterTest, ConvertsDocument)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    f2b::source_code_options options;
+    options.export_method = f2b::source_code_options::export_all;
+
+    DocumentConverter converter { options, "font", {
+        { "c", DocumentConverter::defaultFilePattern("c") },
+        { "python-bytes", "python/{name}.py" }
+    }, QDir(dir.path()) };
+
+    auto result = converter.convert(asset("monaco8.fontedit"));
+
+    ASSERT_FALSE(result.error.has_value()) << result.error->toStdString();
+    ASSERT_EQ(result.outputs.size(), 2u);
+
+    EXPECT_EQ(result.outputs[0].filePath, QDir(dir.path()).filePath("monaco8.c"));
+    EXPECT_EQ(result.outputs[1].filePath, QDir(dir.path()).filePath("python/monaco8.py"));
+    for (const auto& output : result.outputs) {
+        EXPECT_EQ(QFileInfo(output.filePath).size(), output.size);
+    }
+
+    EXPECT_EQ(readWithoutTimestamp(result.outputs[0].filePath), readWithoutTimestamp(asset("monaco8.c-test")));
+}
+
+TEST(DocumentConverterTest, ReportsInvalidDocument)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    DocumentConverter converter { {}, "font", { { "c", "{name}.c" } }, QDir(dir.path()) };
+
+    auto result = converter.convert(QDir(dir.path()).filePath("missing.fontedit"));
+
+    EXPECT_TRUE(result.error.has_value());
+    EXPECT_TRUE(result.outputs.empty());
+    EXPECT_FALSE(QFileInfo::exists(QDir(dir.path()).filePath("missing.c")));
+}
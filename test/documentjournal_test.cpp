@@ -0,0 +1,363 @@
+#include "gtest/gtest.h"
+#include "fontfaceviewmodel.h"
+#include "documentjournal.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+using namespace f2b;
+
+static FontFaceViewModel makeDocument()
+{
+    font::glyph_size size { 8, 8 };
+    std::vector<font::glyph> glyphs(4, font::glyph(size));
+    return FontFaceViewModel { font::face(size, std::move(glyphs), { 0, 1, 2, 3 }),
+                               std::optional<QString> { "Journaled" } };
+}
+
+static BatchPixelChange pixelChange(font::point p, bool value)
+{
+    BatchPixelChange change { { 8, 8 } };
+    change.add(p, value);
+    return change;
+}
+
+TEST(DocumentJournalTest, SavesIncrementally)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+
+    auto document = makeDocument();
+    document.saveToFile(path);
+    auto documentSize = QFileInfo(path).size();
+    auto documentModified = QFileInfo(path).lastModified();
+
+    {
+        FontFaceViewModel opened { path };
+        EXPECT_EQ(opened.openJournal(), 0);
+        opened.modifyGlyph(1, pixelChange({ 2, 3 }, true));
+        opened.modifyGlyph(2, pixelChange({ 4, 5 }, true));
+        opened.modifyGlyph(2, pixelChange({ 4, 5 }, true), BatchPixelChange::ChangeType::Reverse);
+        opened.setGlyphExportedState(3, false);
+        opened.appendGlyph(font::glyph({ 8, 8 }));
+        EXPECT_TRUE(opened.isModifiedSinceSave());
+
+        ASSERT_TRUE(opened.saveIncrementally(path));
+        EXPECT_FALSE(opened.isModifiedSinceSave());
+        EXPECT_TRUE(QFile::exists(DocumentJournal::journalPath(path)));
+
+        // Unsaved edits are dropped when the document is closed
+        opened.deleteGlyph(0);
+    }
+
+    // The document file itself was left intact
+    EXPECT_EQ(QFileInfo(path).size(), documentSize);
+    EXPECT_EQ(QFileInfo(path).lastModified(), documentModified);
+
+    FontFaceViewModel reopened { path };
+    EXPECT_FALSE(reopened.isModifiedSinceSave());
+    EXPECT_EQ(reopened.openJournal(), 0);
+    EXPECT_EQ(reopened.face().num_glyphs(), 5);
+    EXPECT_TRUE(reopened.face().glyph_at(1).is_pixel_set({ 2, 3 }));
+    EXPECT_FALSE(reopened.face().glyph_at(2).is_pixel_set({ 4, 5 }));
+    EXPECT_EQ(reopened.face().exported_glyph_ids(), (std::set<std::size_t> { 0, 1, 2 }));
+
+    // A full save merges the journal into the document
+    reopened.saveToFile(path);
+    EXPECT_FALSE(QFile::exists(DocumentJournal::journalPath(path)));
+    FontFaceViewModel saved { path };
+    EXPECT_EQ(saved.face(), reopened.face());
+}
+
+TEST(DocumentJournalTest, RecoversUnsavedEdits)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+    auto crashedJournalPath = dir.filePath("crashed.journal");
+
+    makeDocument().saveToFile(path);
+
+    {
+        FontFaceViewModel opened { path };
+        opened.openJournal();
+        opened.modifyGlyph(0, pixelChange({ 1, 1 }, true));
+        ASSERT_TRUE(opened.saveIncrementally(path));
+        opened.modifyGlyph(3, pixelChange({ 7, 7 }, true));
+
+        // Keep the journal as left by a crash
+        ASSERT_TRUE(QFile::copy(journalPath, crashedJournalPath));
+    }
+    QFile::remove(journalPath);
+    ASSERT_TRUE(QFile::rename(crashedJournalPath, journalPath));
+
+    FontFaceViewModel recovered { path };
+    EXPECT_TRUE(recovered.face().glyph_at(0).is_pixel_set({ 1, 1 }));
+    EXPECT_FALSE(recovered.face().glyph_at(3).is_pixel_set({ 7, 7 }));
+
+    EXPECT_EQ(recovered.openJournal(), 1);
+    EXPECT_TRUE(recovered.face().glyph_at(3).is_pixel_set({ 7, 7 }));
+    EXPECT_TRUE(recovered.isModifiedSinceSave());
+}
+
+TEST(DocumentJournalTest, ReportsJournalOfReplacedDocument)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+    auto savedJournalPath = dir.filePath("saved.journal");
+
+    makeDocument().saveToFile(path);
+    {
+        FontFaceViewModel opened { path };
+        opened.openJournal();
+        opened.modifyGlyph(0, pixelChange({ 1, 1 }, true));
+        ASSERT_TRUE(opened.saveIncrementally(path));
+        ASSERT_TRUE(QFile::copy(journalPath, savedJournalPath));
+    }
+
+    // The document is replaced by another one
+    auto other = makeDocument();
+    other.appendGlyph(font::glyph({ 8, 8 }));
+    other.saveToFile(path);
+    ASSERT_TRUE(QFile::rename(savedJournalPath, journalPath));
+
+    // Saved edits of the previous document aren't dropped silently
+    EXPECT_THROW(FontFaceViewModel { path }, std::runtime_error);
+    EXPECT_THROW(FontFaceViewModel::mergeJournal(path), std::runtime_error);
+    EXPECT_TRUE(QFile::exists(journalPath));
+}
+
+TEST(DocumentJournalTest, CompactsJournal)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+
+    makeDocument().saveToFile(path);
+
+    FontFaceViewModel opened { path };
+    opened.openJournal();
+    font::glyph g({ 8, 8 });
+    for (int i = 0; i < 16; ++i) {
+        g.set_pixel_set({ 0, 0 }, !g.is_pixel_set({ 0, 0 }));
+        opened.modifyGlyph(1, g);
+        ASSERT_TRUE(opened.saveIncrementally(path));
+    }
+    ASSERT_TRUE(opened.shouldCompactJournal());
+    auto journalSize = QFileInfo(journalPath).size();
+
+    // Edits made while compacting stay in the journal
+    auto compaction = opened.journalCompaction();
+    ASSERT_TRUE(compaction.has_value());
+    opened.modifyGlyph(2, pixelChange({ 3, 3 }, true));
+    ASSERT_TRUE(compaction->write());
+    opened.finishJournalCompaction(compaction.value());
+    EXPECT_LT(QFileInfo(journalPath).size(), journalSize);
+    EXPECT_FALSE(opened.shouldCompactJournal());
+
+    ASSERT_TRUE(opened.saveIncrementally(path));
+
+    FontFaceViewModel reopened { path };
+    EXPECT_EQ(reopened.face(), opened.face());
+}
+
+TEST(DocumentJournalTest, RecoversInterruptedCompaction)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+    auto crashedJournalPath = dir.filePath("crashed.journal");
+
+    makeDocument().saveToFile(path);
+
+    FontFaceViewModel opened { path };
+    opened.openJournal();
+    opened.appendGlyph(font::glyph({ 8, 8 }));
+    ASSERT_TRUE(opened.saveIncrementally(path));
+
+    // Edits saved while compacting apply on top of the compacted document
+    auto compaction = opened.journalCompaction();
+    ASSERT_TRUE(compaction.has_value());
+    opened.modifyGlyph(0, pixelChange({ 2, 2 }, true));
+    ASSERT_TRUE(opened.saveIncrementally(path));
+    ASSERT_TRUE(compaction->write());
+
+    // Keep the journal as left by a crash before the compaction finished
+    ASSERT_TRUE(QFile::copy(journalPath, crashedJournalPath));
+    opened.closeJournal();
+    QFile::remove(journalPath);
+    ASSERT_TRUE(QFile::rename(crashedJournalPath, journalPath));
+
+    FontFaceViewModel reopened { path };
+    EXPECT_EQ(reopened.face(), opened.face());
+
+    // The journal is tied to the compacted document once reopened
+    reopened.openJournal();
+    reopened.closeJournal();
+    EXPECT_EQ(FontFaceViewModel { path }.face(), opened.face());
+}
+
+TEST(DocumentJournalTest, MergesJournal)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+
+    makeDocument().saveToFile(path);
+
+    FontFaceViewModel opened { path };
+    opened.openJournal();
+    opened.modifyGlyph(1, pixelChange({ 4, 4 }, true));
+    ASSERT_TRUE(opened.saveIncrementally(path));
+    opened.closeJournal();
+    ASSERT_TRUE(QFile::exists(journalPath));
+
+    FontFaceViewModel::mergeJournal(path);
+    EXPECT_FALSE(QFile::exists(journalPath));
+
+    // The document file alone holds the saved edits
+    EXPECT_EQ(FontFaceViewModel { path }.face(), opened.face());
+}
+
+TEST(DocumentJournalTest, ReportsInvalidRecords)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+    auto crashedJournalPath = dir.filePath("crashed.journal");
+
+    makeDocument().saveToFile(path);
+
+    {
+        // A saved record refers to a glyph the document doesn't have
+        DocumentJournal journal { path };
+        journal.append(DocumentJournal::DeleteGlyph { 10 });
+        ASSERT_TRUE(journal.commit());
+    }
+    EXPECT_THROW(FontFaceViewModel { path }, std::runtime_error);
+    EXPECT_TRUE(QFile::exists(journalPath));
+
+    {
+        DocumentJournal journal { path };
+        journal.append(DocumentJournal::SetGlyphExported { 0, false });
+        ASSERT_TRUE(journal.commit());
+        journal.append(DocumentJournal::DeleteGlyph { 10 });
+
+        // Keep the journal as left by a crash
+        ASSERT_TRUE(QFile::copy(journalPath, crashedJournalPath));
+    }
+    QFile::remove(journalPath);
+    ASSERT_TRUE(QFile::rename(crashedJournalPath, journalPath));
+    auto journalSize = QFileInfo(journalPath).size();
+
+    // Unsaved edits that can't be recovered are left in the journal
+    FontFaceViewModel opened { path };
+    EXPECT_THROW(opened.openJournal(), std::runtime_error);
+    EXPECT_EQ(QFileInfo(journalPath).size(), journalSize);
+}
+
+TEST(DocumentJournalTest, KeepsRecordsAppendedWhileCompactingNewJournal)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+
+    makeDocument().saveToFile(path);
+
+    // The journal file is created on first append, after the journal was opened
+    DocumentJournal journal { path };
+    journal.append(DocumentJournal::SetGlyphExported { 0, false });
+    ASSERT_TRUE(journal.commit());
+    auto offset = journal.savedSize();
+    journal.append(DocumentJournal::SetGlyphExported { 1, false });
+    ASSERT_TRUE(journal.commit());
+
+    journal.rebase(offset);
+    ASSERT_TRUE(QFile::exists(DocumentJournal::journalPath(path)));
+
+    auto contents = DocumentJournal::read(path, { 8, 8 });
+    ASSERT_TRUE(contents.has_value());
+    ASSERT_EQ(contents->saved.size(), 1u);
+    EXPECT_TRUE(std::holds_alternative<DocumentJournal::SetGlyphExported>(contents->saved.front()));
+    EXPECT_EQ(std::get<DocumentJournal::SetGlyphExported>(contents->saved.front()).index, 1u);
+}
+
+TEST(DocumentJournalTest, StoresPixelChangesAsMasks)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+
+    makeDocument().saveToFile(path);
+
+    DocumentJournal journal { path };
+    journal.append(DocumentJournal::SetGlyphExported { 0, false });
+    auto size = QFileInfo(journalPath).size();
+
+    BatchPixelChange change { { 8, 8 } };
+    for (std::size_t y = 0; y < 8; ++y) {
+        for (std::size_t x = 0; x < 8; ++x) {
+            change.add({ x, y }, (x + y) % 2 == 0);
+        }
+    }
+    journal.append(DocumentJournal::PixelChange { 1, change });
+    ASSERT_TRUE(journal.commit());
+
+    // Type, index, glyph size and two masks of 8 bytes (with their lengths), and a commit marker
+    EXPECT_EQ(QFileInfo(journalPath).size() - size, 1 + 3 * 4 + 2 * (4 + 8) + 1);
+
+    auto contents = DocumentJournal::read(path, { 8, 8 });
+    ASSERT_TRUE(contents.has_value());
+    ASSERT_EQ(contents->saved.size(), 2u);
+    EXPECT_EQ(std::get<DocumentJournal::PixelChange>(contents->saved[1]).change, change);
+}
+
+TEST(DocumentJournalTest, UpgradesPixelListJournal)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("doc.fontedit");
+    auto journalPath = DocumentJournal::journalPath(path);
+
+    makeDocument().saveToFile(path);
+
+    {
+        // A journal with pixel changes stored as (x, y, value) entries
+        QFile f(journalPath);
+        ASSERT_TRUE(f.open(QIODevice::WriteOnly));
+        QDataStream s(&f);
+        s.setVersion(QDataStream::Qt_5_7);
+        s << (quint32) 0x5e1d7a0b << (quint32) 1
+          << QFileInfo(path).size() << QFileInfo(path).lastModified().toMSecsSinceEpoch();
+        s << (quint8) 1 << (quint32) 2 << (quint32) 2
+          << (quint32) 1 << (quint32) 1 << true
+          << (quint32) 6 << (quint32) 7 << true;
+        s << (quint8) 0;
+    }
+
+    {
+        FontFaceViewModel opened { path };
+        EXPECT_TRUE(opened.face().glyph_at(2).is_pixel_set({ 1, 1 }));
+        EXPECT_TRUE(opened.face().glyph_at(2).is_pixel_set({ 6, 7 }));
+
+        // Appending rewrites the journal in the current format
+        opened.openJournal();
+        opened.modifyGlyph(3, pixelChange({ 2, 2 }, true));
+        ASSERT_TRUE(opened.saveIncrementally(path));
+    }
+
+    FontFaceViewModel reopened { path };
+    EXPECT_TRUE(reopened.face().glyph_at(2).is_pixel_set({ 6, 7 }));
+    EXPECT_TRUE(reopened.face().glyph_at(3).is_pixel_set({ 2, 2 }));
+}
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "f2b_qt_compat.h"
+#include "fontfaceviewmodel.h"
 
 #include <optional>
 #include <vector>
@@ -9,7 +10,10 @@
 #include <QByteArray>
 #include <QBuffer>
 #include <QDataStream>
+#include <QtEndian>
 #include <QString>
+#include <QFileInfo>
+#include <QTemporaryDir>
 
 using namespace f2b;
 
@@ -126,3 +130,132 @@ TEST(SerializationTest, font_face)
 
     EXPECT_EQ(data, deserialized);
 }
+
+TEST(SerializationTest, font_face_code_points)
+{
+    font::glyph glyph({2, 3}, { false, true, false, false, true, true });
+    font::face data({2, 3}, { glyph, glyph, glyph, glyph }, { 0, 2 },
+                    font::code_point_map({ 0x416, 0xe9, 0xea, 0x4e00 }));
+    font::face deserialized;
+
+    serialize_and_deserialize(data, deserialized);
+
+    EXPECT_EQ(data, deserialized);
+    EXPECT_EQ(data.exported_glyph_ids(), deserialized.exported_glyph_ids());
+    EXPECT_EQ(data.code_points(), deserialized.code_points());
+}
+
+TEST(SerializationTest, packed_font_face)
+{
+    // Wider than a glyph word, with an unaligned last byte
+    font::glyph_size size { 70, 3 };
+    font::glyph glyph(size);
+    glyph.set_pixel_set({ 0, 0 }, true);
+    glyph.set_pixel_set({ 8, 1 }, true);
+    glyph.set_pixel_set({ 63, 1 }, true);
+    glyph.set_pixel_set({ 64, 2 }, true);
+    glyph.set_pixel_set({ 69, 2 }, true);
+
+    font::face data(size, { glyph, font::glyph(size), glyph, glyph, glyph }, { 0, 2, 3 },
+                    font::code_point_map({ 0x416, 0xe9, 0xea, 0xeb, 0x4e00 }));
+
+    auto packed = pack_face(data);
+    // Header, 2 exported ranges, 3 code point ranges and 9 bytes per row
+    EXPECT_EQ(packed.size(), 4 * (5 + 2 * 2 + 3 * 3) + 5 * 3 * 9);
+
+    auto deserialized = unpack_face(packed);
+    ASSERT_TRUE(deserialized.has_value());
+    EXPECT_EQ(data, deserialized.value());
+    EXPECT_EQ(data.exported_glyph_ids(), deserialized->exported_glyph_ids());
+    EXPECT_EQ(data.code_points(), deserialized->code_points());
+
+    packed.chop(1);
+    EXPECT_FALSE(unpack_face(packed).has_value());
+}
+
+static QByteArray packed_words(std::initializer_list<quint32> words)
+{
+    QByteArray data;
+    for (auto word : words) {
+        auto bytes = qToLittleEndian(word);
+        data.append(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+    }
+    return data;
+}
+
+TEST(SerializationTest, packed_font_face_invalid_header)
+{
+    // 2 glyphs of 8x1 pixels, no exported glyphs, one code point range
+    auto packed = [](quint32 first_code_point, quint32 first_glyph, quint32 length) {
+        return packed_words({ 8, 1, 2, 0, 1, first_code_point, first_glyph, length }) + QByteArray(2, '\0');
+    };
+
+    EXPECT_TRUE(unpack_face(packed(0x41, 0, 2)).has_value());
+    // Code points assigned past the last glyph
+    EXPECT_FALSE(unpack_face(packed(0x41, 1, 2)).has_value());
+    // Code points past the largest code point
+    EXPECT_FALSE(unpack_face(packed(0xffffffff, 0, 2)).has_value());
+
+    // A huge number of empty glyphs
+    EXPECT_TRUE(unpack_face(packed_words({ 0, 0, 4, 0, 0 })).has_value());
+    EXPECT_FALSE(unpack_face(packed_words({ 0, 0, 0xffffffff, 0, 0 })).has_value());
+}
+
+TEST(SerializationTest, document_formats)
+{
+    // monaco8.fontedit is a version 2 document
+    FontFaceViewModel document { QString("%1/monaco8.fontedit").arg(ASSETS_DIR) };
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("monaco8.fontedit");
+    document.saveToFile(path);
+
+    FontFaceViewModel reloaded { path };
+    EXPECT_EQ(document.face(), reloaded.face());
+    EXPECT_EQ(document.face().exported_glyph_ids(), reloaded.face().exported_glyph_ids());
+    EXPECT_EQ(document.face().code_points(), reloaded.face().code_points());
+    EXPECT_EQ(document.faceInfo().fontName, reloaded.faceInfo().fontName);
+
+    EXPECT_LT(QFileInfo(path).size(), QFileInfo(QString("%1/monaco8.fontedit").arg(ASSETS_DIR)).size() / 4);
+}
+
+TEST(SerializationTest, mapped_document)
+{
+    font::glyph_size size { 12, 16 };
+    std::vector<font::glyph> glyphs;
+    std::set<std::size_t> exported_glyph_ids;
+    for (std::size_t i = 0; i < FontFaceViewModel::lazyLoadingThreshold; ++i) {
+        font::glyph g(size);
+        g.set_pixel_set({ i % size.width, (i / size.width) % size.height }, true);
+        glyphs.push_back(std::move(g));
+        if (i % 3 == 0) {
+            exported_glyph_ids.insert(i);
+        }
+    }
+    FontFaceViewModel document { font::face(size, std::move(glyphs), std::move(exported_glyph_ids)),
+                                 std::optional<QString> { "Large" } };
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("large.fontedit");
+    document.saveToFile(path);
+
+    // Glyphs of a large document are read only when accessed
+    FontFaceViewModel mapped { path };
+    EXPECT_EQ(mapped.face().num_glyphs(), document.face().num_glyphs());
+    EXPECT_EQ(mapped.face().num_loaded_glyphs(), 0);
+    EXPECT_EQ(mapped.face().glyph_at(0), document.face().glyph_at(0));
+    EXPECT_LT(mapped.face().num_loaded_glyphs(), mapped.face().num_glyphs());
+    EXPECT_EQ(mapped.faceInfo().fontName, "Large");
+
+    EXPECT_EQ(mapped.face(), document.face());
+    EXPECT_EQ(mapped.face().exported_glyph_ids(), document.face().exported_glyph_ids());
+    EXPECT_EQ(mapped.face().code_points(), document.face().code_points());
+
+    // Saving over a mapped document
+    mapped.face().clear_glyph(1);
+    mapped.saveToFile(path);
+    FontFaceViewModel reloaded { path };
+    EXPECT_EQ(reloaded.face(), mapped.face());
+}
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "glyphdelta.h"
+
+using namespace f2b;
+
+TEST(GlyphDeltaTest, AppliesBothWays)
+{
+    font::glyph_size size { 70, 5 };
+    font::glyph from { size };
+    from.set_pixel_set({ 0, 0 }, true);
+    from.set_pixel_set({ 69, 4 }, true);
+
+    auto to = from;
+    to.set_pixel_set({ 0, 0 }, false);
+    to.set_pixel_set({ 64, 2 }, true);
+    to.set_pixel_set({ 3, 3 }, true);
+
+    GlyphDelta delta { from, to };
+    EXPECT_FALSE(delta.isEmpty());
+    EXPECT_EQ(delta.size(), size);
+
+    auto glyph = from;
+    delta.apply(glyph);
+    EXPECT_EQ(glyph, to);
+    delta.apply(glyph);
+    EXPECT_EQ(glyph, from);
+
+    // A pixel change turning either glyph into the other one
+    glyph = to;
+    delta.pixelChange(glyph).apply(glyph);
+    EXPECT_EQ(glyph, from);
+
+    EXPECT_TRUE(GlyphDelta(from, from).isEmpty());
+    EXPECT_THROW(delta.apply(glyph = font::glyph({ 8, 8 })), std::invalid_argument);
+}
+
+TEST(GlyphDeltaTest, Combines)
+{
+    font::glyph_size size { 8, 8 };
+    font::glyph a { size };
+    auto b = a;
+    b.set_pixel_set({ 1, 1 }, true);
+    auto c = b;
+    c.set_pixel_set({ 1, 1 }, false);
+    c.set_pixel_set({ 7, 7 }, true);
+
+    GlyphDelta delta { a, b };
+    delta ^= GlyphDelta { b, c };
+
+    auto glyph = a;
+    delta.apply(glyph);
+    EXPECT_EQ(glyph, c);
+}
+
+TEST(GlyphDeltaTest, CompressesSmallChanges)
+{
+    font::glyph_size size { 256, 256 };
+    font::glyph from { size };
+    auto to = from;
+    to.set_pixel_set({ 100, 100 }, true);
+    to.set_pixel_set({ 101, 100 }, true);
+
+    GlyphDelta delta { from, to };
+    EXPECT_LT(delta.memoryUsage(), sizeof(GlyphDelta) + 4 * sizeof(GlyphDelta::word_type));
+
+    auto full = GlyphDelta::ofGlyph(to);
+    font::glyph glyph { size };
+    full.apply(glyph);
+    EXPECT_EQ(glyph, to);
+}
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "glyphpreviewatlas.h"
+#include "common.h"
+
+using namespace f2b;
+
+TEST(GlyphPreviewAtlasTest, TilesHoldGlyphsWithoutMargins)
+{
+    font::glyph_size size { 70, 5 };
+    font::margins margins { 1, 1 };
+    GlyphPreviewAtlas atlas { size, 10, margins };
+
+    EXPECT_EQ(atlas.numGlyphs(), 10u);
+    EXPECT_EQ(atlas.tileSize(), QSize(70, 3));
+    EXPECT_FALSE(atlas.containsGlyph(3));
+
+    font::glyph glyph { size };
+    glyph.set_pixel_set({ 0, 0 }, true);   // top margin
+    glyph.set_pixel_set({ 0, 1 }, true);
+    glyph.set_pixel_set({ 9, 2 }, true);
+    glyph.set_pixel_set({ 69, 3 }, true);
+    atlas.setGlyph(3, glyph);
+    EXPECT_TRUE(atlas.containsGlyph(3));
+
+    auto tile = atlas.tileRect(3);
+    EXPECT_EQ(tile.size(), atlas.tileSize());
+    EXPECT_EQ(tile.x() % 8, 0);
+
+    const auto& image = atlas.image(true);
+    for (int y = 0; y < tile.height(); ++y) {
+        for (int x = 0; x < tile.width(); ++x) {
+            auto isSet = glyph.is_pixel_set({ static_cast<std::size_t>(x), static_cast<std::size_t>(y) + margins.top });
+            EXPECT_EQ(image.pixelIndex(tile.x() + x, tile.y() + y), isSet ? 1 : 0) << x << "," << y;
+        }
+    }
+
+    // Other tiles stay empty
+    auto other = atlas.tileRect(4);
+    for (int x = 0; x < other.width(); ++x) {
+        EXPECT_EQ(image.pixelIndex(other.x() + x, other.y()), 0);
+    }
+}
+
+TEST(GlyphPreviewAtlasTest, ColorVariants)
+{
+    GlyphPreviewAtlas atlas { { 8, 8 }, 1, {} };
+    font::glyph glyph { { 8, 8 } };
+    glyph.set_pixel_set({ 2, 2 }, true);
+    atlas.setGlyph(0, glyph);
+
+    auto tile = atlas.tileRect(0);
+    EXPECT_EQ(atlas.image(true).pixel(tile.x() + 2, tile.y() + 2), Color::activeGlyph);
+    EXPECT_EQ(atlas.image(false).pixel(tile.x() + 2, tile.y() + 2), Color::inactiveGlyph);
+
+    // Replacing a glyph updates its tile in both variants
+    atlas.setGlyph(0, font::glyph { { 8, 8 } });
+    EXPECT_EQ(atlas.image(true).pixelIndex(tile.x() + 2, tile.y() + 2), 0);
+    EXPECT_EQ(atlas.image(false).pixelIndex(tile.x() + 2, tile.y() + 2), 0);
+}
+
+TEST(GlyphPreviewAtlasTest, RejectsMismatchedGlyphs)
+{
+    GlyphPreviewAtlas atlas { { 8, 8 }, 2, {} };
+    EXPECT_THROW(atlas.setGlyph(0, font::glyph { { 7, 8 } }), std::invalid_argument);
+    EXPECT_THROW(atlas.setGlyph(2, font::glyph { { 8, 8 } }), std::out_of_range);
+}
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include "glyphrastercache.h"
+
+#include <QTemporaryDir>
+
+using namespace f2b;
+
+static font::glyph test_glyph(std::size_t pixel)
+{
+    font::glyph g { font::glyph_size { 5, 3 } };
+    g.set_pixel_set({ pixel % 5, pixel / 5 }, true);
+    return g;
+}
+
+TEST(GlyphRasterCacheTest, LookUp)
+{
+    GlyphRasterCache cache;
+
+    EXPECT_FALSE(cache.glyph("font", 'a').has_value());
+
+    cache.insert("font", 'a', test_glyph(1));
+    cache.insert("other font", 'a', test_glyph(2));
+
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.glyph("font", 'a'), test_glyph(1));
+    EXPECT_EQ(cache.glyph("other font", 'a'), test_glyph(2));
+    EXPECT_FALSE(cache.glyph("font", 'b').has_value());
+
+    cache.insert("font", 'a', test_glyph(3));
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.glyph("font", 'a'), test_glyph(3));
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_FALSE(cache.glyph("font", 'a').has_value());
+}
+
+TEST(GlyphRasterCacheTest, FontKey)
+{
+    QFont font("Monaco", 12);
+    font.setStyleHint(QFont::TypeWriter);
+    QFont bold = font;
+    bold.setBold(true);
+
+    auto key = GlyphRasterCache::fontKey(font, { 8, 16 }, QFontFaceReader::engine::text_document);
+    EXPECT_EQ(key, GlyphRasterCache::fontKey(QFont(font), { 8, 16 }, QFontFaceReader::engine::text_document));
+    EXPECT_TRUE(key.endsWith(QString("Qt %1").arg(qVersion())));
+
+    EXPECT_NE(key, GlyphRasterCache::fontKey(font, { 8, 16 }, QFontFaceReader::engine::direct));
+    EXPECT_NE(key, GlyphRasterCache::fontKey(font, { 8, 17 }, QFontFaceReader::engine::text_document));
+    EXPECT_NE(key, GlyphRasterCache::fontKey(bold, { 8, 16 }, QFontFaceReader::engine::text_document));
+}
+
+TEST(GlyphRasterCacheTest, EvictsLeastRecentlyUsed)
+{
+    GlyphRasterCache cache { {}, 3 };
+
+    cache.insert("font", 'a', test_glyph(0));
+    cache.insert("font", 'b', test_glyph(1));
+    cache.insert("font", 'c', test_glyph(2));
+
+    // Make 'a' the most recently used entry
+    EXPECT_TRUE(cache.glyph("font", 'a').has_value());
+
+    cache.insert("font", 'd', test_glyph(3));
+
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_TRUE(cache.glyph("font", 'a').has_value());
+    EXPECT_FALSE(cache.glyph("font", 'b').has_value());
+    EXPECT_TRUE(cache.glyph("font", 'c').has_value());
+    EXPECT_TRUE(cache.glyph("font", 'd').has_value());
+}
+
+TEST(GlyphRasterCacheTest, Persistence)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    auto path = dir.filePath("glyphs.cache");
+
+    {
+        GlyphRasterCache cache { path, 2 };
+        cache.insert("font", 'a', test_glyph(0));
+        cache.insert("font", 'b', test_glyph(1));
+        cache.glyph("font", 'a');
+        cache.save();
+    }
+
+    {
+        GlyphRasterCache cache { path, 2 };
+        EXPECT_EQ(cache.glyph("font", 'a'), test_glyph(0));
+        EXPECT_EQ(cache.glyph("font", 'b'), test_glyph(1));
+    }
+
+    {
+        // Only the most recently used entries are loaded into a smaller cache
+        GlyphRasterCache cache { path, 1 };
+        EXPECT_EQ(cache.glyph("font", 'a'), test_glyph(0));
+        EXPECT_FALSE(cache.glyph("font", 'b').has_value());
+    }
+}
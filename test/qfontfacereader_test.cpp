@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+#include "qfontfacereader.h"
+#include "glyphrastercache.h"
+#include "utf8.h"
+
+#include <chrono>
+#include <iterator>
+#include <iostream>
+#include <vector>
+#include <numeric>
+
+#include <QFont>
+
+using namespace f2b;
+
+static std::string code_point_range(uint32_t first, uint32_t last)
+{
+    std::string text;
+    for (auto cp = first; cp <= last; ++cp) {
+        utf8::append(cp, std::back_inserter(text));
+    }
+    return text;
+}
+
+template<typename F>
+static std::chrono::high_resolution_clock::rep mean_duration(F&& f)
+{
+    std::vector<std::chrono::high_resolution_clock::rep> durations;
+    for (int i = 0; i < 3; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        auto end = std::chrono::high_resolution_clock::now();
+        durations.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count());
+    }
+    return std::accumulate(durations.begin(), durations.end(), 0) / static_cast<long>(durations.size());
+}
+
+TEST(QFontFaceReaderTest, ChunkedImportMatchesSingleDocument)
+{
+    QFont font("Monaco", 24);
+    font.setStyleHint(QFont::TypeWriter);
+
+    std::string texts[] = { {}, code_point_range(0x20, 0x52f) };
+
+    for (const auto& text : texts) {
+        for (auto engine : { QFontFaceReader::engine::text_document, QFontFaceReader::engine::direct }) {
+            QFontFaceReader single { font, text, {}, { 1, engine } };
+            QFontFaceReader chunked { font, text, {}, { 4, engine } };
+
+            EXPECT_EQ(single.num_glyphs(), chunked.num_glyphs());
+            EXPECT_EQ(font::face(single), font::face(chunked));
+        }
+    }
+}
+
+TEST(QFontFaceReaderTest, DirectRasterizerMatchesTextDocument)
+{
+    QFont fonts[] = { QFont("Monaco", 8), QFont("Monaco", 24), QFont("Courier", 13) };
+    fonts[2].setBold(true);
+
+    std::string texts[] = { {}, code_point_range(0xa0, 0x17f) };
+
+    for (auto& font : fonts) {
+        font.setStyleHint(QFont::TypeWriter);
+
+        for (const auto& text : texts) {
+            font::face text_document_face(QFontFaceReader { font, text, {}, { 1, QFontFaceReader::engine::text_document } });
+            font::face direct_face(QFontFaceReader { font, text, {}, { 1, QFontFaceReader::engine::direct } });
+
+            ASSERT_EQ(text_document_face.num_glyphs(), direct_face.num_glyphs());
+            for (std::size_t i = 0; i < direct_face.num_glyphs(); ++i) {
+                EXPECT_EQ(text_document_face.glyph_at(i), direct_face.glyph_at(i))
+                        << font.toString().toStdString() << " glyph: " << i << std::endl
+                        << "text document:" << std::endl << text_document_face.glyph_at(i)
+                        << "direct:" << std::endl << direct_face.glyph_at(i);
+            }
+        }
+    }
+}
+
+TEST(QFontFaceReaderTest, DirectRasterizerBaselineDoesNotDependOnText)
+{
+    QFont font("Monaco", 24);
+    font.setStyleHint(QFont::TypeWriter);
+
+    // The first glyph likely comes from a fallback font with different metrics
+    auto text = code_point_range(0x4e00, 0x4e00) + "A";
+    font::face with_fallback { QFontFaceReader { font, text, {}, { 1, QFontFaceReader::engine::direct } } };
+    font::face single { QFontFaceReader { font, "A", with_fallback.glyphs_size(), { 1, QFontFaceReader::engine::direct } } };
+
+    ASSERT_EQ(with_fallback.num_glyphs(), 2u);
+    EXPECT_EQ(with_fallback.glyph_at(1), single.glyph_at(0));
+}
+
+TEST(QFontFaceReaderTest, CachedImportMatchesRasterized)
+{
+    QFont font("Monaco", 24);
+    font.setStyleHint(QFont::TypeWriter);
+
+    auto text = code_point_range(0x20, 0x17f);
+    font::face rasterized { QFontFaceReader { font, text } };
+
+    GlyphRasterCache cache;
+    QFontFaceReader::options opts;
+    opts.cache = &cache;
+
+    // Populate the cache with a subset of glyphs, then import glyphs partially from cache
+    font::face subset { QFontFaceReader { font, code_point_range(0x40, 0x7f), rasterized.glyphs_size(), opts } };
+    EXPECT_EQ(cache.size(), 0x40);
+
+    font::face partially_cached { QFontFaceReader { font, text, rasterized.glyphs_size(), opts } };
+    EXPECT_EQ(rasterized, partially_cached);
+    EXPECT_EQ(cache.size(), rasterized.num_glyphs());
+
+    font::face cached { QFontFaceReader { font, text, rasterized.glyphs_size(), opts } };
+    EXPECT_EQ(rasterized, cached);
+}
+
+TEST(QFontFaceReaderTest, CacheKeepsEnginesApart)
+{
+    QFont font("Monaco", 24);
+    font.setStyleHint(QFont::TypeWriter);
+
+    auto text = code_point_range(0x20, 0x17f);
+    QFontFaceReader::options text_document_opts { 1, QFontFaceReader::engine::text_document };
+    QFontFaceReader::options direct_opts { 1, QFontFaceReader::engine::direct };
+    font::face text_document { QFontFaceReader { font, text, {}, text_document_opts } };
+    font::face direct { QFontFaceReader { font, text, text_document.glyphs_size(), direct_opts } };
+
+    GlyphRasterCache cache;
+    text_document_opts.cache = &cache;
+    direct_opts.cache = &cache;
+
+    // Every import with one engine must not be served glyphs rasterized by the other
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(text_document, font::face(QFontFaceReader { font, text, text_document.glyphs_size(), text_document_opts }));
+        EXPECT_EQ(direct, font::face(QFontFaceReader { font, text, text_document.glyphs_size(), direct_opts }));
+    }
+    EXPECT_EQ(cache.size(), 2 * text_document.num_glyphs());
+}
+
+TEST(QFontFaceReaderTest, ImportPerformance)
+{
+    QFont font("Monaco", 24);
+    font.setStyleHint(QFont::TypeWriter);
+
+    std::pair<const char *, std::string> texts[] = {
+        { "ASCII", {} },
+        { "Latin/Cyrillic", code_point_range(0x20, 0x52f) },
+        { "CJK", code_point_range(0x4e00, 0x5dff) }
+    };
+
+    for (const auto& [name, text] : texts) {
+        auto single = mean_duration([&] {
+            font::face f(QFontFaceReader { font, text, {}, { 1, QFontFaceReader::engine::text_document } });
+        });
+        auto parallel = mean_duration([&] {
+            font::face f(QFontFaceReader { font, text, {}, { 0, QFontFaceReader::engine::text_document } });
+        });
+        auto direct = mean_duration([&] {
+            font::face f(QFontFaceReader { font, text, {}, { 1, QFontFaceReader::engine::direct } });
+        });
+        auto direct_parallel = mean_duration([&] {
+            font::face f(QFontFaceReader { font, text, {}, { 0, QFontFaceReader::engine::direct } });
+        });
+
+        std::cout << name << " import - single document: " << single << "ms, "
+                  << "parallel: " << parallel << "ms, "
+                  << "direct: " << direct << "ms, "
+                  << "direct parallel: " << direct_parallel << "ms" << std::endl;
+    }
+}
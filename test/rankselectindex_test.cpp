@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "rankselectindex.h"
+
+#include <random>
+#include <set>
+#include <vector>
+
+static void expectMatches(const RankSelectIndex& index, const std::set<std::size_t>& ones)
+{
+    ASSERT_EQ(index.count(), ones.size());
+
+    std::size_t rank = 0;
+    for (std::size_t i = 0; i < index.size(); ++i) {
+        EXPECT_EQ(index.rank(i), rank);
+        auto isSet = ones.count(i) == 1;
+        EXPECT_EQ(index.test(i), isSet);
+        if (isSet) {
+            EXPECT_EQ(index.select(rank), i);
+            ++rank;
+        }
+    }
+    EXPECT_EQ(index.rank(index.size()), ones.size());
+}
+
+TEST(RankSelectIndexTest, Empty)
+{
+    RankSelectIndex index;
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(index.count(), 0u);
+    EXPECT_EQ(index.rank(0), 0u);
+    EXPECT_THROW(index.select(0), std::out_of_range);
+    EXPECT_THROW(index.test(0), std::out_of_range);
+}
+
+TEST(RankSelectIndexTest, RankAndSelect)
+{
+    std::set<std::size_t> ones { 0, 1, 63, 64, 511, 512, 1000, 1999 };
+    RankSelectIndex index { 2000, ones };
+    expectMatches(index, ones);
+
+    EXPECT_THROW(index.rank(2001), std::out_of_range);
+    EXPECT_THROW(index.select(ones.size()), std::out_of_range);
+}
+
+TEST(RankSelectIndexTest, AllSet)
+{
+    std::set<std::size_t> ones;
+    for (std::size_t i = 0; i < 3000; ++i) {
+        ones.insert(i);
+    }
+    RankSelectIndex index { 3000, ones };
+    expectMatches(index, ones);
+}
+
+TEST(RankSelectIndexTest, SetUpdatesIncrementally)
+{
+    std::mt19937 generator { 42 };
+    std::uniform_int_distribution<std::size_t> position { 0, 4999 };
+    std::bernoulli_distribution value { 0.6 };
+
+    std::set<std::size_t> ones;
+    RankSelectIndex index { 5000, ones };
+    for (int i = 0; i < 4000; ++i) {
+        auto p = position(generator);
+        auto v = value(generator);
+        index.set(p, v);
+        if (v) {
+            ones.insert(p);
+        } else {
+            ones.erase(p);
+        }
+    }
+    expectMatches(index, ones);
+}
@@ -1,15 +1,19 @@
 #include "gtest/gtest.h"
 #include "fontsourcecodegenerator.h"
 #include "fontfaceviewmodel.h"
+#include "f2b_qt_compat.h"
 #include <gsl/gsl>
 
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <numeric>
 
 #include <QString>
 #include <QFile>
+#include <QBuffer>
 
 using namespace f2b;
 
@@ -29,6 +33,40 @@ public:
     }
 };
 
+template<typename F>
+static double mean_duration_ms(F&& f, int iterations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+static font::face synthetic_face(std::size_t num_glyphs)
+{
+    font::glyph_size size { 16, 24 };
+    std::vector<font::glyph> glyphs;
+    std::set<std::size_t> exported_glyph_ids;
+    glyphs.reserve(num_glyphs);
+
+    for (std::size_t i = 0; i < num_glyphs; ++i) {
+        font::glyph g { size };
+        for (std::size_t y = 0; y < size.height; ++y) {
+            for (std::size_t x = 0; x < size.width; ++x) {
+                g.set_pixel_set({ x, y }, (x * 7 + y * 13 + i) % 5 < 2);
+            }
+        }
+        glyphs.push_back(std::move(g));
+        if (i % 2 == 0) {
+            exported_glyph_ids.insert(i);
+        }
+    }
+
+    return font::face(size, std::move(glyphs), std::move(exported_glyph_ids));
+}
+
 TEST(SourceCodeGeneratorTest, GeneratorAll)
 {
     auto faceFileName = asset("monaco8.fontedit");
@@ -88,6 +126,31 @@ TEST(SourceCodeGeneratorTest, GeneratorSubset)
     ASSERT_EQ(sourceCode, referenceSourceCode);
 }
 
+TEST(SourceCodeGeneratorTest, GeneratorDeviceSink)
+{
+    auto faceFileName = asset("monaco8.fontedit");
+    auto faceVM = std::make_unique<FontFaceViewModel>(faceFileName);
+
+    source_code_options options;
+    options.export_method = f2b::source_code_options::export_all;
+
+    test_source_code_generator g(options);
+
+    QByteArray output;
+    QBuffer buffer(&output);
+    buffer.open(QIODevice::WriteOnly);
+    g.generate<format::c>(faceVM->face(), qiodevice_sink(buffer));
+    buffer.close();
+
+    auto sourceCodeFileName = asset("monaco8.c-test");
+    QFile f(sourceCodeFileName);
+    f.open(QFileDevice::ReadOnly);
+    auto referenceSourceCode = f.readAll().toStdString();
+    f.close();
+
+    ASSERT_EQ(output.toStdString(), referenceSourceCode);
+}
+
 TEST(SourceCodeGeneratorTest, GeneratorPerformance)
 {
     auto faceFileName = asset("jetbrains260.fontedit");
@@ -119,3 +182,51 @@ TEST(SourceCodeGeneratorTest, GeneratorPerformance)
     }
 
 }
+
+TEST(SourceCodeGeneratorTest, FormattingPerformance)
+{
+    auto faceVM = std::make_unique<FontFaceViewModel>(asset("monaco8.fontedit"));
+
+    std::pair<const char *, font::face> faces[] = {
+        { "monaco8", faceVM->face() },
+        { "synthetic 10k glyphs", synthetic_face(10000) }
+    };
+
+    for (const auto& [name, face] : faces) {
+        auto iterations = face.num_glyphs() > 1000 ? 5 : 200;
+
+        for (auto export_method : { source_code_options::export_all, source_code_options::export_selected }) {
+            source_code_options options;
+            options.export_method = export_method;
+            test_source_code_generator g(options);
+
+            auto c = mean_duration_ms([&] { g.generate<format::c>(face); }, iterations);
+            auto python_bytes = mean_duration_ms([&] { g.generate<format::python_bytes>(face); }, iterations);
+
+            std::cout << name << ", export method " << export_method << ": "
+                      << "c: " << c << "ms, python bytes: " << python_bytes << "ms" << std::endl;
+        }
+
+        // Compare the byte formatter with iostream manipulators used previously
+        // on the same amount of glyph data.
+        auto bytes_per_glyph = face.glyphs_size().height * ((face.glyphs_size().width + 7) / 8);
+        auto num_bytes = face.num_glyphs() * bytes_per_glyph;
+
+        auto manipulators = mean_duration_ms([&] {
+            std::ostringstream s;
+            for (std::size_t i = 0; i < num_bytes; ++i) {
+                s << "0x" << std::setw(2) << std::setfill('0') << std::uppercase << std::hex
+                  << static_cast<unsigned>(i & 0xff) << ",";
+            }
+        }, iterations);
+        auto lookup_table = mean_duration_ms([&] {
+            std::ostringstream s;
+            for (std::size_t i = 0; i < num_bytes; ++i) {
+                s << source_code::idiom::value<format::c, uint8_t> { static_cast<uint8_t>(i & 0xff) };
+            }
+        }, iterations);
+
+        std::cout << name << ", " << num_bytes << " bytes: "
+                  << "manipulators: " << manipulators << "ms, lookup table: " << lookup_table << "ms" << std::endl;
+    }
+}
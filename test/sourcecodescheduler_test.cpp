@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "sourcecodescheduler.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include <mutex>
+#include <vector>
+
+using namespace f2b;
+
+static font::face test_face(std::size_t num_glyphs)
+{
+    font::glyph_size size { 16, 24 };
+    std::vector<font::glyph> glyphs;
+    glyphs.reserve(num_glyphs);
+    for (std::size_t i = 0; i < num_glyphs; ++i) {
+        font::glyph g { size };
+        g.set_pixel_set({ i % size.width, i % size.height }, true);
+        glyphs.push_back(std::move(g));
+    }
+    return font::face(size, std::move(glyphs));
+}
+
+TEST(SourceCodeSchedulerTest, PublishesLatestResult)
+{
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(4);
+
+    std::mutex mutex;
+    std::vector<std::pair<quint64, QString>> results;
+
+    SourceCodeScheduler scheduler { &threadPool };
+    scheduler.setResultHandler([&](const QString& sourceCode, quint64 epoch) {
+        std::scoped_lock lock { mutex };
+        results.emplace_back(epoch, sourceCode);
+    });
+
+    source_code_options options;
+    options.export_method = source_code_options::export_all;
+
+    auto face = test_face(5000);
+    quint64 lastEpoch { 0 };
+    for (int i = 1; i <= 20; ++i) {
+        auto epoch = scheduler.submit(face, options, QString::fromStdString(std::string(format::c::identifier)),
+                                      QString("font_%1").arg(i));
+        EXPECT_GT(epoch, lastEpoch);
+        lastEpoch = epoch;
+    }
+    threadPool.waitForDone();
+
+    EXPECT_EQ(scheduler.latestEpoch(), lastEpoch);
+    EXPECT_EQ(scheduler.publishedEpoch(), lastEpoch);
+
+    ASSERT_FALSE(results.empty());
+    for (std::size_t i = 1; i < results.size(); ++i) {
+        EXPECT_LT(results[i - 1].first, results[i].first);
+    }
+    EXPECT_EQ(results.back().first, lastEpoch);
+    EXPECT_TRUE(results.back().second.contains("font_20"));
+}
+
+class SleepRunnable : public QRunnable
+{
+public:
+    void run() override { QThread::msleep(100); }
+};
+
+TEST(SourceCodeSchedulerTest, Cancel)
+{
+    QThreadPool threadPool;
+    int numResults { 0 };
+
+    SourceCodeScheduler scheduler { &threadPool };
+    scheduler.setResultHandler([&](const QString&, quint64) { ++numResults; });
+
+    source_code_options options;
+    threadPool.setMaxThreadCount(1);
+    // Keep the only thread busy, so that the job is canceled before it starts
+    threadPool.start(new SleepRunnable);
+    scheduler.submit(test_face(100), options, QString::fromStdString(std::string(format::c::identifier)), "font");
+    scheduler.cancel();
+    threadPool.waitForDone();
+
+    EXPECT_EQ(numResults, 0);
+    EXPECT_EQ(scheduler.publishedEpoch(), 0u);
+}
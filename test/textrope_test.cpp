@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include "textrope.h"
+
+#include <QStringList>
+#include <random>
+
+static void expectLines(const TextRope& rope, const QString& text)
+{
+    auto lines = text.split(QLatin1Char('\n'));
+    if (text.endsWith(QLatin1Char('\n'))) {
+        lines.removeLast();
+    }
+
+    ASSERT_EQ(rope.lineCount(), lines.size());
+    for (int i = 0; i < lines.size(); ++i) {
+        EXPECT_EQ(rope.line(i), lines[i]) << i;
+    }
+    EXPECT_EQ(rope.text(), text);
+}
+
+static QString numberedLines(int count)
+{
+    QString text;
+    for (int i = 0; i < count; ++i) {
+        text += QString("\tline %1\n").arg(i);
+    }
+    return text;
+}
+
+TEST(TextRopeTest, SplitsTextIntoLines)
+{
+    TextRope rope;
+    EXPECT_EQ(rope.lineCount(), 0);
+
+    auto text = numberedLines(1000) + "last line without a break";
+    rope.update(text);
+    expectLines(rope, text);
+    EXPECT_GT(rope.chunkCount(), 1u);
+    EXPECT_EQ(rope.maxLineWidth(), TextRope::lineWidth("last line without a break"));
+    EXPECT_THROW(rope.line(rope.lineCount()), std::out_of_range);
+}
+
+TEST(TextRopeTest, LineWidthExpandsTabs)
+{
+    EXPECT_EQ(TextRope::lineWidth(""), 0);
+    EXPECT_EQ(TextRope::lineWidth("\t"), TextRope::tabWidth);
+    EXPECT_EQ(TextRope::lineWidth("ab\tc"), TextRope::tabWidth + 1);
+}
+
+TEST(TextRopeTest, UpdateReplacesChangedLinesOnly)
+{
+    auto text = numberedLines(1000);
+    TextRope rope { text };
+
+    EXPECT_TRUE(rope.update(text).isEmpty());
+
+    auto changed = text;
+    changed.replace("line 500\n", "line 500 changed\n");
+    auto change = rope.update(changed);
+    expectLines(rope, changed);
+
+    // Only lines of chunks around the change are replaced
+    EXPECT_LE(change.first, 500);
+    EXPECT_GT(change.first + change.count, 500);
+    EXPECT_EQ(change.count, change.newCount);
+    EXPECT_LE(change.count, 2 * TextRope::linesPerChunk);
+
+    auto inserted = changed;
+    inserted.replace("line 10\n", "line 10\nnew line\n");
+    change = rope.update(inserted);
+    expectLines(rope, inserted);
+    EXPECT_EQ(change.newCount - change.count, 1);
+}
+
+TEST(TextRopeTest, RandomEdits)
+{
+    std::mt19937 generator { 1 };
+    auto text = numberedLines(2000);
+    TextRope rope { text };
+
+    for (int i = 0; i < 200; ++i) {
+        auto position = static_cast<int>(generator() % static_cast<unsigned>(text.size() + 1));
+        switch (generator() % 3) {
+        case 0:
+            text.insert(position, "inserted\nline");
+            break;
+        case 1:
+            text.remove(position, static_cast<int>(generator() % 50));
+            break;
+        default:
+            text.insert(position, QLatin1Char('\n'));
+        }
+        rope.update(text);
+    }
+    expectLines(rope, text);
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "undohistory.h"
+#include "command.h"
+
+#include <vector>
+
+using namespace f2b;
+
+TEST(UndoHistoryTest, UndoesAndRedoes)
+{
+    UndoHistory history;
+    int value = 0;
+    for (int i = 1; i <= 3; ++i) {
+        history.push(new Command(QString::number(i), [&, i] { value = i - 1; }, [&, i] { value = i; }));
+    }
+    EXPECT_EQ(value, 3);
+    EXPECT_EQ(history.undoText(), "3");
+
+    history.undo();
+    history.undo();
+    EXPECT_EQ(value, 1);
+    EXPECT_EQ(history.redoText(), "2");
+
+    history.redo();
+    EXPECT_EQ(value, 2);
+
+    // Pushing drops commands that could be redone
+    history.push(new Command("4", [&] { value = 2; }, [&] { value = 4; }));
+    EXPECT_FALSE(history.canRedo());
+    EXPECT_EQ(history.count(), 3);
+}
+
+TEST(UndoHistoryTest, DropsOldestCommandsOverBudget)
+{
+    UndoHistory history { 10 * sizeof(Command) };
+    for (int i = 0; i < 20; ++i) {
+        history.push(new Command(QString::number(i), [] {}, [] {}));
+    }
+    EXPECT_LE(history.memoryUsage(), history.memoryBudget());
+    EXPECT_EQ(history.count(), 10);
+    EXPECT_EQ(history.undoText(), "19");
+
+    history.setMemoryBudget(0);
+    EXPECT_EQ(history.count(), 1);
+}
+
+TEST(UndoHistoryTest, CoalescesOldGlyphEdits)
+{
+    font::glyph_size size { 32, 32 };
+    std::vector<font::glyph> glyphs(2, font::glyph(size));
+
+    auto apply = [&](std::size_t index, const GlyphDelta& delta) { delta.apply(glyphs[index]); };
+    auto edit = [&](std::size_t index, font::point p) {
+        auto edited = glyphs[index];
+        edited.set_pixel_set(p, !edited.is_pixel_set(p));
+        return new GlyphEditCommand("Edit", index, GlyphDelta { glyphs[index], edited }, apply);
+    };
+
+    UndoHistory history;
+    for (std::size_t i = 0; i < 16; ++i) {
+        history.push(edit(0, { i, i }));
+    }
+    history.push(edit(1, { 0, 0 }));
+    history.push(edit(0, { 31, 0 }));
+    EXPECT_EQ(history.count(), 18);
+
+    // Old edits of the same glyph are merged into one
+    history.setMemoryBudget(history.memoryUsage() - 1);
+    EXPECT_LT(history.count(), 18);
+    EXPECT_LE(history.memoryUsage(), history.memoryBudget());
+
+    while (history.canUndo()) {
+        history.undo();
+    }
+    EXPECT_EQ(glyphs[0], font::glyph(size));
+    EXPECT_EQ(glyphs[1], font::glyph(size));
+}